@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DataAssets/AmalgamReplicationLODAsset.h"
+
+const FAmalgamReplicationLODSettings& UAmalgamReplicationLODAsset::GetSettings(EMassLOD::Type LOD) const
+{
+	switch (LOD)
+	{
+	case EMassLOD::High:	return High;
+	case EMassLOD::Medium:	return Medium;
+	default:				return Low;
+	}
+}
@@ -5,6 +5,7 @@
 
 // Niagara includes
 #include <NiagaraFunctionLibrary.h>
+#include <NiagaraDataInterfaceArrayFunctionLibrary.h>
 
 // Project function library, for getting emissive color from owner
 #include <FunctionLibraries/FunctionLibraryInfernale.h>
@@ -12,6 +13,8 @@
 
 #include "Kismet/GameplayStatics.h"
 #include "Mass/Army/AmalgamFragments.h"
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Replication/AmalgamViewReportComponent.h"
 #include "Structs/ReplicationStructs.h"
 
 // Sets default values
@@ -28,6 +31,7 @@ void AAmalgamVisualisationManager::BeginPlay()
 {
 	Super::BeginPlay();
 	ElementArray = TArray<FNiagaraVisualElement>();
+	ElementIndices.Reset();
 
 	if (!HasAuthority()) return;
 	const auto GameMode = Cast<AGameModeInfernale>(UGameplayStatics::GetGameMode(GetWorld()));
@@ -43,6 +47,16 @@ void AAmalgamVisualisationManager::BeginPlay()
 void AAmalgamVisualisationManager::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+
+	// Server and clients both render in between the last two simulation states
+	if (ShouldInterpolate()) InterpolateElements();
+	if (bUseInstancedVisualisation) PushInstancedBatches();
+	if (bUseActorPool)
+	{
+		RefillActorPools();
+		if (bDebugActorPool) DebugActorPools();
+	}
+
 	if (!HasAuthority()) return;
 	if (Trucs.Num() > 0)
 	{
@@ -130,6 +144,18 @@ void AAmalgamVisualisationManager::RemoveFromMapP(FMassEntityHandle EntityHandle
 	RemoveFromMapMulticast(EntityHandle);
 }
 
+void AAmalgamVisualisationManager::BatchRemoveFromMapP(const TArray<FMassEntityHandle>& EntityHandles)
+{
+	if (!HasAuthority())
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Purple, TEXT("BatchRemoveFromMap: No autority"));
+		return;
+	}
+	if (EntityHandles.IsEmpty()) return;
+
+	BatchRemoveFromMapMulticast(EntityHandles);
+}
+
 void AAmalgamVisualisationManager::ChangeBatch(int Value)
 {
 	ChangeBatchMulticast(Value);
@@ -161,12 +187,38 @@ void AAmalgamVisualisationManager::UpdatePositionOfSpecificUnits(
 	for (int Index = 0; Index < DataForVisualisations.Num(); ++Index)
 	{
 		const auto& DataForVisualisation = DataForVisualisations[Index];
+		const uint64 HandleAsNumber = DataForVisualisation.EntityHandle.AsNumber();
+
+		// Shown again, the samples from before it was hidden would make it slide in
+		bool bAlreadyShown = false;
+		ShownElements.Add(HandleAsNumber, &bAlreadyShown);
+		if (!bAlreadyShown) ResetInterpolation(HandleAsNumber);
+
 		UpdateItemPosition(DataForVisualisation.EntityHandle, DataForVisualisation);
 	}
 
 	for (const auto EntityToHide : EntitiesToHide)
 	{
 		HideItem(EntityToHide);
+		ShownElements.Remove(EntityToHide.AsNumber());
+	}
+}
+
+void AAmalgamVisualisationManager::UpdateSimulatedUnits(const TArray<FDataForVisualisation>& DataForVisualisations)
+{
+	for (const FDataForVisualisation& DataForVisualisation : DataForVisualisations)
+	{
+		const uint64 HandleAsNumber = DataForVisualisation.EntityHandle.AsNumber();
+		if (!ShownElements.Contains(HandleAsNumber)) continue;
+
+		// Removed since it was last shown
+		if (!ContainsElement(HandleAsNumber))
+		{
+			ShownElements.Remove(HandleAsNumber);
+			continue;
+		}
+
+		UpdateItemPosition(DataForVisualisation.EntityHandle, DataForVisualisation);
 	}
 }
 
@@ -217,15 +269,6 @@ void AAmalgamVisualisationManager::BatchUpdatePositionMulticast_Implementation(c
 		return;
 	}
 
-	// const auto Mins = FMath::Min(EntityHandles.Num(), CurrentBatch + UnitsByBatch);
-	//
-	// for (int Index = CurrentBatch; Index < Mins; ++Index)
-	// {
-	// 	UpdateItemPosition(EntityHandles[Index], DataForVisualisations[Index]);
-	// }
-	// CurrentBatch += UnitsByBatch;
-	// if (CurrentBatch >= EntityHandles.Num()) CurrentBatch = 0;
-
 	if (!InfernalePawn)
 	{
 		const auto PlayerController = UGameplayStatics::GetPlayerController(GetWorld(), 0);
@@ -250,6 +293,11 @@ void AAmalgamVisualisationManager::RemoveFromMapMulticast_Implementation(FMassEn
 	RemoveFromMap(EntityHandle);
 }
 
+void AAmalgamVisualisationManager::BatchRemoveFromMapMulticast_Implementation(const TArray<FMassEntityHandle>& EntityHandles)
+{
+	BatchRemoveFromMap(EntityHandles);
+}
+
 void AAmalgamVisualisationManager::AddToMap(FMassEntityHandle EntityHandle, UNiagaraComponent* NiagaraComponent)
 {
 	uint64 HandleAsNumber = EntityHandle.AsNumber();
@@ -259,7 +307,7 @@ void AAmalgamVisualisationManager::AddToMap(FMassEntityHandle EntityHandle, UNia
 
 	FNiagaraVisualElement NewElement(HandleAsNumber, NiagaraComponent);
 	
-	ElementArray.Add(NewElement);
+	AddElement(NewElement);
 }
 
 void AAmalgamVisualisationManager::AddToMap(FMassEntityHandle EntityHandle, AActor* BPActor)
@@ -271,7 +319,7 @@ void AAmalgamVisualisationManager::AddToMap(FMassEntityHandle EntityHandle, AAct
 
 	FBPVisualElement NewElement(HandleAsNumber, BPActor);
 
-	BPElementsArray.Add(NewElement);
+	AddElementBP(NewElement);
 }
 
 void AAmalgamVisualisationManager::CreateAndAddToMap(FMassEntityHandle EntityHandle, FOwner EntityOwner, const UWorld* World, UNiagaraSystem* NiagaraSystem, const FVector Location)
@@ -281,6 +329,12 @@ void AAmalgamVisualisationManager::CreateAndAddToMap(FMassEntityHandle EntityHan
 
 	if (ContainsElement(HandleAsNumber)) return;
 
+	if (bUseInstancedVisualisation)
+	{
+		AddInstancedElement(HandleAsNumber, EntityOwner.Team, EEntityType::EntityTypeBehemot, Location);
+		return;
+	}
+
 	const auto TeamColor = UFunctionLibraryInfernale::GetTeamColorCpp(EntityOwner.Team, EEntityType::EntityTypeBehemot);
 	const auto EmissiveColor = UFunctionLibraryInfernale::GetTeamColorEmissiveCpp(EntityOwner.Team, EEntityType::EntityTypeBehemot);
 	
@@ -290,7 +344,7 @@ void AAmalgamVisualisationManager::CreateAndAddToMap(FMassEntityHandle EntityHan
 	SpawnedComponent->SetColorParameter("EmissiveColor", EmissiveColor);
 	FNiagaraVisualElement NewElement(HandleAsNumber, SpawnedComponent);
 
-	ElementArray.Add(NewElement);
+	AddElement(NewElement);
 }
 
 void AAmalgamVisualisationManager::CreateAndAddToMap(FMassEntityHandle EntityHandle, FDataForSpawnVisual DataForSpawnVisual, TSubclassOf<AActor> BPVisualisation)
@@ -307,12 +361,20 @@ void AAmalgamVisualisationManager::CreateAndAddToMap(FMassEntityHandle EntityHan
 		}
 	}
 
+	if (bUseInstancedVisualisation)
+	{
+		if (!ContainsElement(HandleAsNumber))
+			AddInstancedElement(HandleAsNumber, DataForSpawnVisual.EntityOwner.Team, DataForSpawnVisual.EntityType, DataForSpawnVisual.Location);
+		return;
+	}
+
 	const auto TeamColor = UFunctionLibraryInfernale::GetTeamColorCpp(DataForSpawnVisual.EntityOwner.Team, DataForSpawnVisual.EntityType);
 	const auto EmissiveColor = UFunctionLibraryInfernale::GetTeamColorEmissiveCpp(DataForSpawnVisual.EntityOwner.Team, DataForSpawnVisual.EntityType);
 	//GEngine->AddOnScreenDebugMessage(-1, 5.f, TeamColor.ToFColorSRGB() , FString::Printf(TEXT("GetTeamColorCpp: Team: %s, EntityType: %s"), *UEnum::GetValueAsString(DataForSpawnVisual.EntityOwner.Team), *UEnum::GetValueAsString(DataForSpawnVisual.EntityType)));
 
 	AActor* Spawned;
-	Spawned = GetWorld()->SpawnActor<AActor>(BPVisualisation, DataForSpawnVisual.Location, FRotator(0.f, 0.f, 0.f));
+	if (bUseActorPool) Spawned = AcquireVisualActor(BPVisualisation, DataForSpawnVisual.Location);
+	else Spawned = GetWorld()->SpawnActor<AActor>(BPVisualisation, DataForSpawnVisual.Location, FRotator(0.f, 0.f, 0.f));
 	auto NiagaraUnitAsActor = Cast<ANiagaraUnitAsActor>(Spawned);
 	if (!NiagaraUnitAsActor)
 	{
@@ -329,7 +391,7 @@ void AAmalgamVisualisationManager::CreateAndAddToMap(FMassEntityHandle EntityHan
 	NiagaraUnitAsActor->SpeedMultiplierUpdated(DataForSpawnVisual.SpeedMultiplier);
 	NiagaraUnitAsActor->OwnerOnCreation(DataForSpawnVisual.EntityOwner);
 	FBPVisualElement NewElement(HandleAsNumber, Spawned);
-	BPElementsArray.Add(NewElement);
+	AddElementBP(NewElement);
 	return;
 }
 
@@ -342,13 +404,40 @@ void AAmalgamVisualisationManager::UpdateItemPosition(FMassEntityHandle EntityHa
 	if (!ContainsElement(HandleAsNumber)) return;
 	auto Location = FVector(DataForVisualisation.LocationX, DataForVisualisation.LocationY, 0.f);
 	auto Rotation = FVector(DataForVisualisation.RotationX, DataForVisualisation.RotationY,0.f);
+	const bool bInterpolate = ShouldInterpolate();
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	if (bUseInstancedVisualisation)
+	{
+		const FInstancedVisualSlot& Ref = InstancedIndices[HandleAsNumber];
+		FInstancedVisualBatch& Batch = InstancedBatches[Ref.Batch];
+		Batch.States[Ref.Slot] = 1;
+		Batch.bDirty = true;
+
+		if (bInterpolate)
+		{
+			PushInterpolationTarget(Batch.Interpolations[Ref.Slot], Location, Rotation.Rotation().Quaternion(), Now);
+			return;
+		}
+
+		Batch.Positions[Ref.Slot] = Location;
+		Batch.Directions[Ref.Slot] = Rotation;
+		return;
+	}
 	
 	if (bUseBPVisualisation)
 	{
-		AActor* Visualisation = FindElementBP(HandleAsNumber)->Element.Get();
+		FBPVisualElement* Element = FindElementBP(HandleAsNumber);
+		AActor* Visualisation = Element->Element.Get();
 		ANiagaraUnitAsActor* NiagaraActor = Cast<ANiagaraUnitAsActor>(Visualisation);
 		
 		NiagaraActor->Activate(true);
+
+		if (bInterpolate)
+		{
+			PushInterpolationTarget(Element->Interpolation, Location, Rotation.Rotation().Quaternion(), Now);
+			return;
+		}
 		
 		Visualisation->SetActorLocation(Location);
 		//DrawDebugSphere(GetWorld(), Location, 200, 12, FColor::Red, false, 0.f);
@@ -356,7 +445,14 @@ void AAmalgamVisualisationManager::UpdateItemPosition(FMassEntityHandle EntityHa
 		return;
 	}
 
-	TWeakObjectPtr<UNiagaraComponent> NC = GetNiagaraComponent(HandleAsNumber);
+	FNiagaraVisualElement* Element = FindElement(HandleAsNumber);
+	if (bInterpolate)
+	{
+		PushInterpolationTarget(Element->Interpolation, Location, Rotation.Rotation().Quaternion(), Now);
+		return;
+	}
+
+	TWeakObjectPtr<UNiagaraComponent> NC = Element->NiagaraComponent;
 	NC->SetRelativeLocation(Location);
 	NC->SetRelativeRotation(Rotation.Rotation());
 }
@@ -367,6 +463,16 @@ void AAmalgamVisualisationManager::HideItem(FMassEntityHandle EntityHandle)
 	//checkf(ContainsElement(HandleAsNumber), TEXT("Handle is not in map."));
 	
 	if (!ContainsElement(HandleAsNumber)) return;
+
+	ResetInterpolation(HandleAsNumber);
+
+	if (bUseInstancedVisualisation)
+	{
+		const FInstancedVisualSlot& Ref = InstancedIndices[HandleAsNumber];
+		InstancedBatches[Ref.Batch].States[Ref.Slot] = 0;
+		InstancedBatches[Ref.Batch].bDirty = true;
+		return;
+	}
 	
 	if (bUseBPVisualisation)
 	{
@@ -380,6 +486,10 @@ void AAmalgamVisualisationManager::ShowHideAllItems(bool bShow)
 {
 	GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Purple, FString::Printf(TEXT("ShowHideAllItems:%d"), bShow));
 	bHideAll = !bShow;
+	for (const FInstancedVisualBatch& Batch : InstancedBatches)
+	{
+		if (IsValid(Batch.Component)) Batch.Component->SetVisibility(!bShow);
+	}
 	for (int Index = 0; Index < BPElementsArray.Num(); ++Index)
 	{
 		if (bUseBPVisualisation)
@@ -398,32 +508,81 @@ void AAmalgamVisualisationManager::RemoveFromMap(FMassEntityHandle EntityHandle)
 
 	if (!ContainsElement(HandleAsNumber)) return;
 
+	if (bUseInstancedVisualisation)
+	{
+		RemoveInstancedElement(HandleAsNumber);
+		return;
+	}
+
 	if (bUseBPVisualisation)
 	{
-		FindElementBP(HandleAsNumber)->Element->Destroy();
-		int Idx = FindElementIndex(HandleAsNumber);
-		BPElementsArray.RemoveAt(Idx);
+		ReleaseVisualActor(FindElementBP(HandleAsNumber)->Element.Get());
+		RemoveElement(HandleAsNumber);
 		return;
 	}
 
 	TWeakObjectPtr<UNiagaraComponent> NC = GetNiagaraComponent(HandleAsNumber);
 	NC->DestroyComponent();
 
-	int Idx = FindElementIndex(HandleAsNumber);
-	ElementArray.RemoveAt(Idx);
+	RemoveElement(HandleAsNumber);
+}
+
+void AAmalgamVisualisationManager::BatchRemoveFromMap(const TArray<FMassEntityHandle>& EntityHandles)
+{
+	// Each removal is a lookup and a swap, the cost only depends on the number of removed handles
+	for (const FMassEntityHandle& EntityHandle : EntityHandles)
+	{
+		const uint64 HandleAsNumber = EntityHandle.AsNumber();
+
+		if (bUseInstancedVisualisation)
+		{
+			RemoveInstancedElement(HandleAsNumber);
+			continue;
+		}
+
+		if (bUseBPVisualisation)
+		{
+			FBPVisualElement* Element = FindElementBP(HandleAsNumber);
+			if (!Element) continue;
+
+			if (Element->Element.IsValid())
+				ReleaseVisualActor(Element->Element.Get());
+			RemoveElement(HandleAsNumber);
+			continue;
+		}
+
+		FNiagaraVisualElement* Element = FindElement(HandleAsNumber);
+		if (!Element) continue;
+
+		if (IsValid(Element->NiagaraComponent))
+			Element->NiagaraComponent->DestroyComponent();
+		RemoveElement(HandleAsNumber);
+	}
 }
 
 void AAmalgamVisualisationManager::OnPreLaunchGame()
 {
+	if (bUseActorPool) PrewarmActorPoolsMulticast();
 }
 
-void AAmalgamVisualisationManager::ChangeBatchMulticast_Implementation(int Value)
+void AAmalgamVisualisationManager::PrewarmActorPoolsMulticast_Implementation()
 {
-	// UnitsByBatch += Value;
-	// if (UnitsByBatch < 10) UnitsByBatch = 10;
-	// GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Red, FString::Printf(TEXT("NewVal: %d"), UnitsByBatch));
+	for (const TSubclassOf<AActor>& ActorClass : PrewarmedActorClasses)
+	{
+		if (!ActorClass) continue;
 
+		FVisualActorPool& Pool = ActorPools.FindOrAdd(ActorClass.Get());
+		while (Pool.FreeActors.Num() < PoolPrewarmCount)
+		{
+			AActor* Actor = SpawnPooledActor(ActorClass.Get());
+			if (!Actor) break;
+			Pool.FreeActors.Add(Actor);
+		}
+	}
+}
 
+void AAmalgamVisualisationManager::ChangeBatchMulticast_Implementation(int Value)
+{
 	Radius += Value;
 	if (Radius < 1000) Radius = 1000;
 	GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Red, FString::Printf(TEXT("Radius: %d"), Radius));
@@ -437,59 +596,385 @@ TWeakObjectPtr<UNiagaraComponent> AAmalgamVisualisationManager::GetNiagaraCompon
 
 FNiagaraVisualElement* AAmalgamVisualisationManager::FindElement(uint64 ElementHandle)
 {
-	FNiagaraVisualElement* FoundElement = ElementArray.FindByPredicate([&](const FNiagaraVisualElement& Element)
+	const int32* Index = ElementIndices.Find(ElementHandle);
+	return Index ? &ElementArray[*Index] : nullptr;
+}
+
+FBPVisualElement* AAmalgamVisualisationManager::FindElementBP(uint64 ElementHandle)
+{
+	const int32* Index = BPElementIndices.Find(ElementHandle);
+	return Index ? &BPElementsArray[*Index] : nullptr;
+}
+
+int32 AAmalgamVisualisationManager::FindElementIndex(uint64 ElementHandle)
+{
+	const int32* Index = bUseBPVisualisation ? BPElementIndices.Find(ElementHandle) : ElementIndices.Find(ElementHandle);
+	return Index ? *Index : INDEX_NONE;
+}
+
+bool AAmalgamVisualisationManager::ContainsElement(uint64 ElementHandle)
+{
+	if (bUseInstancedVisualisation)
+		return InstancedIndices.Contains(ElementHandle);
+
+	if (bUseBPVisualisation)
+		return BPElementIndices.Contains(ElementHandle);
+
+	return ElementIndices.Contains(ElementHandle);
+}
+
+void AAmalgamVisualisationManager::AddElement(const FNiagaraVisualElement& NewElement)
+{
+	ElementIndices.Add(NewElement.Handle, ElementArray.Add(NewElement));
+}
+
+void AAmalgamVisualisationManager::AddElementBP(const FBPVisualElement& NewElement)
+{
+	BPElementIndices.Add(NewElement.Handle, BPElementsArray.Add(NewElement));
+}
+
+void AAmalgamVisualisationManager::RemoveElement(uint64 ElementHandle)
+{
+	int32 Index;
+	if (bUseBPVisualisation)
+	{
+		if (!BPElementIndices.RemoveAndCopyValue(ElementHandle, Index)) return;
+
+		BPElementsArray.RemoveAtSwap(Index);
+		if (BPElementsArray.IsValidIndex(Index))
+			BPElementIndices[BPElementsArray[Index].Handle] = Index;
+		return;
+	}
+
+	if (!ElementIndices.RemoveAndCopyValue(ElementHandle, Index)) return;
+
+	ElementArray.RemoveAtSwap(Index);
+	if (ElementArray.IsValidIndex(Index))
+		ElementIndices[ElementArray[Index].Handle] = Index;
+}
+
+int32 AAmalgamVisualisationManager::FindOrCreateInstancedBatch(ETeam Team, EEntityType EntityType)
+{
+	// A handful of batches at most, a linear search is enough
+	const int32 Existing = InstancedBatches.IndexOfByPredicate([&](const FInstancedVisualBatch& Batch)
 		{
-			return Element.Handle == ElementHandle;
+			return Batch.Team == Team && Batch.EntityType == EntityType;
 		});
+	if (Existing != INDEX_NONE) return Existing;
+
+	// No unit of the batch would ever be drawn, reported once in the log and on screen every time
+	if (!ensureMsgf(InstancedSystem, TEXT("AAmalgamVisualisationManager : bUseInstancedVisualisation is set without an InstancedSystem, units are not drawn")))
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, TEXT("FindOrCreateInstancedBatch: InstancedSystem is not set"));
+		return INDEX_NONE;
+	}
+
+	// Particles are placed in world space, the component stays at the origin for the whole game
+	UNiagaraComponent* Component = UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), InstancedSystem, FVector::ZeroVector, FRotator::ZeroRotator, FVector(1.f), false, true, ENCPoolMethod::None, false);
+	if (!Component)
+	{
+		UE_LOG(LogTemp, Error, TEXT("AAmalgamVisualisationManager : Failed to spawn %s for team %d, entity type %d"), *InstancedSystem->GetName(), (int32)Team, (int32)EntityType);
+		return INDEX_NONE;
+	}
+
+	Component->SetColorParameter("TeamColor", UFunctionLibraryInfernale::GetTeamColorCpp(Team, EntityType));
+	Component->SetColorParameter("EmissiveColor", UFunctionLibraryInfernale::GetTeamColorEmissiveCpp(Team, EntityType));
+	Component->SetVisibility(bHideAll);
 
-	return FoundElement;
+	FInstancedVisualBatch& Batch = InstancedBatches.AddDefaulted_GetRef();
+	Batch.Component = Component;
+	Batch.Team = Team;
+	Batch.EntityType = EntityType;
+	return InstancedBatches.Num() - 1;
 }
 
-FBPVisualElement* AAmalgamVisualisationManager::FindElementBP(uint64 ElementHandle)
+void AAmalgamVisualisationManager::AddInstancedElement(uint64 ElementHandle, ETeam Team, EEntityType EntityType, const FVector& Location)
+{
+	const int32 BatchIndex = FindOrCreateInstancedBatch(Team, EntityType);
+	if (BatchIndex == INDEX_NONE) return;
+
+	FInstancedVisualBatch& Batch = InstancedBatches[BatchIndex];
+	const int32 Slot = Batch.Handles.Add(ElementHandle);
+	Batch.Positions.Add(Location);
+	Batch.Directions.Add(FVector::ForwardVector);
+	Batch.States.Add(1);
+	Batch.Interpolations.AddDefaulted();
+	Batch.bDirty = true;
+
+	InstancedIndices.Add(ElementHandle, { BatchIndex, Slot });
+}
+
+void AAmalgamVisualisationManager::RemoveInstancedElement(uint64 ElementHandle)
+{
+	FInstancedVisualSlot Removed;
+	if (!InstancedIndices.RemoveAndCopyValue(ElementHandle, Removed)) return;
+
+	FInstancedVisualBatch& Batch = InstancedBatches[Removed.Batch];
+	Batch.Handles.RemoveAtSwap(Removed.Slot);
+	Batch.Positions.RemoveAtSwap(Removed.Slot);
+	Batch.Directions.RemoveAtSwap(Removed.Slot);
+	Batch.States.RemoveAtSwap(Removed.Slot);
+	Batch.Interpolations.RemoveAtSwap(Removed.Slot);
+	Batch.bDirty = true;
+
+	if (Batch.Handles.IsValidIndex(Removed.Slot))
+		InstancedIndices[Batch.Handles[Removed.Slot]].Slot = Removed.Slot;
+}
+
+void AAmalgamVisualisationManager::PushInstancedBatches()
+{
+	for (FInstancedVisualBatch& Batch : InstancedBatches)
+	{
+		if (!Batch.bDirty || !IsValid(Batch.Component)) continue;
+
+		UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(Batch.Component, "Positions", Batch.Positions);
+		UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(Batch.Component, "Directions", Batch.Directions);
+		UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayInt32(Batch.Component, "States", Batch.States);
+		Batch.bDirty = false;
+	}
+}
+
+void AAmalgamVisualisationManager::UpdateImpostors(const TArray<FAmalgamImpostor>& Impostors)
 {
-	FBPVisualElement* FoundElement = BPElementsArray.FindByPredicate([&](const FBPVisualElement& Element)
+	if (!ImpostorComponent)
+	{
+		if (!ImpostorSystem)
 		{
-			return Element.Handle == ElementHandle;
-		});
+			GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, TEXT("UpdateImpostors: ImpostorSystem is not set"));
+			return;
+		}
+
+		// Same as the instanced batches, particles are placed in world space
+		ImpostorComponent = UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), ImpostorSystem, FVector::ZeroVector, FRotator::ZeroRotator, FVector(1.f), false, true, ENCPoolMethod::None, false);
+		if (!ImpostorComponent) return;
+	}
+
+	TArray<FVector> Positions;
+	TArray<float> Spreads;
+	TArray<int32> Counts;
+	TArray<FLinearColor> Colors;
+	Positions.Reserve(Impostors.Num());
+	Spreads.Reserve(Impostors.Num());
+	Counts.Reserve(Impostors.Num());
+	Colors.Reserve(Impostors.Num());
 
-	return FoundElement;
+	for (const FAmalgamImpostor& Impostor : Impostors)
+	{
+		Positions.Add(FVector(Impostor.Centroid.X, Impostor.Centroid.Y, 0.f));
+		Spreads.Add(Impostor.Spread);
+		Counts.Add(Impostor.Count);
+		Colors.Add(UFunctionLibraryInfernale::GetTeamColorCpp(Impostor.Team, EEntityType::EntityTypeBehemot));
+	}
+
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(ImpostorComponent, "ImpostorPositions", Positions);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayFloat(ImpostorComponent, "ImpostorSpreads", Spreads);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayInt32(ImpostorComponent, "ImpostorCounts", Counts);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayColor(ImpostorComponent, "ImpostorColors", Colors);
 }
 
-int32 AAmalgamVisualisationManager::FindElementIndex(uint64 ElementHandle)
+
+AActor* AAmalgamVisualisationManager::AcquireVisualActor(TSubclassOf<AActor> ActorClass, const FVector& Location)
 {
-	if (bUseBPVisualisation)
+	FVisualActorPool& Pool = ActorPools.FindOrAdd(ActorClass.Get());
+
+	AActor* Actor = nullptr;
+	while (!Actor && Pool.FreeActors.Num() > 0)
 	{
-		int32 FoundElement = BPElementsArray.IndexOfByPredicate([&](const FBPVisualElement& Element)
-			{
-				return Element.Handle == ElementHandle;
-			});
-		return FoundElement;
+		// Pooled actors can still be destroyed from outside, e.g. on level streaming
+		Actor = Pool.FreeActors.Pop();
+		if (!IsValid(Actor)) Actor = nullptr;
+	}
+
+	if (!Actor)
+	{
+		++Pool.Misses;
+		return GetWorld()->SpawnActor<AActor>(ActorClass, Location, FRotator(0.f, 0.f, 0.f));
 	}
 
-	int32 FoundElement = ElementArray.IndexOfByPredicate([&](const FNiagaraVisualElement& Element)
+	++Pool.Hits;
+	Actor->SetActorLocationAndRotation(Location, FRotator(0.f, 0.f, 0.f));
+	Actor->SetActorHiddenInGame(false);
+	if (ANiagaraUnitAsActor* NiagaraActor = Cast<ANiagaraUnitAsActor>(Actor))
+		NiagaraActor->Activate(true);
+	return Actor;
+}
+
+void AAmalgamVisualisationManager::ReleaseVisualActor(AActor* Actor)
+{
+	if (!IsValid(Actor)) return;
+
+	if (!bUseActorPool)
+	{
+		Actor->Destroy();
+		return;
+	}
+
+	FVisualActorPool& Pool = ActorPools.FindOrAdd(Actor->GetClass());
+	if (Pool.FreeActors.Num() >= PoolHighWatermark)
+	{
+		++Pool.Trimmed;
+		Actor->Destroy();
+		return;
+	}
+
+	// Team colors, speed and owner are set again by CreateAndAddToMap when the actor is reused
+	if (ANiagaraUnitAsActor* NiagaraActor = Cast<ANiagaraUnitAsActor>(Actor))
+		NiagaraActor->Activate(false);
+	Actor->SetActorHiddenInGame(true);
+	Pool.FreeActors.Add(Actor);
+}
+
+AActor* AAmalgamVisualisationManager::SpawnPooledActor(UClass* ActorClass)
+{
+	AActor* Actor = GetWorld()->SpawnActor<AActor>(ActorClass, FVector::ZeroVector, FRotator(0.f, 0.f, 0.f));
+	if (!Actor) return nullptr;
+
+	if (ANiagaraUnitAsActor* NiagaraActor = Cast<ANiagaraUnitAsActor>(Actor))
+		NiagaraActor->Activate(false);
+	Actor->SetActorHiddenInGame(true);
+	return Actor;
+}
+
+void AAmalgamVisualisationManager::RefillActorPools()
+{
+	int32 Budget = PoolRefillPerTick;
+	for (TPair<UClass*, FVisualActorPool>& Pair : ActorPools)
+	{
+		FVisualActorPool& Pool = Pair.Value;
+		while (Budget > 0 && Pair.Key && Pool.FreeActors.Num() < PoolLowWatermark)
 		{
-			return Element.Handle == ElementHandle;
-		});
+			AActor* Actor = SpawnPooledActor(Pair.Key);
+			if (!Actor) break;
+			Pool.FreeActors.Add(Actor);
+			--Budget;
+		}
+		if (Budget <= 0) return;
+	}
+}
+
+void AAmalgamVisualisationManager::DebugActorPools()
+{
+	int32 Key = 0;
+	for (const TPair<UClass*, FVisualActorPool>& Pair : ActorPools)
+	{
+		const FVisualActorPool& Pool = Pair.Value;
+		GEngine->AddOnScreenDebugMessage(GetUniqueID() + Key++, 0.f, FColor::Purple, FString::Printf(TEXT("ActorPool %s: Free %d, Hits %d, Misses %d, Trimmed %d"), *GetNameSafe(Pair.Key), Pool.FreeActors.Num(), Pool.Hits, Pool.Misses, Pool.Trimmed));
+	}
+}
+
+bool AAmalgamVisualisationManager::ShouldInterpolate()
+{
+	if (UsesVisualBuffer()) return true;
 
-	return FoundElement;
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		if (!SimulationSubsystem) return false;
+	}
+	return SimulationSubsystem->GetSimulationClock().IsFixedTimestep();
 }
 
-bool AAmalgamVisualisationManager::ContainsElement(uint64 ElementHandle)
+float AAmalgamVisualisationManager::GetInterpolationAlpha(const FVisualInterpolationState& Interpolation) const
+{
+	// Updates arrive once per simulation step, so a full step after the last one we should be on target
+	const float FixedStep = SimulationSubsystem->GetSimulationClock().GetFixedStep();
+	const float Elapsed = GetWorld()->GetTimeSeconds() - Interpolation.UpdateTime;
+	return FMath::Clamp(Elapsed / FixedStep, 0.f, 1.f);
+}
+
+bool AAmalgamVisualisationManager::UsesVisualBuffer() const
+{
+	// The server renders the simulation directly, only clients wait on the network
+	return bBufferVisualUpdates && !HasAuthority();
+}
+
+void AAmalgamVisualisationManager::PushInterpolationTarget(FVisualInterpolationState& Interpolation, const FVector& Location, const FQuat& Rotation, float Now)
+{
+	if (UsesVisualBuffer())
+	{
+		Interpolation.AddSample(Location, Rotation, Now, Now - InterpolationDelay, MaxExtrapolationTime);
+		return;
+	}
+	Interpolation.SetTarget(Location, Rotation, Now, GetInterpolationAlpha(Interpolation));
+}
+
+void AAmalgamVisualisationManager::ResetInterpolation(uint64 HandleAsNumber)
 {
+	if (!ContainsElement(HandleAsNumber)) return;
+
+	if (bUseInstancedVisualisation)
+	{
+		const FInstancedVisualSlot& Ref = InstancedIndices[HandleAsNumber];
+		InstancedBatches[Ref.Batch].Interpolations[Ref.Slot].Reset();
+		return;
+	}
+
 	if (bUseBPVisualisation)
 	{
-		FBPVisualElement* FoundElement = BPElementsArray.FindByPredicate([&](const FBPVisualElement& Element)
+		FindElementBP(HandleAsNumber)->Interpolation.Reset();
+		return;
+	}
+
+	FindElement(HandleAsNumber)->Interpolation.Reset();
+}
+
+void AAmalgamVisualisationManager::GetInterpolatedTransform(const FVisualInterpolationState& Interpolation, float Now, FVector& OutLocation, FRotator& OutRotation) const
+{
+	if (UsesVisualBuffer())
+	{
+		Interpolation.Sample(Now - InterpolationDelay, MaxExtrapolationTime, OutLocation, OutRotation);
+		return;
+	}
+
+	const float Alpha = GetInterpolationAlpha(Interpolation);
+	OutLocation = Interpolation.GetLocation(Alpha);
+	OutRotation = Interpolation.GetRotation(Alpha);
+}
+
+void AAmalgamVisualisationManager::InterpolateElements()
+{
+	if (!bHideAll) return;
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	if (bUseInstancedVisualisation)
+	{
+		for (FInstancedVisualBatch& Batch : InstancedBatches)
+		{
+			for (int32 Slot = 0; Slot < Batch.Handles.Num(); ++Slot)
 			{
-				return Element.Handle == ElementHandle;
-			});
-		return FoundElement != nullptr;
+				const FVisualInterpolationState& Interpolation = Batch.Interpolations[Slot];
+				if (!Interpolation.bActive) continue;
+
+				FRotator Rotation;
+				GetInterpolatedTransform(Interpolation, Now, Batch.Positions[Slot], Rotation);
+				Batch.Directions[Slot] = Rotation.Vector();
+				Batch.bDirty = true;
+			}
+		}
+		return;
 	}
 
-	FNiagaraVisualElement* FoundElement = ElementArray.FindByPredicate([&](const FNiagaraVisualElement& Element)
+	if (bUseBPVisualisation)
+	{
+		for (const FBPVisualElement& Element : BPElementsArray)
 		{
-			return Element.Handle == ElementHandle;
-		});
+			if (!Element.Interpolation.bActive || !Element.Element.IsValid()) continue;
 
-	return FoundElement != nullptr;
-}
+			FVector Location;
+			FRotator Rotation;
+			GetInterpolatedTransform(Element.Interpolation, Now, Location, Rotation);
+			Element.Element->SetActorLocationAndRotation(Location, Rotation);
+		}
+		return;
+	}
 
+	for (const FNiagaraVisualElement& Element : ElementArray)
+	{
+		if (!Element.Interpolation.bActive || !Element.NiagaraComponent) continue;
+
+		FVector Location;
+		FRotator Rotation;
+		GetInterpolatedTransform(Element.Interpolation, Now, Location, Rotation);
+		Element.NiagaraComponent->SetRelativeLocationAndRotation(Location, Rotation);
+	}
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamAttackScheduler.h"
+
+void FAmalgamAttackScheduler::Configure(float InResolution)
+{
+	Resolution = FMath::Max(InResolution, UE_KINDA_SMALL_NUMBER);
+}
+
+uint64 FAmalgamAttackScheduler::Schedule(FMassEntityHandle Entity, double DueTime)
+{
+	// Rounded up so an attack never comes out before its delay is over
+	const uint64 DueTick = FMath::Max(GetDueTick(DueTime), CurrentTick + 1);
+
+	Insert({ Entity, DueTick });
+	return DueTick;
+}
+
+void FAmalgamAttackScheduler::SchedulePending(TConstArrayView<FAmalgamScheduledAttack> Attacks)
+{
+	if (Attacks.Num() == 0) return;
+
+	FScopeLock ScopeLock(&PendingLock);
+	Pending.Append(Attacks.GetData(), Attacks.Num());
+}
+
+void FAmalgamAttackScheduler::Advance(double SimulationTime, TArray<FAmalgamScheduledAttack>& OutDueAttacks)
+{
+	OutDueAttacks.Reset();
+
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		for (const FAmalgamScheduledAttack& Attack : Pending)
+		{
+			// Computed before the wheel moved, late ones go in the next slot but keep their tick so the entity still matches
+			if (Attack.Tick > CurrentTick)
+				Insert(Attack);
+			else
+				NearWheel[(CurrentTick + 1) & (NearSize - 1)].Add(Attack);
+		}
+		Pending.Reset();
+	}
+
+	const uint64 TargetTick = FMath::Max<int64>(FMath::FloorToInt64(SimulationTime / Resolution), 0);
+	while (CurrentTick < TargetTick)
+	{
+		++CurrentTick;
+
+		if ((CurrentTick & (NearSize - 1)) == 0)
+		{
+			const uint64 Block = CurrentTick >> NearBits;
+
+			// Far wheel wrapped, bring in what was too far away for it
+			if ((Block & (FarSize - 1)) == 0)
+				Cascade(Overflow);
+
+			Cascade(FarWheel[Block & (FarSize - 1)]);
+		}
+
+		TArray<FAmalgamScheduledAttack>& Slot = NearWheel[CurrentTick & (NearSize - 1)];
+		OutDueAttacks.Append(Slot);
+		Slot.Reset();
+	}
+}
+
+void FAmalgamAttackScheduler::Insert(const FAmalgamScheduledAttack& Attack)
+{
+	// Schedule never goes below CurrentTick + 1 and cascades run before the current slot is drained
+	check(Attack.Tick >= CurrentTick);
+	const uint64 Delta = Attack.Tick - CurrentTick;
+
+	if (Delta < NearSize)
+		NearWheel[Attack.Tick & (NearSize - 1)].Add(Attack);
+	else if (Delta < NearSize * FarSize)
+		FarWheel[(Attack.Tick >> NearBits) & (FarSize - 1)].Add(Attack);
+	else
+		Overflow.Add(Attack);
+}
+
+void FAmalgamAttackScheduler::Cascade(TArray<FAmalgamScheduledAttack>& Slot)
+{
+	if (Slot.IsEmpty()) return;
+
+	Swap(Slot, CascadeScratch);
+	for (const FAmalgamScheduledAttack& Attack : CascadeScratch)
+	{
+		Insert(Attack);
+	}
+	CascadeScratch.Reset();
+}
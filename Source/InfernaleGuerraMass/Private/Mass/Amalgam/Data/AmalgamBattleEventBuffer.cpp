@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamBattleEventBuffer.h"
+
+#include "Mass/Collision/SpatialHashGrid.h"
+#include "Component/ActorComponents/DamageableComponent.h"
+
+void FAmalgamBattleEventBuffer::Append(TConstArrayView<FAmalgamBattleEvent> InEvents, TConstArrayView<FAmalgamStructureHit> InStructureHits)
+{
+	if (InEvents.Num() == 0 && InStructureHits.Num() == 0) return;
+
+	FScopeLock ScopeLock(&Lock);
+	Events.Append(InEvents.GetData(), InEvents.Num());
+	StructureHits.Append(InStructureHits.GetData(), InStructureHits.Num());
+}
+
+void FAmalgamBattleEventBuffer::Flush(UBattleManagerComponent* BattleManager)
+{
+	// Damage goes through with or without a battle manager
+	ApplyStructureHits();
+	if (Events.IsEmpty()) return;
+
+	if (!BattleManager || !ASpatialHashGrid::IsValid())
+	{
+		Events.Reset();
+		return;
+	}
+
+	Clusters.Reset();
+	for (const FAmalgamBattleEvent& Event : Events)
+	{
+		const FAmalgamBattleClusterKey Key = GetClusterKey(Event);
+		FAmalgamBattleCluster& Cluster = Clusters.FindOrAdd(Key);
+		if (Cluster.NumEvents == 0) Cluster.Key = Key;
+
+		Cluster.AttackerLocationSum += Event.AttackerLocation;
+		Cluster.TargetLocationSum += Event.TargetLocation;
+		++Cluster.NumEvents;
+	}
+	Events.Reset();
+
+	for (const TPair<FAmalgamBattleClusterKey, FAmalgamBattleCluster>& Pair : Clusters)
+	{
+		const FAmalgamBattleCluster& Cluster = Pair.Value;
+
+		FBattleInfo BattleInfo;
+		BattleInfo.AttackerUnitType = Cluster.Key.AttackerType;
+		BattleInfo.TargetUnitType = Cluster.Key.TargetType;
+		BattleInfo.BattlePositionAttackerWorld = Cluster.AttackerLocationSum / Cluster.NumEvents;
+		BattleInfo.BattlePositionTargetWorld = Cluster.TargetLocationSum / Cluster.NumEvents;
+		BattleInfo.UnitTargetTypeTarget = Cluster.Key.TargetKind;
+		BattleInfo.AttackerOwner = Cluster.Key.AttackerOwner;
+		BattleInfo.TargetOwner = Cluster.Key.TargetOwner;
+		BattleManager->AtPosBattleInfo(BattleInfo);
+	}
+}
+
+void FAmalgamBattleEventBuffer::ApplyStructureHits()
+{
+	for (const FAmalgamStructureHit& Hit : StructureHits)
+	{
+		FAmalgamBattleEvent Event;
+		Event.AttackerLocation = Hit.AttackerLocation;
+		Event.AttackerOwner = Hit.AttackerOwner;
+		Event.AttackerType = Hit.AttackerType;
+
+		if (ABuildingParent* Building = Hit.Building.Get())
+		{
+			Building->GetDamageableComponent()->DamageHealthOwner(Hit.Damage, false, Hit.AttackerOwner);
+
+			// Destroyed or captured by this hit, the fight pass drops it once the aggro pass refreshed its snapshot
+			if (!Hit.Building.IsValid() || Building->GetOwner().Team == Hit.AttackerOwner.Team) continue;
+
+			Event.TargetLocation = FVector2D(Building->GetActorLocation());
+			Event.TargetOwner = Building->GetOwner();
+			Event.TargetType = EEntityType::EntityTypeCity;
+			Event.TargetKind = EUnitTargetType::UTargetBuilding;
+		}
+		else if (ALDElement* Element = Hit.LDElement.Get())
+		{
+			if (IDamageable* Damageable = Cast<IDamageable>(Element))
+				Damageable->DamageHealthOwner(Hit.Damage, false, Hit.AttackerOwner);
+			if (!Hit.LDElement.IsValid()) continue;
+
+			Event.TargetLocation = FVector2D(Element->GetActorLocation());
+			Event.TargetOwner.Team = ETeam::NatureTeam;
+			Event.TargetOwner.Player = EPlayerOwning::Nature;
+			Event.TargetType = Element->GetEntityType();
+			Event.TargetKind = EUnitTargetType::UTargetNeutralCamp;
+		}
+		else
+		{
+			continue;
+		}
+
+		Events.Add(Event);
+	}
+	StructureHits.Reset();
+}
+
+FAmalgamBattleClusterKey FAmalgamBattleEventBuffer::GetClusterKey(const FAmalgamBattleEvent& Event) const
+{
+	const FIntVector2 Cell = ASpatialHashGrid::WorldToGridCoords(FVector(Event.AttackerLocation, 0.f));
+
+	FAmalgamBattleClusterKey Key;
+	Key.CellIndex = ASpatialHashGrid::CoordsToIndex(Cell);
+	Key.AttackerOwner = Event.AttackerOwner;
+	Key.TargetOwner = Event.TargetOwner;
+	Key.AttackerType = Event.AttackerType;
+	Key.TargetType = Event.TargetType;
+	Key.TargetKind = Event.TargetKind;
+	return Key;
+}
@@ -0,0 +1,178 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamFluxPathLUT.h"
+
+#include "Flux/Flux.h"
+
+TSharedPtr<FAmalgamFluxPathLUT> FAmalgamFluxPathLUT::Bake(const FSplineCurves& Curves, const FTransform& SplineTransform, float InSpacing)
+{
+	TSharedPtr<FAmalgamFluxPathLUT> LUT = MakeShared<FAmalgamFluxPathLUT>();
+	LUT->Spacing = InSpacing;
+	if (Curves.Position.Points.Num() == 0) return LUT;
+
+	LUT->Length = Curves.GetSplineLength();
+
+	// Always keep the last point so amalgams reach the very end of the flux
+	const int32 SampleCount = FMath::Max(1, FMath::CeilToInt(LUT->Length / InSpacing)) + 1;
+	LUT->Positions.Reserve(SampleCount);
+	LUT->Tangents.Reserve(SampleCount);
+
+	for (int32 Index = 0; Index < SampleCount; ++Index)
+	{
+		const float Distance = FMath::Min(Index * InSpacing, LUT->Length);
+		const float InputKey = Curves.ReparamTable.Eval(Distance, 0.f);
+
+		FVector Position = SplineTransform.TransformPosition(Curves.Position.Eval(InputKey, FVector::ZeroVector));
+		FVector Tangent = SplineTransform.TransformVector(Curves.Position.EvalDerivative(InputKey, FVector::ZeroVector));
+		Position.Z = 0.f;
+		Tangent.Z = 0.f;
+
+		LUT->Positions.Add(Position);
+		LUT->Tangents.Add(Tangent.GetSafeNormal());
+	}
+
+	return LUT;
+}
+
+int32 FAmalgamFluxPathLUT::FindClosestIndex(const FVector& Location, int32 StartIndex) const
+{
+	if (Positions.Num() == 0) return 0;
+
+	int32 ClosestIndex = FMath::Clamp(StartIndex, 0, Positions.Num() - 1);
+	float SmallestDistance = TNumericLimits<float>::Max();
+
+	for (int32 Index = ClosestIndex; Index < Positions.Num(); ++Index)
+	{
+		const float Distance = FVector::DistSquared2D(Positions[Index], Location);
+		if (Distance >= SmallestDistance) continue;
+
+		ClosestIndex = Index;
+		SmallestDistance = Distance;
+	}
+
+	return ClosestIndex;
+}
+
+FVector FAmalgamFluxPathLUT::GetPositionAtDistance(float Distance) const
+{
+	if (Positions.Num() == 0) return FVector::ZeroVector;
+	if (Positions.Num() == 1) return Positions[0];
+
+	int32 Index;
+	float Alpha;
+	GetSegment(Distance, Index, Alpha);
+	return FMath::Lerp(Positions[Index], Positions[Index + 1], Alpha);
+}
+
+FVector FAmalgamFluxPathLUT::GetTangentAtDistance(float Distance) const
+{
+	if (Tangents.Num() == 0) return FVector::ForwardVector;
+	if (Tangents.Num() == 1) return Tangents[0];
+
+	int32 Index;
+	float Alpha;
+	GetSegment(Distance, Index, Alpha);
+	return FMath::Lerp(Tangents[Index], Tangents[Index + 1], Alpha).GetSafeNormal();
+}
+
+void FAmalgamFluxPathLUT::GetSegment(float Distance, int32& OutIndex, float& OutAlpha) const
+{
+	OutIndex = FMath::Clamp(FMath::FloorToInt(Distance / Spacing), 0, Num() - 2);
+
+	// The last segment is usually shorter than Spacing
+	const float SegmentStart = GetDistanceAtIndex(OutIndex);
+	const float SegmentLength = GetDistanceAtIndex(OutIndex + 1) - SegmentStart;
+	OutAlpha = SegmentLength > 0.f ? FMath::Clamp((Distance - SegmentStart) / SegmentLength, 0.f, 1.f) : 0.f;
+}
+
+void FAmalgamFluxPathCache::Configure(float InSpacing)
+{
+	Spacing = FMath::Max(InSpacing, 1.f);
+}
+
+void FAmalgamFluxPathCache::Register(AFlux* Flux)
+{
+	check(IsInGameThread());
+	if (!Flux) return;
+
+	const FObjectKey FluxKey(Flux);
+	if (Entries.Contains(FluxKey)) return;
+
+	FEntry& Entry = Entries.Add(FluxKey);
+	Entry.Flux = Flux;
+	Entry.LUT = BakeFlux(Flux, Spacing);
+}
+
+void FAmalgamFluxPathCache::Update()
+{
+	check(IsInGameThread());
+
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		FEntry& Entry = It.Value();
+		AFlux* Flux = Entry.Flux.Get();
+		if (!Flux)
+		{
+			// Amalgams still on this flux keep their own reference to the last LUT
+			It.RemoveCurrent();
+			continue;
+		}
+
+		if (Entry.bBakePending)
+		{
+			if (!Entry.PendingBake.IsCompleted()) continue;
+
+			Entry.LUT = Entry.PendingBake.GetResult();
+			Entry.PendingBake = {};
+			Entry.bBakePending = false;
+		}
+
+		// Rebaked on the next frame if the flux changed again while we were baking
+		if (Entry.LUT->UpdateID == Flux->GetUpdateID() && Entry.LUT->UpdateVersion == Flux->GetUpdateVersion()) continue;
+
+		Entry.PendingBake = LaunchBake(Flux, Spacing);
+		Entry.bBakePending = true;
+	}
+}
+
+const TSharedPtr<const FAmalgamFluxPathLUT>* FAmalgamFluxPathCache::Find(FObjectKey FluxKey) const
+{
+	const FEntry* Entry = Entries.Find(FluxKey);
+	return Entry ? &Entry->LUT : nullptr;
+}
+
+TSharedPtr<FAmalgamFluxPathLUT> FAmalgamFluxPathCache::BakeFlux(AFlux* Flux, float Spacing)
+{
+	const USplineComponent* Spline = Flux->GetSplineForAmalgamsComponent();
+
+	TSharedPtr<FAmalgamFluxPathLUT> LUT = Spline
+		? FAmalgamFluxPathLUT::Bake(Spline->SplineCurves, Spline->GetComponentTransform(), Spacing)
+		: MakeShared<FAmalgamFluxPathLUT>();
+
+	LUT->UpdateID = Flux->GetUpdateID();
+	LUT->UpdateVersion = Flux->GetUpdateVersion();
+	LUT->SpeedMult = Flux->GetAmalgamsSpeedMult();
+	return LUT;
+}
+
+UE::Tasks::TTask<TSharedPtr<FAmalgamFluxPathLUT>> FAmalgamFluxPathCache::LaunchBake(AFlux* Flux, float Spacing)
+{
+	// Everything the bake needs is copied here, the task never touches the flux or its spline
+	const USplineComponent* Spline = Flux->GetSplineForAmalgamsComponent();
+	FSplineCurves Curves = Spline ? Spline->SplineCurves : FSplineCurves();
+	const FTransform SplineTransform = Spline ? Spline->GetComponentTransform() : FTransform::Identity;
+
+	const uint32 UpdateID = Flux->GetUpdateID();
+	const uint32 UpdateVersion = Flux->GetUpdateVersion();
+	const float SpeedMult = Flux->GetAmalgamsSpeedMult();
+
+	return UE::Tasks::Launch(UE_SOURCE_LOCATION, [Curves = MoveTemp(Curves), SplineTransform, Spacing, UpdateID, UpdateVersion, SpeedMult]()
+	{
+		TSharedPtr<FAmalgamFluxPathLUT> LUT = FAmalgamFluxPathLUT::Bake(Curves, SplineTransform, Spacing);
+		LUT->UpdateID = UpdateID;
+		LUT->UpdateVersion = UpdateVersion;
+		LUT->SpeedMult = SpeedMult;
+		return LUT;
+	});
+}
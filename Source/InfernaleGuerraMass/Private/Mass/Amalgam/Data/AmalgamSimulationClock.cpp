@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamSimulationClock.h"
+
+void FAmalgamSimulationClock::Configure(bool bInFixedTimestep, float InSimulationRate, int32 InMaxCatchUpSteps)
+{
+	bFixedTimestep = bInFixedTimestep;
+	FixedStep = 1.f / FMath::Clamp(InSimulationRate, 15.f, 30.f);
+	MaxCatchUpSteps = FMath::Max(1, InMaxCatchUpSteps);
+	Accumulator = 0.f;
+}
+
+void FAmalgamSimulationClock::Advance(float FrameDeltaTime)
+{
+	if (!bFixedTimestep)
+	{
+		StepsThisFrame = 1;
+		StepDeltaTime = FrameDeltaTime;
+		SimulationTime += FrameDeltaTime;
+		++Tick;
+		return;
+	}
+
+	Accumulator += FrameDeltaTime;
+
+	StepsThisFrame = 0;
+	while (Accumulator >= FixedStep && StepsThisFrame < MaxCatchUpSteps)
+	{
+		Accumulator -= FixedStep;
+		++StepsThisFrame;
+	}
+
+	// Only an overloaded frame gets here with more than a step left, drop that backlog instead of letting it snowball
+	Accumulator = FMath::Min(Accumulator, FixedStep);
+
+	// The processors run once per frame, the steps of a slow frame are integrated together so the simulation keeps up with real time
+	StepDeltaTime = FixedStep * StepsThisFrame;
+	SimulationTime += StepDeltaTime;
+	Tick += StepsThisFrame;
+}
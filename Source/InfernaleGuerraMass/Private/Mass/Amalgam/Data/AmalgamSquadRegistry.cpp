@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamSquadRegistry.h"
+
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	struct FSquadMergeKey
+	{
+		FObjectKey FluxKey;
+		int32 CellIndex = INDEX_NONE;
+		ETeam Team;
+
+		bool operator==(const FSquadMergeKey& Other) const { return FluxKey == Other.FluxKey && CellIndex == Other.CellIndex && Team == Other.Team; }
+		friend uint32 GetTypeHash(const FSquadMergeKey& Key) { return HashCombine(HashCombine(GetTypeHash(Key.FluxKey), GetTypeHash(Key.CellIndex)), GetTypeHash(static_cast<uint8>(Key.Team))); }
+	};
+
+	uint64 PackCell(const FIntVector2& Cell) { return (static_cast<uint64>(static_cast<uint32>(Cell.X)) << 32) | static_cast<uint32>(Cell.Y); }
+
+	struct FSquadSummary
+	{
+		FVector LocationSum = FVector::ZeroVector;
+		int32 NumMembers = 0;
+		FObjectKey FluxKey;
+		ETeam Team;
+	};
+}
+
+void FAmalgamSquadRegistry::Configure(int32 InMaxSquadSize)
+{
+	MaxSquadSize = FMath::Max(1, InMaxSquadSize);
+}
+
+int32 FAmalgamSquadRegistry::CreateSquad(ETeam Team)
+{
+	FAmalgamSquad Squad;
+	Squad.Team = Team;
+	return Squads.Add(MoveTemp(Squad));
+}
+
+void FAmalgamSquadRegistry::Recluster(TArray<FAmalgamSquadMember>& Members)
+{
+	if (!ASpatialHashGrid::IsValid()) return;
+
+	Members.Sort([](const FAmalgamSquadMember& A, const FAmalgamSquadMember& B) { return A.SquadId < B.SquadId; });
+
+	// Split, the members of a squad are flood filled over the grid cells they occupy, every island but the largest becomes a new squad
+	TMap<uint64, int32> CellComponents;
+	TArray<FIntVector2> Stack;
+	TArray<int32> ComponentSizes;
+	TArray<int32> ComponentSquads;
+
+	for (int32 Start = 0; Start < Members.Num();)
+	{
+		const int32 SquadId = Members[Start].SquadId;
+		int32 End = Start + 1;
+		while (End < Members.Num() && Members[End].SquadId == SquadId) ++End;
+
+		if (SquadId == INDEX_NONE || End - Start < 2)
+		{
+			Start = End;
+			continue;
+		}
+
+		CellComponents.Reset();
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			CellComponents.Add(PackCell(ASpatialHashGrid::WorldToGridCoords(Members[Index].Location)), INDEX_NONE);
+		}
+
+		ComponentSizes.Reset();
+		for (TPair<uint64, int32>& Pair : CellComponents)
+		{
+			if (Pair.Value != INDEX_NONE) continue;
+
+			const int32 Component = ComponentSizes.Add(0);
+			Pair.Value = Component;
+			Stack.Reset();
+			Stack.Add(FIntVector2(static_cast<int32>(Pair.Key >> 32), static_cast<int32>(Pair.Key & MAX_uint32)));
+
+			while (!Stack.IsEmpty())
+			{
+				const FIntVector2 Cell = Stack.Pop();
+				for (int32 X = -1; X <= 1; ++X)
+				{
+					for (int32 Y = -1; Y <= 1; ++Y)
+					{
+						int32* Neighbour = CellComponents.Find(PackCell(FIntVector2(Cell.X + X, Cell.Y + Y)));
+						if (!Neighbour || *Neighbour != INDEX_NONE) continue;
+
+						*Neighbour = Component;
+						Stack.Add(FIntVector2(Cell.X + X, Cell.Y + Y));
+					}
+				}
+			}
+		}
+
+		if (ComponentSizes.Num() > 1)
+		{
+			for (int32 Index = Start; Index < End; ++Index)
+			{
+				++ComponentSizes[CellComponents[PackCell(ASpatialHashGrid::WorldToGridCoords(Members[Index].Location))]];
+			}
+
+			int32 LargestComponent = 0;
+			for (int32 Component = 1; Component < ComponentSizes.Num(); ++Component)
+			{
+				if (ComponentSizes[Component] > ComponentSizes[LargestComponent])
+					LargestComponent = Component;
+			}
+
+			ComponentSquads.Reset();
+			for (int32 Component = 0; Component < ComponentSizes.Num(); ++Component)
+			{
+				ComponentSquads.Add(Component == LargestComponent ? SquadId : CreateSquad(Members[Start].Team));
+			}
+
+			for (int32 Index = Start; Index < End; ++Index)
+			{
+				FAmalgamSquadMember& Member = Members[Index];
+				const int32 NewSquadId = ComponentSquads[CellComponents[PackCell(ASpatialHashGrid::WorldToGridCoords(Member.Location))]];
+				if (NewSquadId == Member.SquadId) continue;
+
+				Member.SquadId = NewSquadId;
+				Member.bReassigned = true;
+			}
+		}
+
+		Start = End;
+	}
+
+	// Merge, squads of the same team and flux whose centers share a cell, as long as the result isn't too large
+	TMap<int32, FSquadSummary> Summaries;
+	for (const FAmalgamSquadMember& Member : Members)
+	{
+		if (Member.SquadId == INDEX_NONE) continue;
+
+		FSquadSummary& Summary = Summaries.FindOrAdd(Member.SquadId);
+		Summary.LocationSum += Member.Location;
+		Summary.FluxKey = Member.FluxKey;
+		Summary.Team = Member.Team;
+		++Summary.NumMembers;
+	}
+
+	// Largest squads first so small ones get absorbed
+	Summaries.ValueStableSort([](const FSquadSummary& A, const FSquadSummary& B) { return A.NumMembers > B.NumMembers; });
+
+	TMap<FSquadMergeKey, int32> MergeTargets;
+	TMap<int32, int32> Redirects;
+	for (const TPair<int32, FSquadSummary>& Pair : Summaries)
+	{
+		const FSquadSummary& Summary = Pair.Value;
+		const FIntVector2 CenterCell = ASpatialHashGrid::WorldToGridCoords(Summary.LocationSum / Summary.NumMembers);
+		const FSquadMergeKey Key{ Summary.FluxKey, ASpatialHashGrid::IsInGrid(CenterCell) ? ASpatialHashGrid::CoordsToIndex(CenterCell) : INDEX_NONE, Summary.Team };
+		if (Key.CellIndex == INDEX_NONE) continue;
+
+		int32* Target = MergeTargets.Find(Key);
+		if (!Target)
+		{
+			MergeTargets.Add(Key, Pair.Key);
+			continue;
+		}
+
+		FSquadSummary& TargetSummary = Summaries[*Target];
+		if (TargetSummary.NumMembers + Summary.NumMembers > MaxSquadSize) continue;
+
+		TargetSummary.NumMembers += Summary.NumMembers;
+		Redirects.Add(Pair.Key, *Target);
+	}
+
+	if (Redirects.IsEmpty()) return;
+
+	for (FAmalgamSquadMember& Member : Members)
+	{
+		const int32* Target = Redirects.Find(Member.SquadId);
+		if (!Target) continue;
+
+		Member.SquadId = *Target;
+		Member.bReassigned = true;
+	}
+}
+
+void FAmalgamSquadRegistry::Accumulate(TConstArrayView<FAmalgamSquadMember> Members)
+{
+	for (FAmalgamSquad& Squad : Squads)
+	{
+		Squad.NumMembers = 0;
+		Squad.NumActiveMembers = 0;
+		Squad.ActiveBounds = FBox(ForceInit);
+		Squad.MaxDetectionRange = 0.f;
+	}
+
+	for (const FAmalgamSquadMember& Member : Members)
+	{
+		if (!Squads.IsValidIndex(Member.SquadId)) continue;
+
+		FAmalgamSquad& Squad = Squads[Member.SquadId];
+		++Squad.NumMembers;
+		if (!Member.bActive) continue;
+
+		++Squad.NumActiveMembers;
+		Squad.ActiveBounds += Member.Location;
+		Squad.MaxDetectionRange = FMath::Max(Squad.MaxDetectionRange, Member.DetectionRange);
+	}
+
+	for (auto It = Squads.CreateIterator(); It; ++It)
+	{
+		if (It->NumMembers == 0 && !It->bFresh)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		It->bFresh = false;
+	}
+}
+
+void FAmalgamSquadRegistry::GatherCandidates()
+{
+	TArray<int32> QueryingSquads;
+	for (auto It = Squads.CreateIterator(); It; ++It)
+	{
+		It->bHasCandidates = It->NumActiveMembers >= 2;
+		if (It->bHasCandidates)
+			QueryingSquads.Add(It.GetIndex());
+		else
+			It->Candidates.Reset();
+	}
+
+	if (QueryingSquads.IsEmpty() || !ASpatialHashGrid::IsValid()) return;
+
+	// Anything a member can detect is within the members' spread plus the largest detection range of the squad center
+	ParallelFor(QueryingSquads.Num(), [this, &QueryingSquads](int32 Index)
+		{
+			FAmalgamSquad& Squad = Squads[QueryingSquads[Index]];
+			const FVector Center = Squad.ActiveBounds.GetCenter();
+			const float Range = Squad.ActiveBounds.GetExtent().Size() + Squad.MaxDetectionRange;
+
+			ASpatialHashGrid::GatherTargetCandidatesThreadSafe(Center, Range, Squad.Team, Squad.Candidates);
+		});
+}
+
+const TArray<FGridTargetCandidate>* FAmalgamSquadRegistry::FindCandidates(int32 SquadId, const FVector& Location) const
+{
+	if (!Squads.IsValidIndex(SquadId)) return nullptr;
+
+	const FAmalgamSquad& Squad = Squads[SquadId];
+	if (!Squad.bHasCandidates) return nullptr;
+
+	// Joined the march after the squad pass, the candidates may not cover it
+	if (!Squad.ActiveBounds.IsInsideOrOn(Location)) return nullptr;
+
+	return &Squad.Candidates;
+}
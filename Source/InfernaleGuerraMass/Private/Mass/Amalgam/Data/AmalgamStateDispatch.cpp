@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamStateDispatch.h"
+
+void FAmalgamStateDispatch::GatherEntities(TConstArrayView<FAmalgamStateFragment> States, uint32 StateMask, FEntityIndices& OutIndices)
+{
+	OutIndices.Reset();
+
+	if (StateMask == AllStates)
+	{
+		OutIndices.SetNumUninitialized(States.Num());
+		for (int32 Index = 0; Index < States.Num(); ++Index)
+		{
+			OutIndices[Index] = Index;
+		}
+		return;
+	}
+
+	for (int32 Index = 0; Index < States.Num(); ++Index)
+	{
+		if (StateMask & StateBit(States[Index].GetState()))
+			OutIndices.Add(Index);
+	}
+}
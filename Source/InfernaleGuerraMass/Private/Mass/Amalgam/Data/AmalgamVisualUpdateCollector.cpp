@@ -0,0 +1,348 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamVisualUpdateCollector.h"
+
+#include "GameMode/Infernale/GameModeInfernale.h"
+#include "Mass/Collision/SpatialHashGrid.h"
+#include "Mass/Replication/AmalgamUnitStreamComponent.h"
+#include "Mass/Replication/AmalgamViewReportComponent.h"
+
+void FAmalgamPlayerView::Init(const FVector2D& InCenter, float Radius, const FVector2D& InGridOrigin, const FVector2D& InCellSize)
+{
+	Center = InCenter;
+	RadiusSquared = FMath::Square(Radius);
+	GridOrigin = InGridOrigin;
+	CellSize = InCellSize;
+
+	const FVector2D Local = Center - GridOrigin;
+
+	OuterMin = FIntPoint(FMath::FloorToInt((Local.X - Radius) / CellSize.X), FMath::FloorToInt((Local.Y - Radius) / CellSize.Y));
+	OuterMax = FIntPoint(FMath::FloorToInt((Local.X + Radius) / CellSize.X), FMath::FloorToInt((Local.Y + Radius) / CellSize.Y));
+
+	// Square inscribed in the circle, a cell entirely in it is entirely in the circle
+	const float HalfSide = Radius * UE_INV_SQRT_2;
+	InnerMin = FIntPoint(FMath::CeilToInt((Local.X - HalfSide) / CellSize.X), FMath::CeilToInt((Local.Y - HalfSide) / CellSize.Y));
+	InnerMax = FIntPoint(FMath::FloorToInt((Local.X + HalfSide) / CellSize.X) - 1, FMath::FloorToInt((Local.Y + HalfSide) / CellSize.Y) - 1);
+}
+
+void FAmalgamPlayerView::InitFromReport(const FAmalgamViewReport& Report, const FAmalgamViewCullingSettings& Settings, const FVector2D& InGridOrigin, const FVector2D& InCellSize, const FIntPoint& GridSize,
+	const TSet<FIntPoint>* FixedImpostorBlocks)
+{
+	bUseQuad = true;
+	GridOrigin = InGridOrigin;
+	CellSize = InCellSize;
+	CameraLocation = Report.CameraLocation;
+
+	FVector2D QuadMin = Report.Corners[0];
+	FVector2D QuadMax = Report.Corners[0];
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		Quad[Index] = Report.Corners[Index];
+		QuadMin = FVector2D::Min(QuadMin, Quad[Index]);
+		QuadMax = FVector2D::Max(QuadMax, Quad[Index]);
+	}
+
+	// S * FocalLength / D >= ScreenSize
+	MaxDistanceSquared = Settings.MinScreenSize > 0.f ? FMath::Square(Settings.UnitSize * Report.FocalLength / Settings.MinScreenSize) : TNumericLimits<float>::Max();
+	ImpostorDistanceSquared = Settings.ImpostorScreenSize > 0.f ? FMath::Square(Settings.UnitSize * Report.FocalLength / Settings.ImpostorScreenSize) : TNumericLimits<float>::Max();
+	const int32 BlockSize = FMath::Max(1, Settings.ImpostorBlockSize);
+
+	const FIntPoint GridMax = FIntPoint(FMath::Max(GridSize.X - 1, 0), FMath::Max(GridSize.Y - 1, 0));
+	OuterMin = ToCell(QuadMin).ComponentMax(FIntPoint(0, 0));
+	OuterMax = ToCell(QuadMax).ComponentMin(GridMax);
+
+	CellStates.Reset();
+	ImpostorBlocks.Reset();
+	if (OuterMin.X > OuterMax.X || OuterMin.Y > OuterMax.Y) return;
+
+	CellStates.Reserve((OuterMax.X - OuterMin.X + 1) * (OuterMax.Y - OuterMin.Y + 1));
+	for (int32 Y = OuterMin.Y; Y <= OuterMax.Y; ++Y)
+	{
+		for (int32 X = OuterMin.X; X <= OuterMax.X; ++X)
+		{
+			const FIntPoint Cell(X, Y);
+			EAmalgamCellVisibility State = ClassifyCellAgainstQuad(Cell);
+
+			// Whole blocks switch to impostors, and only when the impostors are sent, so a block is never drawn both ways
+			const FIntPoint Block(X / BlockSize, Y / BlockSize);
+			if (State != EAmalgamCellVisibility::Hidden && Settings.ImpostorScreenSize > 0.f && IsImpostorBlock(Block, BlockSize, FixedImpostorBlocks))
+			{
+				State = EAmalgamCellVisibility::Impostor;
+				ImpostorBlocks.Add(Block);
+			}
+			else if (State != EAmalgamCellVisibility::Hidden)
+			{
+				State = ClassifyCellScreenSize(Cell, State);
+			}
+			CellStates.Add(State);
+		}
+	}
+}
+
+EAmalgamCellVisibility FAmalgamPlayerView::ClassifyCellAgainstQuad(const FIntPoint& Cell) const
+{
+	const FVector2D CellMin = GridOrigin + FVector2D(Cell.X * CellSize.X, Cell.Y * CellSize.Y);
+	const FVector2D CellMax = CellMin + CellSize;
+	const FVector2D CellCorners[4] = { CellMin, FVector2D(CellMax.X, CellMin.Y), CellMax, FVector2D(CellMin.X, CellMax.Y) };
+
+	int32 CornersInQuad = 0;
+	for (const FVector2D& Corner : CellCorners)
+	{
+		if (IsInQuad(Corner)) ++CornersInQuad;
+	}
+
+	if (CornersInQuad == 0)
+	{
+		// No cell corner in the quad, they are disjoint if an edge of the quad separates them (the bounds were already checked)
+		const float Winding = FVector2D::CrossProduct(Quad[1] - Quad[0], Quad[2] - Quad[1]) >= 0.f ? 1.f : -1.f;
+		for (int32 Index = 0; Index < 4; ++Index)
+		{
+			const FVector2D& EdgeStart = Quad[Index];
+			const FVector2D Edge = Quad[(Index + 1) % 4] - EdgeStart;
+
+			bool bSeparates = true;
+			for (const FVector2D& Corner : CellCorners)
+			{
+				if (FVector2D::CrossProduct(Edge, Corner - EdgeStart) * Winding >= 0.f)
+				{
+					bSeparates = false;
+					break;
+				}
+			}
+			if (bSeparates) return EAmalgamCellVisibility::Hidden;
+		}
+	}
+
+	return CornersInQuad == 4 ? EAmalgamCellVisibility::Visible : EAmalgamCellVisibility::Partial;
+}
+
+EAmalgamCellVisibility FAmalgamPlayerView::ClassifyCellScreenSize(const FIntPoint& Cell, EAmalgamCellVisibility QuadState) const
+{
+	const FVector2D CellMin = GridOrigin + FVector2D(Cell.X * CellSize.X, Cell.Y * CellSize.Y);
+	const FVector2D CellMax = CellMin + CellSize;
+
+	// Against the closest and farthest points of the cell
+	const FVector2D Camera2D(CameraLocation.X, CameraLocation.Y);
+	const FVector2D Closest = FVector2D::Max(CellMin, FVector2D::Min(Camera2D, CellMax));
+	if (!IsLargeEnough(Closest)) return EAmalgamCellVisibility::Hidden;
+
+	const FVector2D Farthest(Camera2D.X < (CellMin.X + CellMax.X) * .5f ? CellMax.X : CellMin.X, Camera2D.Y < (CellMin.Y + CellMax.Y) * .5f ? CellMax.Y : CellMin.Y);
+	if (QuadState == EAmalgamCellVisibility::Visible && IsLargeEnough(Farthest)) return EAmalgamCellVisibility::Visible;
+
+	return EAmalgamCellVisibility::Partial;
+}
+
+bool FAmalgamPlayerView::IsImpostorBlock(const FIntPoint& Block, int32 BlockSize, const TSet<FIntPoint>* FixedImpostorBlocks) const
+{
+	if (FixedImpostorBlocks) return FixedImpostorBlocks->Contains(Block);
+
+	const FVector2D BlockExtent = CellSize * BlockSize;
+	const FVector2D BlockMin = GridOrigin + FVector2D(Block.X * BlockExtent.X, Block.Y * BlockExtent.Y);
+	const FVector2D Closest = FVector2D::Max(BlockMin, FVector2D::Min(FVector2D(CameraLocation.X, CameraLocation.Y), BlockMin + BlockExtent));
+	return FVector::DistSquared(CameraLocation, FVector(Closest.X, Closest.Y, 0.f)) > ImpostorDistanceSquared;
+}
+
+bool FAmalgamPlayerView::IsInQuad(const FVector2D& Location) const
+{
+	bool bHasPositive = false;
+	bool bHasNegative = false;
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		const FVector2D& EdgeStart = Quad[Index];
+		const float Cross = FVector2D::CrossProduct(Quad[(Index + 1) % 4] - EdgeStart, Location - EdgeStart);
+		bHasPositive |= Cross > 0.f;
+		bHasNegative |= Cross < 0.f;
+	}
+	return !(bHasPositive && bHasNegative);
+}
+
+bool FAmalgamPlayerView::IsLargeEnough(const FVector2D& Location) const
+{
+	return FVector::DistSquared(CameraLocation, FVector(Location.X, Location.Y, 0.f)) <= MaxDistanceSquared;
+}
+
+FIntPoint FAmalgamPlayerView::ToCell(const FVector2D& Location) const
+{
+	const FVector2D Local = Location - GridOrigin;
+	return FIntPoint(FMath::FloorToInt(Local.X / CellSize.X), FMath::FloorToInt(Local.Y / CellSize.Y));
+}
+
+EAmalgamCellVisibility FAmalgamPlayerView::ClassifyCell(const FIntPoint& Cell) const
+{
+	if (Cell.X < OuterMin.X || Cell.Y < OuterMin.Y || Cell.X > OuterMax.X || Cell.Y > OuterMax.Y)
+		return EAmalgamCellVisibility::Hidden;
+
+	if (bUseQuad)
+		return CellStates[(Cell.Y - OuterMin.Y) * (OuterMax.X - OuterMin.X + 1) + Cell.X - OuterMin.X];
+
+	if (Cell.X >= InnerMin.X && Cell.Y >= InnerMin.Y && Cell.X <= InnerMax.X && Cell.Y <= InnerMax.Y)
+		return EAmalgamCellVisibility::Visible;
+
+	return EAmalgamCellVisibility::Partial;
+}
+
+bool FAmalgamPlayerView::IsVisible(const FVector2D& Location) const
+{
+	switch (ClassifyCell(ToCell(Location)))
+	{
+	case EAmalgamCellVisibility::Hidden:
+	case EAmalgamCellVisibility::Impostor:
+		return false;
+	case EAmalgamCellVisibility::Visible:
+		return true;
+	default:
+		if (bUseQuad) return IsInQuad(Location) && IsLargeEnough(Location);
+		return FVector2D::DistSquared(Center, Location) <= RadiusSquared;
+	}
+}
+
+EAmalgamCellVisibility FAmalgamPlayerView::ClassifyRegion(const FVector2D& Min, const FVector2D& Max, int32 MaxCells) const
+{
+	const FIntPoint CellMin = ToCell(Min);
+	const FIntPoint CellMax = ToCell(Max);
+	if (CellMax.X < OuterMin.X || CellMax.Y < OuterMin.Y || CellMin.X > OuterMax.X || CellMin.Y > OuterMax.Y)
+		return EAmalgamCellVisibility::Hidden;
+
+	if (!bUseQuad)
+	{
+		const bool bInside = CellMin.X >= InnerMin.X && CellMin.Y >= InnerMin.Y && CellMax.X <= InnerMax.X && CellMax.Y <= InnerMax.Y;
+		return bInside ? EAmalgamCellVisibility::Visible : EAmalgamCellVisibility::Partial;
+	}
+
+	const FIntPoint ClampedMin = CellMin.ComponentMax(OuterMin);
+	const FIntPoint ClampedMax = CellMax.ComponentMin(OuterMax);
+	if ((int64)(ClampedMax.X - ClampedMin.X + 1) * (ClampedMax.Y - ClampedMin.Y + 1) > MaxCells)
+		return EAmalgamCellVisibility::Partial;
+
+	// Cells out of the outer bounds are hidden
+	const bool bPartlyOutside = ClampedMin != CellMin || ClampedMax != CellMax;
+	bool bAnyShown = false;
+	bool bAllShown = !bPartlyOutside;
+	for (int32 Y = ClampedMin.Y; Y <= ClampedMax.Y; ++Y)
+	{
+		for (int32 X = ClampedMin.X; X <= ClampedMax.X; ++X)
+		{
+			const EAmalgamCellVisibility State = ClassifyCell(FIntPoint(X, Y));
+			const bool bHidden = State == EAmalgamCellVisibility::Hidden || State == EAmalgamCellVisibility::Impostor;
+			bAnyShown |= !bHidden;
+			bAllShown &= State == EAmalgamCellVisibility::Visible;
+			if (bAnyShown && !bAllShown) return EAmalgamCellVisibility::Partial;
+		}
+	}
+	return bAllShown ? EAmalgamCellVisibility::Visible : EAmalgamCellVisibility::Hidden;
+}
+
+void FAmalgamVisualUpdateCollector::BeginFrame(int32 ExpectedUpdates)
+{
+	FramePlayerControllers.Reset();
+	FrameViewPoints.Reset();
+	for (const FAmalgamPlayerView& View : PlayerViews)
+	{
+		FramePlayerControllers.Add(View.PlayerController);
+		FrameViewPoints.Add(View.bUseQuad ? View.CameraLocation : FVector(View.Center, 0.f));
+	}
+
+	for (const TUniquePtr<FAmalgamPlayerUpdateBuffer>& PlayerBuffer : PlayerBuffers)
+	{
+		PlayerBuffer->Shown.Reserve(ExpectedUpdates);
+	}
+}
+
+void FAmalgamVisualUpdateCollector::Append(int32 ViewIndex, TConstArrayView<FDataForVisualisation> Shown, TConstArrayView<FMassEntityHandle> Hidden)
+{
+	if (Shown.Num() == 0 && Hidden.Num() == 0) return;
+	if (!PlayerBuffers.IsValidIndex(ViewIndex)) return;
+
+	FAmalgamPlayerUpdateBuffer& PlayerBuffer = *PlayerBuffers[ViewIndex];
+
+	FScopeLock ScopeLock(&PlayerBuffer.Lock);
+	PlayerBuffer.Shown.Append(Shown.GetData(), Shown.Num());
+	PlayerBuffer.Hidden.Append(Hidden.GetData(), Hidden.Num());
+}
+
+void FAmalgamVisualUpdateCollector::Flush(TConstArrayView<FMassEntityHandle> Removed)
+{
+	if (UpdateScheduler.IsEnabled())
+		ScheduleUpdates(Removed);
+
+	if (bUseUnitStream)
+	{
+		FlushUnitStream(Removed);
+		return;
+	}
+
+	for (int32 ViewIndex = 0; ViewIndex < PlayerBuffers.Num(); ++ViewIndex)
+	{
+		FAmalgamPlayerUpdateBuffer& PlayerBuffer = *PlayerBuffers[ViewIndex];
+		APlayerControllerInfernale* PlayerController = FramePlayerControllers.IsValidIndex(ViewIndex) ? FramePlayerControllers[ViewIndex].Get() : nullptr;
+
+		if (PlayerController && (PlayerBuffer.Shown.Num() > 0 || PlayerBuffer.Hidden.Num() > 0))
+			PlayerController->UpdateUnits(PlayerBuffer.Shown, PlayerBuffer.Hidden);
+
+		PlayerBuffer.Shown.Reset();
+		PlayerBuffer.Hidden.Reset();
+	}
+	FramePlayerControllers.Reset();
+}
+
+void FAmalgamVisualUpdateCollector::ConfigureUnitStream(bool bInUseUnitStream, const FAmalgamUnitStreamSettings& Settings)
+{
+	bUseUnitStream = bInUseUnitStream;
+	UnitStreamSettings = Settings;
+	UnitStreamSettings.KeyframeInterval = FMath::Max(1, Settings.KeyframeInterval);
+}
+
+void FAmalgamVisualUpdateCollector::ScheduleUpdates(TConstArrayView<FMassEntityHandle> Removed)
+{
+	// Removals come every phase, updates only on simulation steps
+	for (const TUniquePtr<FAmalgamPlayerUpdateBuffer>& PlayerBuffer : PlayerBuffers)
+	{
+		FAmalgamVisualUpdateScheduler::Forget(PlayerBuffer->Schedule, Removed);
+	}
+	if (FramePlayerControllers.Num() == 0) return;
+
+	UpdateScheduler.BeginStep();
+	for (int32 ViewIndex = 0; ViewIndex < PlayerBuffers.Num() && ViewIndex < FrameViewPoints.Num(); ++ViewIndex)
+	{
+		FAmalgamPlayerUpdateBuffer& PlayerBuffer = *PlayerBuffers[ViewIndex];
+		UpdateScheduler.Schedule(PlayerBuffer.Schedule, FrameViewPoints[ViewIndex], PlayerBuffer.Shown, PlayerBuffer.Hidden);
+	}
+}
+
+void FAmalgamVisualUpdateCollector::FlushUnitStream(TConstArrayView<FMassEntityHandle> Removed)
+{
+	StreamRemovals.Append(Removed.GetData(), Removed.Num());
+
+	// Nothing was collected outside of simulation steps
+	if (FramePlayerControllers.Num() == 0) return;
+
+	FAmalgamStreamQuantizer Quantizer;
+	if (!Quantizer.InitFromGrid()) return;
+
+	for (int32 ViewIndex = 0; ViewIndex < PlayerBuffers.Num(); ++ViewIndex)
+	{
+		FAmalgamPlayerUpdateBuffer& PlayerBuffer = *PlayerBuffers[ViewIndex];
+		APlayerControllerInfernale* PlayerController = FramePlayerControllers.IsValidIndex(ViewIndex) ? FramePlayerControllers[ViewIndex].Get() : nullptr;
+
+		// Sent even without updates, the stream resends what the client hasn't acked yet
+		if (UAmalgamUnitStreamComponent* UnitStream = UAmalgamUnitStreamComponent::FindOrAdd(PlayerController))
+			UnitStream->SendUpdates(Quantizer, UnitStreamSettings, PlayerBuffer.Shown, PlayerBuffer.Hidden, StreamRemovals);
+
+		PlayerBuffer.Shown.Reset();
+		PlayerBuffer.Hidden.Reset();
+	}
+	StreamRemovals.Reset();
+	FramePlayerControllers.Reset();
+}
+
+void FAmalgamVisualUpdateCollector::SetPlayerViews(TArray<FAmalgamPlayerView>&& InPlayerViews)
+{
+	PlayerViews = MoveTemp(InPlayerViews);
+
+	// Buffers are matched by index with the views, only grow so the allocations stay around
+	while (PlayerBuffers.Num() < PlayerViews.Num())
+	{
+		PlayerBuffers.Add(MakeUnique<FAmalgamPlayerUpdateBuffer>());
+	}
+}
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Data/AmalgamVisualUpdateScheduler.h"
+
+// Priority of the units past MaxStaleness, above any error ratio and still exact once their staleness is added
+static constexpr float OverdueKey = 1.e6f;
+static constexpr uint32 MaxOverdueSteps = 1 << 20;
+
+void FAmalgamVisualUpdateScheduler::BeginStep()
+{
+	++Step;
+	TotalStats += StepStats;
+	StepStats.Reset();
+}
+
+void FAmalgamVisualUpdateScheduler::Schedule(FAmalgamPlayerSchedule& Schedule, const FVector& ViewPoint, TArray<FDataForVisualisation>& InOutShown, TConstArrayView<FMassEntityHandle> Hidden)
+{
+	Forget(Schedule, Hidden);
+
+	const int32 Budget = Settings.Budget > 0 ? Settings.Budget : InOutShown.Num();
+	const FVector2D ViewPoint2D(ViewPoint.X, ViewPoint.Y);
+
+	// Overdue units sort first, oldest first, the others by error on screen
+	Candidates.Reset(InOutShown.Num());
+	int32 NumOverdue = 0;
+	for (int32 Index = 0; Index < InOutShown.Num(); ++Index)
+	{
+		const FDataForVisualisation& Data = InOutShown[Index];
+		const FAmalgamPlayerSchedule::FSentUnit* Sent = Schedule.SentUnits.Find(Data.EntityHandle);
+		const uint32 Staleness = Sent ? Step - Sent->Step : MAX_uint32;
+
+		if (Staleness >= (uint32)Settings.MaxStaleness)
+		{
+			// Units never sent come first
+			Candidates.Emplace(Sent ? OverdueKey + (float)FMath::Min(Staleness, MaxOverdueSteps) : TNumericLimits<float>::Max(), Index);
+			++NumOverdue;
+			continue;
+		}
+
+		const FVector2D Location(Data.LocationX, Data.LocationY);
+		const FVector2D Direction(Data.RotationX, Data.RotationY);
+		const float Motion = FVector2D::Distance(Location, Sent->Location);
+		const float Turn = (1.f - FVector2D::DotProduct(Direction, Sent->Direction)) * .5f * Settings.TurnWeight;
+		const float Error = Motion + Turn + Staleness * Settings.StalenessWeight;
+
+		const float ViewDistance = FMath::Max(FMath::Sqrt(FVector::DistSquared(ViewPoint, FVector(Location, 0.f))), Settings.MinViewDistance);
+		Candidates.Emplace(FMath::Min(Error / ViewDistance, OverdueKey), Index);
+	}
+
+	// Overdue units count against the budget too, the ones left out are even older on the next step and go first
+	const int32 NumSent = FMath::Min(Budget, Candidates.Num());
+	if (NumSent < Candidates.Num())
+		Candidates.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key > B.Key; });
+
+	Selected.Reset(NumSent);
+	for (int32 Rank = 0; Rank < NumSent; ++Rank)
+	{
+		const FDataForVisualisation& Data = InOutShown[Candidates[Rank].Value];
+		Selected.Add(Data);
+
+		FAmalgamPlayerSchedule::FSentUnit& Sent = Schedule.SentUnits.FindOrAdd(Data.EntityHandle);
+		Sent.Location = FVector2D(Data.LocationX, Data.LocationY);
+		Sent.Direction = FVector2D(Data.RotationX, Data.RotationY);
+		Sent.Step = Step;
+	}
+
+	StepStats.Sent += NumSent;
+	StepStats.Deferred += Candidates.Num() - NumSent;
+	StepStats.Overdue += FMath::Max(NumOverdue - NumSent, 0);
+
+	// Swap so both allocations are kept around
+	Swap(InOutShown, Selected);
+}
+
+void FAmalgamVisualUpdateScheduler::Forget(FAmalgamPlayerSchedule& Schedule, TConstArrayView<FMassEntityHandle> Removed)
+{
+	for (const FMassEntityHandle& Entity : Removed)
+	{
+		Schedule.SentUnits.Remove(Entity);
+	}
+}
@@ -18,6 +18,9 @@
 
 #include "Mass/Collision/SpatialHashGrid.h"
 
+//Subsystem
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+
 UAmalgamKillObserver::UAmalgamKillObserver() : EntityQuery(*this)
 {
 	ObservedType = FAmalgamKillTag::StaticStruct();
@@ -41,17 +44,10 @@ void UAmalgamKillObserver::ConfigureQueries()
 
 void UAmalgamKillObserver::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
-	if (!VisualisationManager)
+	if (!SimulationSubsystem)
 	{
-		TArray<AActor*> OutActors;
-		UGameplayStatics::GetAllActorsOfClass(GetWorld(), AAmalgamVisualisationManager::StaticClass(), OutActors);
-
-		if (OutActors.Num() > 0)
-			VisualisationManager = static_cast<AAmalgamVisualisationManager*>(OutActors[0]);
-		else
-			VisualisationManager = nullptr;
-
-		check(VisualisationManager);
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
 	}
 	/*if (!FogManager)
 	{
@@ -66,6 +62,8 @@ void UAmalgamKillObserver::Execute(FMassEntityManager& EntityManager, FMassExecu
 		check(FogManager);
 	}*/
 
+	KilledEntities.Reset();
+
 	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context)
 		{
 			TArrayView<FAmalgamTargetFragment> TargetFragView = Context.GetMutableFragmentView<FAmalgamTargetFragment>();
@@ -78,7 +76,7 @@ void UAmalgamKillObserver::Execute(FMassEntityManager& EntityManager, FMassExecu
 				EAmalgamDeathReason DeathReason = StateFragView[Index].GetDeathReason();
 
 				FMassEntityHandle Handle = Context.GetEntity(Index);
-				FMassEntityHandle TargetHandle = TargetFragView[Index].GetTargetEntityHandle();
+				const FGridTargetRef& TargetRef = TargetFragView[Index].GetTargetRef();
 
 				//HashGridCell* Cell = ASpatialHashGrid::GetCellRef(Handle);
 				//TWeakObjectPtr<ASoulBeacon> Beacon = ASpatialHashGrid::IsInSoulBeaconRangeByCell(Cell);
@@ -90,15 +88,12 @@ void UAmalgamKillObserver::Execute(FMassEntityManager& EntityManager, FMassExecu
 					else RewardMap.Add(Beacon, 1);
 				}
 
-				if(ASpatialHashGrid::Contains(TargetHandle))
-					ASpatialHashGrid::GetMutableEntityData(TargetHandle)->AggroCount--;
+				if (GridCellEntityData* TargetData = ASpatialHashGrid::GetMutableEntityData(TargetRef))
+					TargetData->AggroCount--;
 
 				/*if (FogManager->Contains(Handle))
 					FogManager->RemoveMassEntityVision(Handle);*/
 
-				ASpatialHashGrid::RemoveEntityFromGrid(Handle);
-				VisualisationManager->RemoveFromMapP(Handle);
-
 				if (DeathReason == EAmalgamDeathReason::Error)
 					UE_LOG(LogTemp, Error, TEXT("Error caused amalgam death"));
 			}
@@ -111,7 +106,13 @@ void UAmalgamKillObserver::Execute(FMassEntityManager& EntityManager, FMassExecu
 				Beacon->RewardMultiple(ESoulBeaconRewardType::RewardAmalgam, RewardMap[Beacon]);
 			}
 
+			KilledEntities.Append(Context.GetEntities().GetData(), Context.GetNumEntities());
+
 			if(bDebug) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Green, FString::Printf(TEXT("KillObserver : Cleared %d Entities"), Context.GetNumEntities()));
 			Context.Defer().DestroyEntities(Context.GetEntities());
 		});
+
+	// Grid cells and the presence array are refreshed once for the whole batch, the visuals go in the frame's removal message
+	ASpatialHashGrid::RemoveEntitiesFromGrid(KilledEntities);
+	SimulationSubsystem->QueueVisualRemovals(KilledEntities);
 }
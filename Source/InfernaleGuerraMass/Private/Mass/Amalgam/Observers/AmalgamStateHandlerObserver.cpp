@@ -14,6 +14,24 @@
 #include "MassExecutionContext.h"
 #include <MassEntityTemplateRegistry.h>
 
+//Subsystem
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+
+namespace
+{
+	// An opted-in tag is present exactly while the entity is in its state
+	template<typename TTag>
+	void SyncStateTag(EAmalgamState TaggedState, EAmalgamState State, const UAmalgamSimulationSubsystem& Settings, FMassExecutionContext& Context, FMassEntityHandle Entity)
+	{
+		if (!Settings.IsStateTagged(TaggedState)) return;
+
+		if (State == TaggedState)
+			Context.Defer().AddTag<TTag>(Entity);
+		else
+			Context.Defer().RemoveTag<TTag>(Entity);
+	}
+}
+
 UAmalgamStateHandlerObserver::UAmalgamStateHandlerObserver() : EntityQuery(*this)
 {
 	ObservedType = FAmalgamStateChangeTag::StaticStruct();
@@ -34,7 +52,9 @@ void UAmalgamStateHandlerObserver::ConfigureQueries()
 
 void UAmalgamStateHandlerObserver::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
-	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context)
+	const UAmalgamSimulationSubsystem* Settings = GetDefault<UAmalgamSimulationSubsystem>();
+
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this, Settings](FMassExecutionContext& Context)
 		{
 			TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
 
@@ -43,35 +63,63 @@ void UAmalgamStateHandlerObserver::Execute(FMassEntityManager& EntityManager, FM
 				FAmalgamStateFragment& StateFragment = StateFragView[Index];
 
 				Context.Defer().RemoveTag<FAmalgamInitializeTag>(Context.GetEntity(Index));
-				Context.Defer().RemoveTag<FAmalgamInactiveTag>(Context.GetEntity(Index));
-				
-				switch (StateFragment.GetState())
-				{
-				case EAmalgamState::Aggroed:
-					Context.Defer().AddTag<FAmalgamAggroTag>(Context.GetEntity(Index));
-					break;
-
-				case EAmalgamState::Fighting:
-					Context.Defer().AddTag<FAmalgamFightTag>(Context.GetEntity(Index));
-					Context.Defer().RemoveTag<FAmalgamMoveTag>(Context.GetEntity(Index));
-					break;
-
-				case EAmalgamState::FollowPath:
-					Context.Defer().AddTag<FAmalgamMoveTag>(Context.GetEntity(Index));
-					Context.Defer().RemoveTag<FAmalgamAggroTag>(Context.GetEntity(Index));
-					Context.Defer().RemoveTag<FAmalgamFightTag>(Context.GetEntity(Index));
-					break;
-
-				case EAmalgamState::Inactive:
-					Context.Defer().AddTag<FAmalgamInactiveTag>(Context.GetEntity(Index));
-					break;
-
-				default:
-					Context.Defer().AddTag<FAmalgamKillTag>(Context.GetEntity(Index));
-					break;
-				}	
+
+				// Dead reckoning only makes sense while marching
+				if (StateFragment.GetState() != EAmalgamState::FollowPath)
+					Context.Defer().RemoveTag<FAmalgamDeadReckoningTag>(Context.GetEntity(Index));
+
+				if (Settings->UsesStateTags())
+					ApplyStateTags(StateFragment.GetState(), Context, Index);
+				else
+					SyncOptedInStateTags(StateFragment.GetState(), *Settings, Context, Index);
 				
 				Context.Defer().RemoveTag<FAmalgamStateChangeTag>(Context.GetEntity(Index));
 			}
 		});
 }
+
+void UAmalgamStateHandlerObserver::ApplyStateTags(EAmalgamState State, FMassExecutionContext& Context, int32 EntityIndex)
+{
+	const FMassEntityHandle Entity = Context.GetEntity(EntityIndex);
+
+	Context.Defer().RemoveTag<FAmalgamInactiveTag>(Entity);
+
+	switch (State)
+	{
+	case EAmalgamState::Aggroed:
+		Context.Defer().AddTag<FAmalgamAggroTag>(Entity);
+		break;
+
+	case EAmalgamState::Fighting:
+		Context.Defer().AddTag<FAmalgamFightTag>(Entity);
+		Context.Defer().RemoveTag<FAmalgamMoveTag>(Entity);
+		break;
+
+	case EAmalgamState::FollowPath:
+		Context.Defer().AddTag<FAmalgamMoveTag>(Entity);
+		Context.Defer().RemoveTag<FAmalgamAggroTag>(Entity);
+		Context.Defer().RemoveTag<FAmalgamFightTag>(Entity);
+		break;
+
+	case EAmalgamState::Inactive:
+		Context.Defer().AddTag<FAmalgamInactiveTag>(Entity);
+		break;
+
+	default:
+		Context.Defer().AddTag<FAmalgamKillTag>(Entity);
+		break;
+	}
+}
+
+void UAmalgamStateHandlerObserver::SyncOptedInStateTags(EAmalgamState State, const UAmalgamSimulationSubsystem& Settings, FMassExecutionContext& Context, int32 EntityIndex)
+{
+	const FMassEntityHandle Entity = Context.GetEntity(EntityIndex);
+
+	SyncStateTag<FAmalgamMoveTag>(EAmalgamState::FollowPath, State, Settings, Context, Entity);
+	SyncStateTag<FAmalgamAggroTag>(EAmalgamState::Aggroed, State, Settings, Context, Entity);
+	SyncStateTag<FAmalgamFightTag>(EAmalgamState::Fighting, State, Settings, Context, Entity);
+	SyncStateTag<FAmalgamInactiveTag>(EAmalgamState::Inactive, State, Settings, Context, Entity);
+
+	if (State == EAmalgamState::Killed)
+		Context.Defer().AddTag<FAmalgamKillTag>(Entity);
+}
@@ -18,6 +18,8 @@
 //Subsystem
 #include "MassSignalSubsystem.h"
 #include "MassStateTreeExecutionContext.h"
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Amalgam/Data/AmalgamStateDispatch.h"
 
 //Spawner
 #include "Mass/Spawner/AmalgamSpawerParent.h"
@@ -36,18 +38,24 @@ UAmalgamAggroProcessor::UAmalgamAggroProcessor() : EntityQuery(*this)
 	bAutoRegisterWithProcessingPhases = true;
 	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
 	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
+
+	// Refreshes the grid target snapshots before spreading the chunks over worker threads
+	bRequiresGameThreadExecution = true;
 }
 
 void UAmalgamAggroProcessor::ConfigureQueries()
 {
-	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamTargetFragment>(EMassFragmentAccess::ReadWrite);
-	EntityQuery.AddRequirement<FAmalgamAggroFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamAggroFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadWrite);
-	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadWrite);
-	EntityQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamSquadFragment>(EMassFragmentAccess::ReadOnly);
 
-	EntityQuery.AddTagRequirement<FAmalgamAggroTag>(EMassFragmentPresence::None);
+	if (GetDefault<UAmalgamSimulationSubsystem>()->UsesStateTags())
+		EntityQuery.AddTagRequirement<FAmalgamAggroTag>(EMassFragmentPresence::None);
+	EntityQuery.AddTagRequirement<FAmalgamDeadReckoningTag>(EMassFragmentPresence::None);
 	EntityQuery.AddTagRequirement<FAmalgamClientExecuteTag>(EMassFragmentPresence::None);
 
 	EntityQuery.RegisterWithProcessor(*this);
@@ -55,82 +63,71 @@ void UAmalgamAggroProcessor::ConfigureQueries()
 
 void UAmalgamAggroProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
-	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context)
-		{
-			/*CheckTimer += Context.GetDeltaTimeSeconds();
-			if (!(CheckTimer > CheckDelay)) return;
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	if (!SimulationSubsystem->GetSimulationClock().ShouldStep()) return;
+	if (!ASpatialHashGrid::IsValid()) return;
 
-			CheckTimer = 0.f;*/
+	// Buildings and LD elements are read from snapshots, the chunks below never touch an actor
+	ASpatialHashGrid::RefreshTargetSnapshots();
 
-			TArrayView<FTransformFragment> TransformView = Context.GetMutableFragmentView<FTransformFragment>();
+	// Only marching amalgams look for a target
+	const uint32 StateMask = SimulationSubsystem->UsesStateTags() ? FAmalgamStateDispatch::AllStates : FAmalgamStateDispatch::StateBit(EAmalgamState::FollowPath);
+
+	// Filled by UAmalgamSquadProcessor earlier in the step, read only from here
+	const FAmalgamSquadRegistry* SquadRegistry = SimulationSubsystem->UsesSquads() ? &SimulationSubsystem->GetSquadRegistry() : nullptr;
+
+	EntityQuery.ParallelForEachEntityChunk(EntityManager, Context, [this, StateMask, SquadRegistry](FMassExecutionContext& Context)
+		{
+			const TConstArrayView<FTransformFragment> TransformView = Context.GetFragmentView<FTransformFragment>();
 			TArrayView<FAmalgamTargetFragment> TargetFragView = Context.GetMutableFragmentView<FAmalgamTargetFragment>();
-			TArrayView<FAmalgamAggroFragment> AggroFragView = Context.GetMutableFragmentView<FAmalgamAggroFragment>();
-			TArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetMutableFragmentView<FAmalgamOwnerFragment>();
+			const TConstArrayView<FAmalgamAggroFragment> AggroFragView = Context.GetFragmentView<FAmalgamAggroFragment>();
+			const TConstArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetFragmentView<FAmalgamOwnerFragment>();
 			TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
-			TArrayView<FAmalgamDirectionFragment> DirectionFragView = Context.GetMutableFragmentView<FAmalgamDirectionFragment>();
+			const TConstArrayView<FAmalgamDirectionFragment> DirectionFragView = Context.GetFragmentView<FAmalgamDirectionFragment>();
+			const TConstArrayView<FAmalgamSquadFragment> SquadFragView = Context.GetFragmentView<FAmalgamSquadFragment>();
+
+			FAmalgamStateDispatch::FEntityIndices EntityIndices;
+			FAmalgamStateDispatch::GatherEntities(StateFragView, StateMask, EntityIndices);
 
-			for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index)
+			for (const int32 Index : EntityIndices)
 			{
 				if (StateFragView[Index].GetState() == EAmalgamState::Fighting)
 					continue;
 				
-				FTransformFragment& TransformFragment = TransformView[Index];
+				const FAmalgamAggroFragment& AggroFragment = AggroFragView[Index];
 				FAmalgamTargetFragment& TargetFragment = TargetFragView[Index];
-				FAmalgamAggroFragment& AggroFragment = AggroFragView[Index];
-				FAmalgamOwnerFragment& OwnerFragment = OwnerFragView[Index];
-				FAmalgamDirectionFragment& DirectionFragment = DirectionFragView[Index];
-
-				FVector Location = TransformFragment.GetTransform().GetLocation();
-
 				FAmalgamStateFragment& StateFragment = StateFragView[Index];
-			
-
-				// check for entities in fight range before anything else
-
-				//float DetectionRange = 2800.f;
-				float DetectionRange = AggroFragment.GetAggroRange() + AggroFragment.GetTargetableRange();
 
+				const FVector Location = TransformView[Index].GetTransform().GetLocation();
+				const float DetectionRange = AggroFragment.GetAggroRange() + AggroFragment.GetTargetableRange();
 
-				/*FMassEntityHandle PrioritizedEntity = ASpatialHashGrid::FindClosestEntity(Location, AggroFragment.GetFightRange(), 360.f, DirectionFragment.Direction, Context.GetEntity(Index), OwnerFragment.GetOwner().Team);
+				// Squad members refine the candidates of their squad instead of querying the grid
+				const bool bCanUseSquad = SquadRegistry && StateFragment.GetState() == EAmalgamState::FollowPath;
+				const TArray<FGridTargetCandidate>* SquadCandidates = bCanUseSquad ? SquadRegistry->FindCandidates(SquadFragView[Index].GetSquadId(), Location) : nullptr;
 
-				if (PrioritizedEntity.IsValid())
-				{
-					if(bDebug) DrawDebugLine(Context.GetWorld(), Location, ASpatialHashGrid::GetEntityData(PrioritizedEntity).Location, FColor::Orange, false, 1.5f);
-					StateFragment.SetAggro(EAmalgamAggro::Amalgam);
-					TargetFragment.SetTargetBuilding(nullptr);
-					TargetFragment.SetTargetLDElem(nullptr);
-					TargetFragment.SetTargetEntityHandle(PrioritizedEntity);
-					if (bDebug) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Orange, FString::Printf(TEXT("AggroProcessor : \n\t Entity prioritized in fight range")));
-					StateFragment.SetStateAndNotify(EAmalgamState::Aggroed, Context, Index);
-					continue;
-				}*/
-
-				/*FMassEntityHandle FoundEntity = ASpatialHashGrid::FindClosestEntity(Location, DetectionRange, AggroFragment.GetAggroAngle(), DirectionFragment.Direction, Context.GetEntity(Index), OwnerFragment.GetOwner().Team);
-				TWeakObjectPtr<ABuildingParent> FoundBuilding = ASpatialHashGrid::FindClosestBuilding(Location, DetectionRange, AggroFragment.GetAggroAngle(), DirectionFragment.Direction, Context.GetEntity(Index), OwnerFragment.GetOwner().Team);
-				TWeakObjectPtr<ALDElement> FoundLDElem = ASpatialHashGrid::FindClosestLDElement(Location, DetectionRange, AggroFragment.GetAggroAngle(), DirectionFragment.Direction, Context.GetEntity(Index), OwnerFragment.GetOwner().Team);*/
-
-				FDetectionResult Detected = ASpatialHashGrid::FindClosestElementsInRange(Location, DetectionRange, AggroFragment.GetAggroAngle(), DirectionFragment.Direction, Context.GetEntity(Index));
+				FDetectionResult Detected = SquadCandidates
+					? ASpatialHashGrid::FindClosestElementsInCandidates(*SquadCandidates, Location, DetectionRange, AggroFragment.GetAggroAngle(), DirectionFragView[Index].Direction)
+					: ASpatialHashGrid::FindClosestElementsInRangeThreadSafe(Location, DetectionRange, AggroFragment.GetAggroAngle(), DirectionFragView[Index].Direction, OwnerFragView[Index].GetOwner().Team);
 
 				float AmalgamDist = TNumericLimits<float>::Max();
 				if (Detected.Entity.IsSet())
 					AmalgamDist = Detected.EntityDistance - AggroFragment.GetTargetableRange();
 
 				float BuildingDist = TNumericLimits<float>::Max();
-				if (Detected.Building.IsValid())
+				if (!Detected.Building.IsExplicitlyNull())
 					BuildingDist = Detected.BuildingDistance - AggroFragment.GetTargetableRange();
 
 				float LDDist = TNumericLimits<float>::Max();
-				if (Detected.LD.IsValid())
+				if (!Detected.LD.IsExplicitlyNull())
 					LDDist = Detected.LDDistance - AggroFragment.GetTargetableRange();
 
 				EAmalgamAggro TypeDetected = ClosestDetected(AmalgamDist, BuildingDist, LDDist);
 				
-				//ASpatialHashGrid::DebugDetectionCell(Location, DetectionRange);
-				//if (Index % 2 == 0)
-					//ASpatialHashGrid::DebugDetectionCone(Location, DetectionRange, AggroFragment.GetAggroAngle(), DirectionFragment.Direction, Detected != EAmalgamAggro::NoAggro);
-				
-				IUnitTargetable* TargetActor = TypeDetected == EAmalgamAggro::Building ? Cast<IUnitTargetable>(Detected.Building.Get()) : Cast<IUnitTargetable>(Detected.LD.Get());
-				AggroDetected(TypeDetected, StateFragment, TargetFragment, Detected.Entity, TargetActor, Context, Index);
+				AggroDetected(TypeDetected, StateFragment, TargetFragment, Detected, Context, Index);
 			}
 		});
 }
@@ -152,7 +149,7 @@ EAmalgamAggro UAmalgamAggroProcessor::ClosestDetected(float AmalgamDist, float B
 	return BuildingSmaller ? EAmalgamAggro::Building : EAmalgamAggro::LDElement;
 }
 
-void UAmalgamAggroProcessor::AggroDetected(EAmalgamAggro Detected, FAmalgamStateFragment& StateFragment, FAmalgamTargetFragment& TargetFragment, FMassEntityHandle Handle, IUnitTargetable* Target, FMassExecutionContext& Context, int32 EntityIndex)
+void UAmalgamAggroProcessor::AggroDetected(EAmalgamAggro Detected, FAmalgamStateFragment& StateFragment, FAmalgamTargetFragment& TargetFragment, const FDetectionResult& DetectionResult, FMassExecutionContext& Context, int32 EntityIndex)
 {
 	StateFragment.SetAggro(Detected);
 	TargetFragment.ResetTargets();
@@ -163,13 +160,16 @@ void UAmalgamAggroProcessor::AggroDetected(EAmalgamAggro Detected, FAmalgamState
 		StateFragment.SetStateAndNotify(EAmalgamState::FollowPath, Context, EntityIndex);
 		return;
 	case EAmalgamAggro::Amalgam:
-		TargetFragment.SetTargetEntityHandle(Handle);
+		TargetFragment.SetTargetEntityHandle(DetectionResult.Entity);
+		TargetFragment.SetTargetRef(DetectionResult.EntityRef);
 		break;
 	case EAmalgamAggro::Building:
-		TargetFragment.SetTargetBuilding(Cast<ABuildingParent>(Target));
+		TargetFragment.SetTargetBuilding(DetectionResult.Building);
+		TargetFragment.SetTargetRef(DetectionResult.BuildingRef);
 		break;
 	case EAmalgamAggro::LDElement:
-		TargetFragment.SetTargetLDElem(Cast<ALDElement>(Target));
+		TargetFragment.SetTargetLDElem(DetectionResult.LD);
+		TargetFragment.SetTargetRef(DetectionResult.LDRef);
 		break;
 	default:
 		StateFragment.Kill(EAmalgamDeathReason::Error, Context, EntityIndex);
@@ -16,32 +16,108 @@
 
 //Subsystem
 #include "MassSignalSubsystem.h"
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+
+#include "GameFramework/GameStateBase.h"
+#include "Manager/AmalgamVisualisationManager.h"
+#include <Kismet/GameplayStatics.h>
 
 UAmalgamClientMoveProcessor::UAmalgamClientMoveProcessor() : EntityQuery(*this)
 {
-	bAutoRegisterWithProcessingPhases = false;
+	bAutoRegisterWithProcessingPhases = true;
 	ExecutionFlags = (int32)EProcessorExecutionFlags::Client | (int32)EProcessorExecutionFlags::Standalone;
 	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
 
-	// Should run on game thread because it is requiered by Niagara to move systems
+	// Registers fluxes in the path cache and moves the visuals
 	bRequiresGameThreadExecution = true;
 }
 
 void UAmalgamClientMoveProcessor::ConfigureQueries()
 {
-	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
-	EntityQuery.AddRequirement<FAmalgamNiagaraFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamClientPathFragment>(EMassFragmentAccess::ReadOnly);
 
 	EntityQuery.RegisterWithProcessor(*this);
 }
 
 /*
-* No more processing outside of server
+* Only amalgams the server put on a path are moved, the others are still driven by the server updates
 */
 void UAmalgamClientMoveProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	if (!SimulationSubsystem->UsesClientPathSimulation()) return;
+
+	// Paths are timed on the server clock
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	if (!GameState) return;
+	const double ServerTime = GameState->GetServerWorldTimeSeconds();
+
+	FAmalgamFluxPathCache& FluxPathCache = SimulationSubsystem->GetFluxPathCache();
+	SimulatedUnits.Reset();
+
 	EntityQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& Context)
 		{
+			const TArrayView<FTransformFragment> TransformView = Context.GetMutableFragmentView<FTransformFragment>();
+			const TArrayView<FAmalgamDirectionFragment> DirectionFragView = Context.GetMutableFragmentView<FAmalgamDirectionFragment>();
+			const TConstArrayView<FAmalgamClientPathFragment> PathFragView = Context.GetFragmentView<FAmalgamClientPathFragment>();
+
+			for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index)
+			{
+				const FAmalgamClientPathFragment& PathFragment = PathFragView[Index];
+				if (!PathFragment.IsActive()) continue;
+
+				AFlux* Flux = PathFragment.GetFlux();
+				if (!Flux) continue;
+
+				// Baked on first use, and rebaked by the cache when the replicated flux changes
+				const TSharedPtr<const FAmalgamFluxPathLUT>* FluxPath = FluxPathCache.Find(FObjectKey(Flux));
+				if (!FluxPath)
+				{
+					FluxPathCache.Register(Flux);
+					FluxPath = FluxPathCache.Find(FObjectKey(Flux));
+				}
+				if (!FluxPath || !FluxPath->IsValid()) continue;
+
+				// Another bake would drift from the server, the amalgam stays at its replicated location until the flux catches up
+				const FAmalgamFluxPathLUT& PathLUT = **FluxPath;
+				if (!PathFragment.MatchesPath(PathLUT)) continue;
+
+				// The server takes the amalgam off the path before it reaches the end
+				const float Distance = FMath::Clamp(PathFragment.GetDistance(ServerTime), 0.f, PathLUT.Length);
+				const FVector Location = PathLUT.GetPositionAtDistance(Distance);
+				const FVector Direction = PathLUT.GetTangentAtDistance(Distance);
+
+				TransformView[Index].GetMutableTransform().SetLocation(Location);
+				DirectionFragView[Index].Direction = Direction;
+
+				FDataForVisualisation& Data = SimulatedUnits.AddDefaulted_GetRef();
+				Data.EntityHandle = FMassEntityHandle::FromNumber(PathFragment.GetVisualHandle());
+				Data.LocationX = Location.X;
+				Data.LocationY = Location.Y;
+				Data.RotationX = Direction.X;
+				Data.RotationY = Direction.Y;
+			}
 		});
 
+	if (SimulatedUnits.Num() == 0) return;
+
+	if (AAmalgamVisualisationManager* Manager = GetVisualisationManager())
+		Manager->UpdateSimulatedUnits(SimulatedUnits);
+}
+
+AAmalgamVisualisationManager* UAmalgamClientMoveProcessor::GetVisualisationManager()
+{
+	if (VisualisationManager.IsValid()) return VisualisationManager.Get();
+
+	AActor* Actor = UGameplayStatics::GetActorOfClass(GetWorld(), AAmalgamVisualisationManager::StaticClass());
+	if (!Actor) return nullptr;
+
+	VisualisationManager = static_cast<AAmalgamVisualisationManager*>(Actor);
+	return VisualisationManager.Get();
 }
@@ -0,0 +1,135 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Processors/AmalgamDeadReckoningProcessor.h"
+
+//Tags
+#include "Mass/Army/AmalgamTags.h"
+
+//Fragments
+#include "Mass/Army/AmalgamFragments.h"
+#include "MassCommonFragments.h"
+
+//Processor
+#include "MassExecutionContext.h"
+#include "Mass/Amalgam/Processors/AmalgamMoveProcessor.h"
+#include "Mass/Amalgam/Processors/AmalgamVisibilityProcessor.h"
+#include "Mass/Collision/SpatialHashGridProcessor.h"
+
+//Subsystem
+#include <Mass/Collision/SpatialHashGrid.h>
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Amalgam/Data/AmalgamStateDispatch.h"
+
+UAmalgamDeadReckoningProcessor::UAmalgamDeadReckoningProcessor() : EntityQuery(*this)
+{
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+	ExecutionOrder.ExecuteAfter.Add(UAmalgamMoveProcessor::StaticClass()->GetFName());
+	// Grid and visibility read the transform we write
+	ExecutionOrder.ExecuteBefore.Add(USpatialHashGridProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(UAmalgamVisibilityProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
+
+	bAutoRegisterWithProcessingPhases = true;
+	bRequiresGameThreadExecution = false;
+}
+
+void UAmalgamDeadReckoningProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamDeadReckoningFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamPathfindingFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamMovementFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamAggroFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamFluxFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddSharedRequirement<FAmalgamTransmutationSharedFragment>(EMassFragmentAccess::ReadOnly);
+
+	EntityQuery.AddTagRequirement<FAmalgamDeadReckoningTag>(EMassFragmentPresence::All);
+	if (GetDefault<UAmalgamSimulationSubsystem>()->UsesStateTags())
+		EntityQuery.AddTagRequirement<FAmalgamMoveTag>(EMassFragmentPresence::All);
+
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UAmalgamDeadReckoningProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	const FAmalgamSimulationClock& Clock = SimulationSubsystem->GetSimulationClock();
+	if (!Clock.ShouldStep()) return;
+
+	const FAmalgamFluxPathCache& FluxPathCache = SimulationSubsystem->GetFluxPathCache();
+	const bool bUseDeadReckoning = SimulationSubsystem->UsesDeadReckoning();
+	const int32 CheckInterval = SimulationSubsystem->GetDeadReckoningCheckInterval();
+	const float WakeMargin = SimulationSubsystem->GetDeadReckoningWakeMargin();
+	const double SimulationTime = Clock.GetSimulationTime();
+	const uint32 StateMask = SimulationSubsystem->UsesStateTags() ? FAmalgamStateDispatch::AllStates : FAmalgamStateDispatch::StateBit(EAmalgamState::FollowPath);
+
+	EntityQuery.ParallelForEachEntityChunk(EntityManager, Context, ([&](FMassExecutionContext& Context)
+	{
+		TArrayView<FTransformFragment> TransformView = Context.GetMutableFragmentView<FTransformFragment>();
+		TArrayView<FAmalgamDirectionFragment> DirectionFragView = Context.GetMutableFragmentView<FAmalgamDirectionFragment>();
+		TArrayView<FAmalgamDeadReckoningFragment> DeadReckoningFragView = Context.GetMutableFragmentView<FAmalgamDeadReckoningFragment>();
+		TArrayView<FAmalgamPathfindingFragment> PathFragView = Context.GetMutableFragmentView<FAmalgamPathfindingFragment>();
+		const TConstArrayView<FAmalgamMovementFragment> MovementFragView = Context.GetFragmentView<FAmalgamMovementFragment>();
+		const TConstArrayView<FAmalgamAggroFragment> AggroFragView = Context.GetFragmentView<FAmalgamAggroFragment>();
+		const TConstArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetFragmentView<FAmalgamOwnerFragment>();
+		const TConstArrayView<FAmalgamFluxFragment> FluxFragView = Context.GetFragmentView<FAmalgamFluxFragment>();
+		const TConstArrayView<FAmalgamStateFragment> StateFragView = Context.GetFragmentView<FAmalgamStateFragment>();
+		const FAmalgamTransmutationSharedFragment& Transmutation = Context.GetSharedFragment<FAmalgamTransmutationSharedFragment>();
+
+		// The state change observer drops the tag when a reckoning amalgam leaves FollowPath
+		FAmalgamStateDispatch::FEntityIndices EntityIndices;
+		FAmalgamStateDispatch::GatherEntities(StateFragView, StateMask, EntityIndices);
+
+		for (const int32 Index : EntityIndices)
+		{
+			const FMassEntityHandle Entity = Context.GetEntity(Index);
+			FAmalgamPathfindingFragment& PathFragment = PathFragView[Index];
+			FAmalgamDeadReckoningFragment& DeadReckoningFragment = DeadReckoningFragView[Index];
+
+			const TSharedPtr<const FAmalgamFluxPathLUT>& PathLUT = PathFragment.GetPathLUT();
+			if (!PathLUT.IsValid())
+			{
+				Context.Defer().RemoveTag<FAmalgamDeadReckoningTag>(Entity);
+				continue;
+			}
+
+			const float Distance = DeadReckoningFragment.GetDistance(SimulationTime);
+			const FVector Location = PathLUT->GetPositionAtDistance(Distance);
+
+			TransformView[Index].GetMutableTransform().SetLocation(Location);
+			DirectionFragView[Index].Direction = PathLUT->GetTangentAtDistance(Distance);
+
+			// The move processor handles the end of the path
+			bool bWake = !bUseDeadReckoning || Distance >= PathLUT->Length;
+
+			if (!bWake && Clock.IsDueThisFrame(Entity.Index, CheckInterval))
+			{
+				// Flux was rebaked, let the move processor pick the new path or make this one final
+				const TSharedPtr<const FAmalgamFluxPathLUT>* FluxPath = FluxPathCache.Find(FluxFragView[Index].GetFluxKey());
+				bWake = !PathFragment.IsPathFinal() && (!FluxPath || *FluxPath != PathLUT);
+
+				const float WakeRange = AggroFragView[Index].GetAggroRange() + WakeMargin;
+				bWake = bWake || ASpatialHashGrid::HasPotentialTargetsAround(Location, WakeRange, OwnerFragView[Index].GetOwner().Team);
+
+				// Transmutation or flux speed changed, restart from here with the new speed
+				const float Speed = Transmutation.GetMultipliers(OwnerFragView[Index].GetOwner()).GetSpeedModifier(MovementFragView[Index].GetSpeed());
+				if (!bWake && Speed != DeadReckoningFragment.GetSpeed())
+					DeadReckoningFragment.Start(Distance, SimulationTime, Speed);
+			}
+
+			if (bWake)
+			{
+				PathFragment.SetPathIndex(PathLUT->GetIndexAfterDistance(Distance));
+				Context.Defer().RemoveTag<FAmalgamDeadReckoningTag>(Entity);
+			}
+		}
+	}));
+}
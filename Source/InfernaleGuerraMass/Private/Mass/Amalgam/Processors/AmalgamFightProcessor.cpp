@@ -13,13 +13,18 @@
 
 //Processor
 #include "MassExecutionContext.h"
+#include "MassEntityView.h"
+#include "MassEntityUtils.h"
 #include <MassEntityTemplateRegistry.h>
 #include <Mass/Collision/SpatialHashGrid.h>
 
+//Subsystem
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Amalgam/Processors/AmalgamAggroProcessor.h"
+#include "Mass/Collision/SpatialHashGridProcessor.h"
+
 //Damageable Component
-#include "Component/ActorComponents/BattleManagerComponent.h"
 #include "Component/ActorComponents/DamageableComponent.h"
-#include "Manager/UnitActorManager.h"
 #include "UnitAsActor/UnitActor.h"
 
 UAmalgamFightProcessor::UAmalgamFightProcessor() : EntityQuery(*this)
@@ -28,21 +33,26 @@ UAmalgamFightProcessor::UAmalgamFightProcessor() : EntityQuery(*this)
 	bAutoRegisterWithProcessingPhases = true;
 	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
 	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
-	bRequiresGameThreadExecution = true;
+	// Grid entity data is written without locks, after the processors that move it and refresh the target snapshots
+	ExecutionOrder.ExecuteAfter.Add(UAmalgamAggroProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteAfter.Add(USpatialHashGridProcessor::StaticClass()->GetFName());
+	// Actors are damaged by the battle event buffer on the game thread, see FAmalgamBattleEventBuffer::Flush
+	bRequiresGameThreadExecution = false;
 }
 
 void UAmalgamFightProcessor::ConfigureQueries()
 {
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamAggroFragment>(EMassFragmentAccess::ReadOnly);
-	EntityQuery.AddRequirement<FAmalgamFightFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamFightFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamTargetFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadOnly);
-	EntityQuery.AddRequirement<FAmalgamTransmutationFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddSharedRequirement<FAmalgamTransmutationSharedFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamPathfindingFragment>(EMassFragmentAccess::ReadOnly);
 	
-	EntityQuery.AddTagRequirement<FAmalgamFightTag>(EMassFragmentPresence::All);
+	if (GetDefault<UAmalgamSimulationSubsystem>()->UsesStateTags())
+		EntityQuery.AddTagRequirement<FAmalgamFightTag>(EMassFragmentPresence::All);
 	EntityQuery.AddTagRequirement<FAmalgamClientExecuteTag>(EMassFragmentPresence::None);
 
 	EntityQuery.RegisterWithProcessor(*this);
@@ -50,194 +60,187 @@ void UAmalgamFightProcessor::ConfigureQueries()
 
 void UAmalgamFightProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
-	EntityQuery.ForEachEntityChunk(EntityManager, Context, ([this](FMassExecutionContext& Context)
-		{
-			TArrayView<FTransformFragment> TransformFragView = Context.GetMutableFragmentView<FTransformFragment>();
-			TArrayView<FAmalgamFightFragment> FightFragView = Context.GetMutableFragmentView<FAmalgamFightFragment>();
-			TArrayView<FAmalgamTargetFragment> TargetFragView = Context.GetMutableFragmentView<FAmalgamTargetFragment>();
-			TArrayView<FAmalgamAggroFragment> AggroFragView = Context.GetMutableFragmentView<FAmalgamAggroFragment>();
-			TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
-			TArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetMutableFragmentView<FAmalgamOwnerFragment>();
-			TArrayView<FAmalgamTransmutationFragment> TransFragView = Context.GetMutableFragmentView<FAmalgamTransmutationFragment>();
-			TArrayView<FAmalgamPathfindingFragment> PathFragView = Context.GetMutableFragmentView<FAmalgamPathfindingFragment>();
-
-			float WorldDeltaTime = Context.GetDeltaTimeSeconds();
-
-			for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index)
-			{
-				FAmalgamFightFragment& FightFragment = FightFragView[Index];
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	const FAmalgamSimulationClock& Clock = SimulationSubsystem->GetSimulationClock();
+	if (!Clock.ShouldStep()) return;
 
-				if (!FightFragment.TickAttackTimer(WorldDeltaTime)) continue;
+	const double SimulationTime = Clock.GetSimulationTime();
+	FAmalgamBattleEventBuffer& BattleEventBuffer = SimulationSubsystem->GetBattleEventBuffer();
+	FAmalgamAttackScheduler& AttackScheduler = SimulationSubsystem->GetAttackScheduler();
 
-				FVector Location = TransformFragView[Index].GetTransform().GetLocation();
-				FAmalgamAggroFragment& AggroFragment = AggroFragView[Index];
-				FAmalgamTargetFragment& TargetFragment = TargetFragView[Index];
-				FAmalgamStateFragment& StateFragment = StateFragView[Index];
-				FAmalgamOwnerFragment& OwnerFragment = OwnerFragView[Index];
-				FAmalgamTransmutationFragment& TransFragment = TransFragView[Index];
-				FAmalgamPathfindingFragment& PathfindingFragment = PathFragView[Index];
+	AttackScheduler.Advance(SimulationTime, DueAttacks);
+	if (DueAttacks.IsEmpty()) return;
 
-				const auto OwnerInfo = OwnerFragment.GetOwner();
-				
-				if(!CheckTargetValidity(TargetFragment, StateFragment, OwnerInfo))
-				{
-					StateFragment.SetAggro(EAmalgamAggro::NoAggro);
-					StateFragment.SetStateAndNotify(EAmalgamState::FollowPath, Context, Index);
-					continue;
-				}
+	const bool bUseStateTags = SimulationSubsystem->UsesStateTags();
+
+	// Drop the attacks of entities that died, left the fight or were rescheduled since
+	ReadyEntities.Reset();
+	for (const FAmalgamScheduledAttack& Attack : DueAttacks)
+	{
+		if (!EntityManager.IsEntityValid(Attack.Entity)) continue;
 
-				bool bShouldStillAggro = true;
+		const FMassEntityView EntityView(EntityManager, Attack.Entity);
+		if (EntityView.HasTag<FAmalgamClientExecuteTag>()) continue;
+
+		if (bUseStateTags)
+		{
+			if (!EntityView.HasTag<FAmalgamFightTag>()) continue;
+		}
+		else
+		{
+			const FAmalgamStateFragment* StateFragment = EntityView.GetFragmentDataPtr<FAmalgamStateFragment>();
+			if (!StateFragment || StateFragment->GetState() != EAmalgamState::Fighting) continue;
+		}
 
-				switch (StateFragment.GetAggro())
+		const FAmalgamFightFragment* FightFragment = EntityView.GetFragmentDataPtr<FAmalgamFightFragment>();
+		if (!FightFragment || FightFragment->GetNextAttackTick() != Attack.Tick) continue;
+
+		ReadyEntities.Add(Attack.Entity);
+	}
+	if (ReadyEntities.IsEmpty()) return;
+
+	TArray<FMassArchetypeEntityCollection> EntityCollections;
+	UE::Mass::Utils::CreateEntityCollections(EntityManager, ReadyEntities, FMassArchetypeEntityCollection::FoldDuplicates, EntityCollections);
+
+	for (const FMassArchetypeEntityCollection& EntityCollection : EntityCollections)
+	{
+		EntityQuery.ForEachEntityChunk(EntityCollection, EntityManager, Context, ([this, SimulationTime, &BattleEventBuffer, &AttackScheduler](FMassExecutionContext& Context)
+			{
+				TArray<FAmalgamBattleEvent> BattleEvents;
+				TArray<FAmalgamStructureHit> StructureHits;
+
+				TArrayView<FTransformFragment> TransformFragView = Context.GetMutableFragmentView<FTransformFragment>();
+				TArrayView<FAmalgamFightFragment> FightFragView = Context.GetMutableFragmentView<FAmalgamFightFragment>();
+				TArrayView<FAmalgamTargetFragment> TargetFragView = Context.GetMutableFragmentView<FAmalgamTargetFragment>();
+				TArrayView<FAmalgamAggroFragment> AggroFragView = Context.GetMutableFragmentView<FAmalgamAggroFragment>();
+				TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
+				TArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetMutableFragmentView<FAmalgamOwnerFragment>();
+				const FAmalgamTransmutationSharedFragment& Transmutation = Context.GetSharedFragment<FAmalgamTransmutationSharedFragment>();
+				TArrayView<FAmalgamPathfindingFragment> PathFragView = Context.GetMutableFragmentView<FAmalgamPathfindingFragment>();
+
+				for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index)
 				{
-				case EAmalgamAggro::Amalgam:
+					FAmalgamFightFragment& FightFragment = FightFragView[Index];
+
+					FVector Location = TransformFragView[Index].GetTransform().GetLocation();
+					FAmalgamAggroFragment& AggroFragment = AggroFragView[Index];
+					FAmalgamTargetFragment& TargetFragment = TargetFragView[Index];
+					FAmalgamStateFragment& StateFragment = StateFragView[Index];
+					FAmalgamOwnerFragment& OwnerFragment = OwnerFragView[Index];
+					FAmalgamPathfindingFragment& PathfindingFragment = PathFragView[Index];
+
+					const auto OwnerInfo = OwnerFragment.GetOwner();
+					
+					if(!CheckTargetValidity(TargetFragment, StateFragment, OwnerInfo))
 					{
-					FMassEntityHandle TargetHandle = TargetFragment.GetTargetEntityHandle();
-					EEntityType Type = ASpatialHashGrid::GetEntityData(TargetHandle).EntityType;
-					bShouldStillAggro = ExecuteAmalgamFight(TargetHandle, TransFragment.GetUnitDamageModifier(FightFragment.GetDamage() * FightFragment.GetAmalgamMult()), Location, AggroFragment.GetFightRange(), TargetFragment.GetTotalRangeOffset(), OwnerInfo, AggroFragment.GetEntityType(), Type);
-					break;
+						StateFragment.SetAggro(EAmalgamAggro::NoAggro);
+						StateFragment.SetStateAndNotify(EAmalgamState::FollowPath, Context, Index);
+						continue;
 					}
-				
-				case EAmalgamAggro::Building:
-					bShouldStillAggro = ExecuteBuildingFight(TargetFragment.GetTargetBuilding(), TransFragment.GetBuildingDamageModifier(FightFragment.GetBuildingDamage() * FightFragment.GetBuildingMult()), OwnerFragment.GetOwner(), AggroFragment.GetEntityType(), Location, AggroFragment.GetFightRange(), TargetFragment.GetTotalRangeOffset());
-					break;
 
-				case EAmalgamAggro::LDElement:
-					bShouldStillAggro = ExecuteLDFight(TargetFragment.GetTargetLDElem(), TransFragment.GetBuildingDamageModifier(FightFragment.GetDamage() * FightFragment.GetLDMult()), OwnerFragment.GetOwner(), AggroFragment.GetEntityType(), Location, AggroFragment.GetFightRange(), TargetFragment.GetTotalRangeOffset());
-					break;
+					// Keeps the cadence of the old attack timer. In tag mode the entity stays tagged for fight until the state change goes through
+					FightFragment.SetNextAttackTick(AttackScheduler.Schedule(Context.GetEntity(Index), SimulationTime + FightFragment.GetAttackDelay()));
 
-				default:
-					continue;
-				}
+					bool bShouldStillAggro = true;
+					const FGridTargetSnapshot* Snapshot = ASpatialHashGrid::GetStaticTargetSnapshot(TargetFragment.GetTargetRef());
 
-				if (bShouldStillAggro) continue;
+					switch (StateFragment.GetAggro())
+					{
+					case EAmalgamAggro::Amalgam:
+						{
+						const FGridTargetRef& TargetRef = TargetFragment.GetTargetRef();
+						bShouldStillAggro = ExecuteAmalgamFight(TargetRef, Transmutation.GetMultipliers(OwnerInfo).GetUnitDamageModifier(FightFragment.GetDamage() * FightFragment.GetAmalgamMult()), Location, AggroFragment.GetFightRange(), TargetFragment.GetTotalRangeOffset(), OwnerInfo, AggroFragment.GetEntityType(), BattleEvents);
+						break;
+						}
+					
+					case EAmalgamAggro::Building:
+						bShouldStillAggro = Snapshot && ExecuteBuildingFight(TargetFragment.GetTargetBuilding(), *Snapshot, Transmutation.GetMultipliers(OwnerInfo).GetBuildingDamageModifier(FightFragment.GetBuildingDamage() * FightFragment.GetBuildingMult()), OwnerFragment.GetOwner(), AggroFragment.GetEntityType(), Location, AggroFragment.GetFightRange(), TargetFragment.GetTotalRangeOffset(), StructureHits);
+						break;
+
+					case EAmalgamAggro::LDElement:
+						bShouldStillAggro = Snapshot && ExecuteLDFight(TargetFragment.GetTargetLDElem(), *Snapshot, Transmutation.GetMultipliers(OwnerInfo).GetBuildingDamageModifier(FightFragment.GetDamage() * FightFragment.GetLDMult()), OwnerFragment.GetOwner(), AggroFragment.GetEntityType(), Location, AggroFragment.GetFightRange(), TargetFragment.GetTotalRangeOffset(), StructureHits);
+						break;
+
+					default:
+						continue;
+					}
 
-				if (StateFragment.GetAggro() == EAmalgamAggro::Amalgam)
-					ASpatialHashGrid::GetMutableEntityData(TargetFragment.GetTargetEntityHandle())->AggroCount--;
+					if (bShouldStillAggro) continue;
 
-				StateFragment.SetAggro(EAmalgamAggro::NoAggro);
-				StateFragment.SetState(EAmalgamState::FollowPath);
-				FightFragment.ResetTimer();
-				TargetFragment.ResetTargets();
-				PathfindingFragment.SetShouldRecover(true);
-			}
-		}));
-}
+					if (StateFragment.GetAggro() == EAmalgamAggro::Amalgam)
+						if (GridCellEntityData* TargetData = ASpatialHashGrid::GetMutableEntityData(TargetFragment.GetTargetRef()))
+							TargetData->AggroCount--;
 
-void UAmalgamFightProcessor::GetBattleManager()
-{
-	TArray<AActor*> OutActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), AUnitActorManager::StaticClass(), OutActors);
+					StateFragment.SetAggro(EAmalgamAggro::NoAggro);
+					StateFragment.SetState(EAmalgamState::FollowPath);
+					TargetFragment.ResetTargets();
+					PathfindingFragment.SetShouldRecover(true);
+				}
 
-	if (OutActors.Num() == 0)
-	{
-		GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, TEXT("AmalgamFightProcessor : Unable to find UnitActorManager, skipping execution."));
-		return;
+				BattleEventBuffer.Append(BattleEvents, StructureHits);
+			}));
 	}
-
-	auto UnitActorManager = static_cast<AUnitActorManager*>(OutActors[0]);
-	if (!UnitActorManager) return;
-	
-	BattleManager = UnitActorManager->GetBattleManagerComponent().Get();
 }
 
-bool UAmalgamFightProcessor::ExecuteAmalgamFight(FMassEntityHandle TargetHandle, float Damage, FVector AttackerLocation, float AttackerRange, float DistanceOffset, FOwner AttackerOwner, EEntityType AttackerType, EEntityType TargetType)
+bool UAmalgamFightProcessor::ExecuteAmalgamFight(const FGridTargetRef& TargetRef, float Damage, FVector AttackerLocation, float AttackerRange, float DistanceOffset, FOwner AttackerOwner, EEntityType AttackerType, TArray<FAmalgamBattleEvent>& OutBattleEvents)
 {
-	GridCellEntityData* Data = ASpatialHashGrid::GetMutableEntityData(TargetHandle);
+	GridCellEntityData* Data = ASpatialHashGrid::GetMutableEntityData(TargetRef);
 	if (!Data) return false;
 
 	if ((AttackerLocation - Data->Location).Length() - DistanceOffset >= AttackerRange) return false;
 
 	Data->DamageEntity(Damage);
 
-	if (!BattleManager) GetBattleManager();
-
-	if (BattleManager)
-	{
-		FBattleInfo BattleInfo;
-		BattleInfo.AttackerUnitType = AttackerType;
-		BattleInfo.TargetUnitType = TargetType;
-		const auto UnitLoc = AttackerLocation;
-		const auto TargetLoc = Data->Location;
-		BattleInfo.BattlePositionAttackerWorld = FVector2D(UnitLoc.X, UnitLoc.Y);
-		BattleInfo.BattlePositionTargetWorld = FVector2D(TargetLoc.X, TargetLoc.Y);
-		BattleInfo.UnitTargetTypeTarget = EUnitTargetType::UTargetUnit;
-		BattleInfo.AttackerOwner = AttackerOwner;
-		BattleInfo.TargetOwner = Data->Owner;
-		BattleManager->AtPosBattleInfo(BattleInfo);
-	}
+	FAmalgamBattleEvent& BattleEvent = OutBattleEvents.AddDefaulted_GetRef();
+	BattleEvent.AttackerLocation = FVector2D(AttackerLocation);
+	BattleEvent.TargetLocation = FVector2D(Data->Location);
+	BattleEvent.AttackerOwner = AttackerOwner;
+	BattleEvent.TargetOwner = Data->Owner;
+	BattleEvent.AttackerType = AttackerType;
+	BattleEvent.TargetType = Data->EntityType;
+	BattleEvent.TargetKind = EUnitTargetType::UTargetUnit;
 
-	if(bDebug) GEngine->AddOnScreenDebugMessage(-1, 2.5, FColor::Orange, FString::Printf(TEXT("Amalgam attacked")));
-	if (ASpatialHashGrid::GetEntityData(TargetHandle).EntityHealth <= 0.f) return false;
+	if (bDebug) UE_LOG(LogTemp, Log, TEXT("Amalgam attacked"));
+	if (Data->EntityHealth <= 0.f) return false;
 
 	return true;
 }
 
-bool UAmalgamFightProcessor::ExecuteBuildingFight(TWeakObjectPtr<ABuildingParent> TargetBuilding, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset)
+bool UAmalgamFightProcessor::ExecuteBuildingFight(TWeakObjectPtr<ABuildingParent> TargetBuilding, const FGridTargetSnapshot& Snapshot, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset, TArray<FAmalgamStructureHit>& OutStructureHits)
 {
-	if ((AttackerLocation - TargetBuilding->GetActorLocation()).Length() - DistanceOffset >= AttackerRange) return false;
-	
-	TargetBuilding->GetDamageableComponent()->DamageHealthOwner(Damage, false, AttackOwner);
-
-	if (bDebug) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Orange, TEXT("Amalgam attacked building"));
-
-	if (!TargetBuilding.IsValid())
-		return false;
-	const auto TargetOwner = TargetBuilding->GetOwner();
-	if (TargetOwner.Team == AttackOwner.Team)
-		return false;
-
-	if (!BattleManager) GetBattleManager();
-
-	if (BattleManager)
-	{
-		FBattleInfo BattleInfo;
-		BattleInfo.AttackerUnitType = AttackerType;
-		BattleInfo.TargetUnitType = EEntityType::EntityTypeCity;
-		const auto UnitLoc = AttackerLocation;
-		const auto TargetLoc = TargetBuilding.Get()->GetActorLocation();
-		BattleInfo.BattlePositionAttackerWorld = FVector2D(UnitLoc.X, UnitLoc.Y);
-		BattleInfo.BattlePositionTargetWorld = FVector2D(TargetLoc.X, TargetLoc.Y);
-		BattleInfo.UnitTargetTypeTarget = EUnitTargetType::UTargetBuilding;
-		BattleInfo.AttackerOwner = AttackOwner;
-		BattleInfo.TargetOwner = TargetOwner;
-		BattleManager->AtPosBattleInfo(BattleInfo);
-	}
-
+	// The grid reference outlives the actor until the next snapshot refresh
+	if (!TargetBuilding.IsValid()) return false;
+	if ((AttackerLocation - Snapshot.Location).Length() - DistanceOffset >= AttackerRange) return false;
+
+	FAmalgamStructureHit& Hit = OutStructureHits.AddDefaulted_GetRef();
+	Hit.Building = TargetBuilding;
+	Hit.Damage = Damage;
+	Hit.AttackerLocation = FVector2D(AttackerLocation);
+	Hit.AttackerOwner = AttackOwner;
+	Hit.AttackerType = AttackerType;
+
+	if (bDebug) UE_LOG(LogTemp, Log, TEXT("Amalgam attacked building"));
 	return true;
 }
 
 //Distance offset is used to not just compare center locations, but also take radius into account
-bool UAmalgamFightProcessor::ExecuteLDFight(TWeakObjectPtr<ALDElement> Element, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset)
+bool UAmalgamFightProcessor::ExecuteLDFight(TWeakObjectPtr<ALDElement> Element, const FGridTargetSnapshot& Snapshot, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset, TArray<FAmalgamStructureHit>& OutStructureHits)
 {
-	if ((AttackerLocation - Element->GetActorLocation()).Length() - DistanceOffset >= AttackerRange) return false;
-
-	auto TargetDamageable = Cast<IDamageable>(Element);
-	TargetDamageable->DamageHealthOwner(Damage, false, AttackOwner);
-	
-	if (bDebug) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Orange, TEXT("Amalgam attacked LD"));
-
-	if (!BattleManager) GetBattleManager();
+	if (!Element.IsValid()) return false;
+	if ((AttackerLocation - Snapshot.Location).Length() - DistanceOffset >= AttackerRange) return false;
 
-	if (BattleManager)
-	{
-		FOwner NatureOwner = FOwner();
-		NatureOwner.Team = ETeam::NatureTeam;
-		NatureOwner.Player = EPlayerOwning::Nature;
-		
-		FBattleInfo BattleInfo;
-		BattleInfo.AttackerUnitType = AttackerType;
-		BattleInfo.TargetUnitType = Element->GetEntityType();
-		const auto UnitLoc = AttackerLocation;
-		const auto TargetLoc = Element.Get()->GetActorLocation();
-		BattleInfo.BattlePositionAttackerWorld = FVector2D(UnitLoc.X, UnitLoc.Y);
-		BattleInfo.BattlePositionTargetWorld = FVector2D(TargetLoc.X, TargetLoc.Y);
-		BattleInfo.UnitTargetTypeTarget = EUnitTargetType::UTargetNeutralCamp;
-		BattleInfo.AttackerOwner = AttackOwner;
-		BattleInfo.TargetOwner = NatureOwner;
-		BattleManager->AtPosBattleInfo(BattleInfo);
-	}
+	FAmalgamStructureHit& Hit = OutStructureHits.AddDefaulted_GetRef();
+	Hit.LDElement = Element;
+	Hit.Damage = Damage;
+	Hit.AttackerLocation = FVector2D(AttackerLocation);
+	Hit.AttackerOwner = AttackOwner;
+	Hit.AttackerType = AttackerType;
 
+	if (bDebug) UE_LOG(LogTemp, Log, TEXT("Amalgam attacked LD"));
 	return true;
 }
 
@@ -246,17 +249,14 @@ bool UAmalgamFightProcessor::CheckTargetValidity(FAmalgamTargetFragment& TgtFrag
 	switch (StateFrag.GetAggro())
 	{
 	case EAmalgamAggro::Amalgam:
-		return ASpatialHashGrid::Contains(TgtFrag.GetTargetEntityHandle());
+		return ASpatialHashGrid::IsTargetValid(TgtFrag.GetTargetRef());
 
 	case EAmalgamAggro::Building:
-	{
-		TWeakObjectPtr<ABuildingParent> Tgt = TgtFrag.GetMutableTargetBuilding();
-		return Tgt != nullptr && Tgt->GetOwner().Team != Owner.Team;
-	}
 	case EAmalgamAggro::LDElement:
 	{
-		TWeakObjectPtr<ALDElement> Tgt = TgtFrag.GetMutableTargetLDElem();
-		return Tgt.IsValid() && ASpatialHashGrid::Contains(Tgt->GetActorLocation(), Tgt);
+		// Captured buildings and beacons stop being targets, the snapshot team is refreshed every aggro pass
+		const FGridTargetSnapshot* Snapshot = ASpatialHashGrid::GetStaticTargetSnapshot(TgtFrag.GetTargetRef());
+		return Snapshot && Snapshot->IsHostileTo(Owner.Team);
 	}
 	default:
 		return false;
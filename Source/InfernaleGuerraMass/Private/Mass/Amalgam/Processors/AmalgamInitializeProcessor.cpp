@@ -19,6 +19,10 @@
 //Spatial hash grid
 #include <Mass/Collision/SpatialHashGrid.h>
 
+//Subsystem
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Amalgam/Processors/AmalgamMoveProcessor.h"
+
 // Visual Manager
 #include "Manager/AmalgamVisualisationManager.h"
 
@@ -27,11 +31,34 @@
 
 //Misc
 #include "Kismet/GameplayStatics.h"
+#include "GameMode/Infernale/GameModeInfernale.h"
+#include "GameMode/Infernale/PlayerStateInfernale.h"
+
+namespace
+{
+	// Transmutations are bought per player, the component lives on the owner's player state
+	UTransmutationComponent* FindTransmutationComponent(const UWorld* World, const FOwner& Owner)
+	{
+		const auto GameModeInfernale = Cast<AGameModeInfernale>(UGameplayStatics::GetGameMode(World));
+		if (!GameModeInfernale) return nullptr;
+
+		const auto PlayerStateInfernale = GameModeInfernale->GetPlayerState(Owner.Player);
+		if (!PlayerStateInfernale.IsValid()) return nullptr;
+
+		if (auto Component = PlayerStateInfernale->GetComponentByClass<UTransmutationComponent>())
+			return Component;
+
+		const AActor* PlayerController = PlayerStateInfernale->GetOwner();
+		return PlayerController ? PlayerController->GetComponentByClass<UTransmutationComponent>() : nullptr;
+	}
+}
 
 UAmalgamInitializeProcessor::UAmalgamInitializeProcessor() : EntityQuery(*this)
 {
 	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
 	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
+	// Registers fluxes in the path cache, which the move processor reads from worker threads
+	ExecutionOrder.ExecuteBefore.Add(UAmalgamMoveProcessor::StaticClass()->GetFName());
 
 	// Shouldn't run if the visualisation manager wasn't found
 	bAutoRegisterWithProcessingPhases = true;
@@ -55,7 +82,9 @@ void UAmalgamInitializeProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FAmalgamNiagaraFragment>(EMassFragmentAccess::ReadWrite);
 
 	EntityQuery.AddRequirement<FAmalgamTransmutationFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddSharedRequirement<FAmalgamTransmutationSharedFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamSightFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamSquadFragment>(EMassFragmentAccess::ReadWrite);
 	
 	EntityQuery.AddTagRequirement<FAmalgamInitializeTag>(EMassFragmentPresence::All);
 
@@ -76,6 +105,11 @@ void UAmalgamInitializeProcessor::Execute(FMassEntityManager& EntityManager, FMa
 
 		check(VisualisationManager);
 	}
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
 	if (!FogManager)
 	{
 		TArray<AActor*> OutActors;
@@ -94,7 +128,11 @@ void UAmalgamInitializeProcessor::Execute(FMassEntityManager& EntityManager, FMa
 		}
 	}
 
-	EntityQuery.ForEachEntityChunk(EntityManager, Context, ([this](FMassExecutionContext& Context)
+	// Amalgams leaving the same spawner on the same flux together start in the same squad, as long as it isn't full
+	TMap<TPair<AAmalgamSpawnerParent*, AFlux*>, TPair<int32, int32>> SpawnWaveSquads;
+	const bool bUseSquads = SimulationSubsystem->UsesSquads();
+
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, ([this, &SpawnWaveSquads, bUseSquads](FMassExecutionContext& Context)
 		{
 
 			TArray<AAmalgamSpawnerParent*> Spawners = AAmalgamSpawnerParent::Spawners;
@@ -109,7 +147,9 @@ void UAmalgamInitializeProcessor::Execute(FMassEntityManager& EntityManager, FMa
 			TArrayView<FAmalgamNiagaraFragment> NiagaraFragView = Context.GetMutableFragmentView<FAmalgamNiagaraFragment>();
 			TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
 			TArrayView<FAmalgamTransmutationFragment> TransmFragView = Context.GetMutableFragmentView<FAmalgamTransmutationFragment>();
+			FAmalgamTransmutationSharedFragment& Transmutation = Context.GetMutableSharedFragment<FAmalgamTransmutationSharedFragment>();
 			TArrayView<FAmalgamSightFragment> SightFragView = Context.GetMutableFragmentView<FAmalgamSightFragment>();
+			TArrayView<FAmalgamSquadFragment> SquadFragView = Context.GetMutableFragmentView<FAmalgamSquadFragment>();
 			
 			for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index)
 			{
@@ -145,7 +185,7 @@ void UAmalgamInitializeProcessor::Execute(FMassEntityManager& EntityManager, FMa
 				}
 				
 				FluxFragment.SetFlux(Flux);
-				FluxFragment.SetSplinePointIndex(0);
+				SimulationSubsystem->GetFluxPathCache().Register(Flux.Get());
 				
 				// Initialize data fragments
 				FAmalgamFightFragment& FightFragment = FightFragView[Index];
@@ -164,6 +204,21 @@ void UAmalgamInitializeProcessor::Execute(FMassEntityManager& EntityManager, FMa
 
 				OwnerFragment.SetOwner(CurrentSpawner->GetOwner());
 
+				if (!Transmutation.IsOwnerRegistered(OwnerFragment.GetOwner()))
+					Transmutation.RegisterOwner(OwnerFragment.GetOwner(), FindTransmutationComponent(Context.GetWorld(), OwnerFragment.GetOwner()));
+				const FAmalgamTransmutationMultipliers& Multipliers = Transmutation.GetMultipliers(OwnerFragment.GetOwner());
+
+				if (bUseSquads)
+				{
+					FAmalgamSquadRegistry& SquadRegistry = SimulationSubsystem->GetSquadRegistry();
+					TPair<int32, int32>* Wave = SpawnWaveSquads.Find({ CurrentSpawner, Flux.Get() });
+					if (!Wave || Wave->Value >= SquadRegistry.GetMaxSquadSize())
+						Wave = &SpawnWaveSquads.Add({ CurrentSpawner, Flux.Get() }, { SquadRegistry.CreateSquad(OwnerFragment.GetOwner().Team), 0 });
+
+					SquadFragView[Index].SetSquadId(Wave->Key);
+					++Wave->Value;
+				}
+
 				if(bDebug) GEngine->AddOnScreenDebugMessage(-1, .5f, FColor::Orange, FString::Printf(TEXT("AmalgamInitializeProcessor : Spawner team is %d"), CurrentSpawner->GetOwner().Team));
 
 
@@ -176,11 +231,14 @@ void UAmalgamInitializeProcessor::Execute(FMassEntityManager& EntityManager, FMa
 
 				GridFragment.SetGridCoordinates(GridCoord);
 
-				if(!ASpatialHashGrid::AddEntityToGrid(Location, Context.GetEntity(Index), OwnerFragment.GetOwner(), TransformFragment, TransmutationFragment.GetHealthModifier(FightFragment.GetHealth()), AggroFragView[Index].GetTargetableRange(), FightFragment.GetEntityType()))
+				if(!ASpatialHashGrid::AddEntityToGrid(Location, Context.GetEntity(Index), OwnerFragment.GetOwner(), TransformFragment, Multipliers.GetHealthModifier(FightFragment.GetHealth()), AggroFragView[Index].GetTargetableRange(), FightFragment.GetEntityType()))
 				{
 					if (bDebug) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, TEXT("AmalgamInitializeProcessor : Failed to add entity to cell"));
 					Context.Defer().AddTag<FAmalgamKillTag>(Context.GetEntity(Index));
 				}
+				// Health already includes the current multiplier, don't let the grid processor apply it a second time
+				TransmutationFragment.Update(Multipliers);
+
 				const auto SpeedMult = Flux->GetAmalgamsSpeedMult();
 				const auto Handle = Context.GetEntity(Index);
 				
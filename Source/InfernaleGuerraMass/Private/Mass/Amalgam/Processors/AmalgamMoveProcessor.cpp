@@ -17,12 +17,12 @@
 
 //Subsystem
 #include <Mass/Collision/SpatialHashGrid.h>
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Amalgam/Data/AmalgamStateDispatch.h"
 
-#include "Components/SplineComponent.h"
 #include "LD/Buildings/BuildingParent.h"
 
 // Misc
-#include "Kismet/GameplayStatics.h"
 #include "Structs/ReplicationStructs.h"
 
 UAmalgamMoveProcessor::UAmalgamMoveProcessor() : EntityQuery(*this)
@@ -31,10 +31,10 @@ UAmalgamMoveProcessor::UAmalgamMoveProcessor() : EntityQuery(*this)
 	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
 	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Movement);
 
-	// Shouldn't run if the visualisation manager wasn't found
 	bAutoRegisterWithProcessingPhases = true;
 
-	bRequiresGameThreadExecution = true;
+	// Only touches fragments, the game thread part lives in UAmalgamPresentationProcessor
+	bRequiresGameThreadExecution = false;
 }
 
 void UAmalgamMoveProcessor::ConfigureQueries()
@@ -43,69 +43,76 @@ void UAmalgamMoveProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FAmalgamMovementFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamPathfindingFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamAggroFragment>(EMassFragmentAccess::ReadWrite);
-	EntityQuery.AddRequirement<FAmalgamFluxFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamFluxFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamTargetFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadWrite);
-	EntityQuery.AddRequirement<FAmalgamNiagaraFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadWrite);
-	EntityQuery.AddRequirement<FAmalgamTransmutationFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamDeadReckoningFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamFightFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddSharedRequirement<FAmalgamTransmutationSharedFragment>(EMassFragmentAccess::ReadOnly);
 	
-	EntityQuery.AddTagRequirement<FAmalgamMoveTag>(EMassFragmentPresence::All);
+	// Without state tags marching and aggroed amalgams share archetypes with the others, they are picked from the state fragment
+	if (GetDefault<UAmalgamSimulationSubsystem>()->UsesStateTags())
+		EntityQuery.AddTagRequirement<FAmalgamMoveTag>(EMassFragmentPresence::All);
+	EntityQuery.AddTagRequirement<FAmalgamDeadReckoningTag>(EMassFragmentPresence::None);
 	
 	EntityQuery.RegisterWithProcessor(*this);
 }
 
 void UAmalgamMoveProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
-	if (!VisualisationManager)
+	if (!SimulationSubsystem)
 	{
-		TArray<AActor*> OutActors;
-		UGameplayStatics::GetAllActorsOfClass(GetWorld(), AAmalgamVisualisationManager::StaticClass(), OutActors);
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	const FAmalgamSimulationClock& Clock = SimulationSubsystem->GetSimulationClock();
+	if (!Clock.ShouldStep()) return;
 
-		if (OutActors.Num() > 0)
-			VisualisationManager = static_cast<AAmalgamVisualisationManager*>(OutActors[0]);
-		else
-			VisualisationManager = nullptr;
+	const float WorldDeltaTime = Clock.GetStepDeltaTime();
 
-		check(VisualisationManager);
-	}
-	if (!GameModeInfernale)
-	{
-		const auto GameMode = Cast<AGameModeInfernale>(UGameplayStatics::GetGameMode(GetWorld()));
-		if (GameMode)
-			GameModeInfernale = GameMode;
-		else
-			GameModeInfernale = nullptr;
+	// Only rebuilt between frames, safe to read from every chunk
+	const FAmalgamFluxPathCache& FluxPathCache = SimulationSubsystem->GetFluxPathCache();
 
-		check(GameModeInfernale);
-	}
-	EntityQuery.ForEachEntityChunk(EntityManager, Context, ([this](FMassExecutionContext& Context)
+	const bool bUseDeadReckoning = SimulationSubsystem->UsesDeadReckoning();
+	const int32 CheckInterval = SimulationSubsystem->GetDeadReckoningCheckInterval();
+	const float WakeMargin = SimulationSubsystem->GetDeadReckoningWakeMargin();
+	const double SimulationTime = Clock.GetSimulationTime();
+
+	FAmalgamAttackScheduler& AttackScheduler = SimulationSubsystem->GetAttackScheduler();
+	const uint32 StateMask = SimulationSubsystem->UsesStateTags() ? FAmalgamStateDispatch::AllStates
+		: FAmalgamStateDispatch::StateBit(EAmalgamState::FollowPath) | FAmalgamStateDispatch::StateBit(EAmalgamState::Aggroed);
+
+	EntityQuery.ParallelForEachEntityChunk(EntityManager, Context, ([&](FMassExecutionContext& Context)
 	{
 		TArrayView<FTransformFragment> TransformView = Context.GetMutableFragmentView<FTransformFragment>();
-		TArrayView<FAmalgamFluxFragment> FluxFragView = Context.GetMutableFragmentView<FAmalgamFluxFragment>();
+		const TConstArrayView<FAmalgamFluxFragment> FluxFragView = Context.GetFragmentView<FAmalgamFluxFragment>();
 		TArrayView<FAmalgamMovementFragment> MovementFragView = Context.GetMutableFragmentView<FAmalgamMovementFragment>();
 		TArrayView<FAmalgamPathfindingFragment> PathFragView = Context.GetMutableFragmentView<FAmalgamPathfindingFragment>();
 		TArrayView<FAmalgamAggroFragment> AggroFragView = Context.GetMutableFragmentView<FAmalgamAggroFragment>();
 		TArrayView<FAmalgamTargetFragment> TargetFragView = Context.GetMutableFragmentView<FAmalgamTargetFragment>();
 		TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
-		TArrayView<FAmalgamNiagaraFragment> NiagaraFragView = Context.GetMutableFragmentView<FAmalgamNiagaraFragment>();
 		TArrayView<FAmalgamDirectionFragment> DirectionFragView = Context.GetMutableFragmentView<FAmalgamDirectionFragment>();
-		TArrayView<FAmalgamTransmutationFragment> TransFragView = Context.GetMutableFragmentView<FAmalgamTransmutationFragment>();
-		
-		const float WorldDeltaTime = Context.GetDeltaTimeSeconds();
+		const TConstArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetFragmentView<FAmalgamOwnerFragment>();
+		TArrayView<FAmalgamDeadReckoningFragment> DeadReckoningFragView = Context.GetMutableFragmentView<FAmalgamDeadReckoningFragment>();
+		TArrayView<FAmalgamFightFragment> FightFragView = Context.GetMutableFragmentView<FAmalgamFightFragment>();
+		const FAmalgamTransmutationSharedFragment& Transmutation = Context.GetSharedFragment<FAmalgamTransmutationSharedFragment>();
 
-		TArray<FVector> UpdatedLocations;
-		TArray<FVector> UpdatedRotations;
+		// Replicated amalgams are fought on the server
+		const bool bCanScheduleAttacks = !Context.DoesArchetypeHaveTag<FAmalgamClientExecuteTag>();
+		TArray<FAmalgamScheduledAttack> NewAttacks;
 
-		for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index)
+		FAmalgamStateDispatch::FEntityIndices EntityIndices;
+		FAmalgamStateDispatch::GatherEntities(StateFragView, StateMask, EntityIndices);
+
+		for (const int32 Index : EntityIndices)
 		{
 			FAmalgamStateFragment& StateFragment = StateFragView[Index];
-			FAmalgamNiagaraFragment& NiagaraFragment = NiagaraFragView[Index];
 			FAmalgamDirectionFragment& DirectionFragment = DirectionFragView[Index];
 			FAmalgamAggroFragment& AggroFragment = AggroFragView[Index];
-			FAmalgamTransmutationFragment& TransFrag = TransFragView[Index];
 
-			FAmalgamFluxFragment& FluxFragment = FluxFragView[Index];
+			const FAmalgamFluxFragment& FluxFragment = FluxFragView[Index];
 			FAmalgamTargetFragment& TargetFragment = TargetFragView[Index];
 			FAmalgamMovementFragment* MovementFragment = &MovementFragView[Index];
 			FAmalgamPathfindingFragment& PathFragment = PathFragView[Index];
@@ -115,28 +122,29 @@ void UAmalgamMoveProcessor::Execute(FMassEntityManager& EntityManager, FMassExec
 
 			const auto State = StateFragView[Index].GetState();
 			bool bSucceeded = true;
-			const auto Flux = FluxFragment.GetFlux();
+			const TSharedPtr<const FAmalgamFluxPathLUT>* FluxPath = FluxPathCache.Find(FluxFragment.GetFluxKey());
 
-			if (!Flux.IsValid() && !PathFragment.IsPathFinal())
+			if (!FluxPath)
 			{
-				PathFragment.MakePathFinal();
-				/*StateFragment.SetStateAndNotify(EAmalgamState::Killed, Context, Index);
-				continue;*/
+				if (!PathFragment.IsPathFinal())
+					PathFragment.MakePathFinal();
+			}
+			else
+			{
+				const auto Version = PathFragment.GetUpdateVersion();
+				const bool FluxVersionIsOk = Version == (*FluxPath)->UpdateVersion;
+				if (Version != -1 && !FluxVersionIsOk)
+				{
+					PathFragment.MakePathFinal();
+				}
 			}
-
-			const auto Version = PathFragment.GetUpdateVersion();
-			const bool FluxVersionIsOk = Version == Flux->GetUpdateVersion();
-			if (Version != -1 && !FluxVersionIsOk)
-            {
-				PathFragment.MakePathFinal();
-            }
 
 			if (!PathFragment.IsPathFinal())
 			{
-				if (PathFragment.GetUpdateID() != Flux->GetUpdateID())
+				if (PathFragment.GetUpdateID() != (*FluxPath)->UpdateID)
 				{
-					PathFragment.CopyPathFromFlux(Flux, Location, false);
-					MovementFragment->SetSpeedMult(Flux->GetAmalgamsSpeedMult());
+					PathFragment.SetPathLUT(*FluxPath, Location);
+					MovementFragment->SetSpeedMult((*FluxPath)->SpeedMult);
 				}
 
 				if (PathFragment.ShouldRecover())
@@ -148,7 +156,19 @@ void UAmalgamMoveProcessor::Execute(FMassEntityManager& EntityManager, FMassExec
 			switch (State)
 			{
 			case EAmalgamState::FollowPath:
-				bSucceeded = FollowPath(TransformFragment, FluxFragment, PathFragment, DirectionFragment, TransFrag.GetSpeedModifier(MovementFragment->GetSpeed()), WorldDeltaTime);
+			{
+				const float Speed = Transmutation.GetMultipliers(OwnerFragView[Index].GetOwner()).GetSpeedModifier(MovementFragment->GetSpeed());
+				bSucceeded = FollowPath(TransformFragment, PathFragment, DirectionFragment, Speed, WorldDeltaTime);
+
+				// Staggered so only a slice of the marching amalgams look around each step
+				const FMassEntityHandle Entity = Context.GetEntity(Index);
+				if (bSucceeded && bUseDeadReckoning && Clock.IsDueThisFrame(Entity.Index, CheckInterval))
+				{
+					const float WakeRange = AggroFragment.GetAggroRange() + WakeMargin;
+					if (TryStartDeadReckoning(Transform.GetLocation(), PathFragment, WakeRange, OwnerFragView[Index].GetOwner().Team, Speed, SimulationTime, DeadReckoningFragView[Index]))
+						Context.Defer().AddTag<FAmalgamDeadReckoningTag>(Entity);
+				}
+			}
 				break;
 
 			case EAmalgamState::Aggroed:
@@ -169,9 +189,18 @@ void UAmalgamMoveProcessor::Execute(FMassEntityManager& EntityManager, FMassExec
 				else if ((Location - TargetLocation).Length() - TotalRangeOffset < AggroFragment.GetFightRange())
 				{
 					StateFragment.SetStateAndNotify(EAmalgamState::Fighting, Context, Index);
+
+					// Same as the old attack timer, the first hit lands one delay after entering the fight
+					if (bCanScheduleAttacks)
+					{
+						FAmalgamFightFragment& FightFragment = FightFragView[Index];
+						const FAmalgamScheduledAttack Attack{ Context.GetEntity(Index), AttackScheduler.GetDueTick(SimulationTime + FightFragment.GetAttackDelay()) };
+						FightFragment.SetNextAttackTick(Attack.Tick);
+						NewAttacks.Add(Attack);
+					}
 					continue;
 				}
-				bSucceeded = FollowTarget(TransformFragment, TargetLocation, DirectionFragment, TransFrag.GetSpeedModifier(MovementFragment->GetRushSpeed()), PathFragment.GetAcceptanceAttackRadius(), WorldDeltaTime);
+				bSucceeded = FollowTarget(TransformFragment, TargetLocation, DirectionFragment, Transmutation.GetMultipliers(OwnerFragView[Index].GetOwner()).GetSpeedModifier(MovementFragment->GetRushSpeed()), PathFragment.GetAcceptanceAttackRadius(), WorldDeltaTime);
 			}
 				break;
 
@@ -180,7 +209,7 @@ void UAmalgamMoveProcessor::Execute(FMassEntityManager& EntityManager, FMassExec
 
 			default:
 				bSucceeded = false;
-				if (bDebugMove) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Orange, FString::Printf(TEXT("AmalgamMoveProcessor : \n\t Amalgam @Index %d should not be handled")));
+				if (bDebugMove) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Orange, FString::Printf(TEXT("AmalgamMoveProcessor : \n\t Amalgam @Index %d should not be handled"), Index));
 				break;
 			}
 
@@ -188,192 +217,45 @@ void UAmalgamMoveProcessor::Execute(FMassEntityManager& EntityManager, FMassExec
 			{
 				StateFragment.SetDeathReason(EAmalgamDeathReason::EndOfPath);
 				StateFragment.SetStateAndNotify(EAmalgamState::Killed, Context, Index);
-				//StateFragment.Kill(EAmalgamDeathReason::EndOfPath, Context, Index);
 				continue;
 			}
-			
-			UpdatedLocations.Add(TransformFragment.GetTransform().GetLocation());
-			UpdatedRotations.Add(DirectionFragment.Direction);
-
-			//VisualisationManager->UpdatePositionP(Context.GetEntity(Index), TransformFragment.GetTransform().GetLocation(), DirectionFragment.Direction);
-		}
-		
-		TArray<FMassEntityHandle> Entities(Context.GetEntities());
-		if (Entities.Num() != UpdatedLocations.Num() || Entities.Num() != UpdatedRotations.Num())
-		{
-			if (bDebugMove) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, FString::Printf(TEXT("AmalgamMoveProcessor : \n\t Entities and UpdatedLocations size mismatch.")));
-			return;
-		}
-		
-		const auto PCs = GameModeInfernale->GetPlayerControllers();
-		auto FPlayerControllerInfos = TArray<FPlayerControllerInfo>();
-		for (const auto PC : PCs)
-		{
-			FPlayerControllerInfo Info;
-			Info.PlayerController = PC;
-			Info.PlayerLocation = PC->GetCameraCenterPoint();
-			Info.DataForVisualisations = TArray<FDataForVisualisation>();
-			Info.EntityHandlesToHide = TArray<FMassEntityHandle>();
-			FPlayerControllerInfos.Add(Info);
 		}
-		const auto Radius = VisualisationManager->GetRadius();
 
-
-		TArray<FMassEntityHandle> Handles = TArray<FMassEntityHandle>();
-		for (int32 i = 0; i < Entities.Num(); ++i)
-		{
-			const auto UpdatedLocation = UpdatedLocations[i];
-			const auto UpdatedRotation = UpdatedRotations[i];
-			FAmalgamMovementFragment* MovementFragment = &MovementFragView[i];
-			
-			FDataForVisualisation Data = FDataForVisualisation();
-			Data.EntityHandle = Entities[i];
-			Data.LocationX = UpdatedLocation.X;
-			Data.LocationY = UpdatedLocation.Y;
-			Data.RotationX = UpdatedRotation.X;
-			Data.RotationY = UpdatedRotation.Y;
-			
-
-			for (FPlayerControllerInfo& FPlayerControllerInfo : FPlayerControllerInfos)
-			{
-				const auto PCTeam = FPlayerControllerInfo.PlayerController->GetTeam();
-				const auto Distance = FVector::DistSquared(FPlayerControllerInfo.PlayerLocation, UpdatedLocation);
-				if (Distance > FMath::Square(Radius))
-				{
-					if (!MovementFragment->IsVisibleBy(PCTeam)) continue;
-					MovementFragment->SetVisibleBy(PCTeam, false);
-					FPlayerControllerInfo.EntityHandlesToHide.Add(Entities[i]);
-					continue;
-				}
-				FPlayerControllerInfo.DataForVisualisations.Add(Data);
-				MovementFragment->SetVisibleBy(PCTeam, true);
-			}
-			
-			//DataForVisualisation.Add(Data);
-		}
-
-		if (Entities.Num() != UpdatedLocations.Num())
-		{
-			GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, FString::Printf(TEXT("AmalgamMoveProcessor : \n\t Handles and UpdatedLocations size mismatch.")));
-			return;
-		}
-		
-		//VisualisationManager->BatchUpdatePosition(Handles, DataForVisualisation);
-
-		for (FPlayerControllerInfo& FPlayerControllerInfo : FPlayerControllerInfos)
-		{
-			FPlayerControllerInfo.PlayerController->UpdateUnits(FPlayerControllerInfo.DataForVisualisations, FPlayerControllerInfo.EntityHandlesToHide);
-		}
+		AttackScheduler.SchedulePending(NewAttacks);
 	}));
-	
-
-}
-
-FVector UAmalgamMoveProcessor::GetDirectionFollow(const FVector Location, FVector& Destination, FAmalgamFluxFragment& FluxFragment)
-{
-	int32 SplinePointIndex = FluxFragment.GetSplinePointIndex();
-
-	USplineComponent* Spline = FluxFragment.GetFlux()->GetSplineForAmalgamsComponent();
-	Destination = Spline->GetSplinePointAt(SplinePointIndex, ESplineCoordinateSpace::World).Position;
-
-	Destination.Z = 0.f;
-
-	return (Destination - Location).GetSafeNormal();
 }
 
-FVector UAmalgamMoveProcessor::GetDirectionAggroed(const FVector Location, FVector& Destination, FAmalgamTargetFragment& TargetFragment, FAmalgamAggroFragment& AggroFragment, FAmalgamStateFragment& StateFragment)
-{
-	switch (StateFragment.GetAggro())
-	{
-	case EAmalgamAggro::Amalgam:
-		Destination = ASpatialHashGrid::GetEntityData(TargetFragment.GetTargetEntityHandle()).Location;
-		break;
-
-	case EAmalgamAggro::Building:
-		if (!TargetFragment.GetTargetBuilding().IsValid())
-		{
-			if(bDebugMove) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, FString::Printf(TEXT("MoveProcessor : \n\t Target building is null.")));
-			return FVector::ZeroVector;
-		}
-
-		Destination = TargetFragment.GetTargetBuilding()->GetActorLocation();
-		break;
-	}
-
-	Destination.Z = 0.f;
-
-	return (Destination - Location).GetSafeNormal();
-}
-
-FVector UAmalgamMoveProcessor::GetTargetLocation(const FAmalgamTargetFragment TargetFrag)
+FVector UAmalgamMoveProcessor::GetTargetLocation(const FAmalgamTargetFragment& TargetFrag)
 {
 	FVector Location = FVector::ZeroVector;
-	if (TargetFrag.GetTargetBuilding().IsValid()) 
-	{
-		Location = TargetFrag.GetTargetBuilding()->GetActorLocation();
-	}
-	else if (TargetFrag.GetTargetLDElem().IsValid())
-	{
-		Location = TargetFrag.GetTargetLDElem()->GetActorLocation();
-	}
-	else
-	{
-		if (!ASpatialHashGrid::Contains(TargetFrag.GetTargetEntityHandle()))
-			return FVector::ZeroVector;
-
-		Location = ASpatialHashGrid::GetEntityData(TargetFrag.GetTargetEntityHandle()).Location;
-	}
+	if (!ASpatialHashGrid::GetTargetLocation(TargetFrag.GetTargetRef(), Location))
+		return FVector::ZeroVector;
 
 	return Location;
 }
 
-bool UAmalgamMoveProcessor::CheckIfPathEnded(FAmalgamFluxFragment& FluxFrag, FVector Location, FVector Destination, EAmalgamState State)
+bool UAmalgamMoveProcessor::FollowPath(FTransformFragment& TrsfFrag, FAmalgamPathfindingFragment& PathFragment, FAmalgamDirectionFragment& DirFragment, float Speed, const float DeltaTime)
 {
-	float Distance = (Location - Destination).Length();
+	FTransform& Transform = TrsfFrag.GetMutableTransform();
+	const auto CurrentLocation = TrsfFrag.GetTransform().GetLocation();
 
-	switch (State)
+	// Baked samples can be closer than the acceptance radius, skip all the ones we already reached
+	while (PathFragment.HasPathPoint() && FVector::Dist(PathFragment.GetPathPoint(), CurrentLocation) < PathFragment.GetAcceptancePathfindingRadius())
 	{
-	case EAmalgamState::FollowPath:
-		if (!FluxFrag.CheckFluxIsValid()) return false;
-		break;
-
-	case EAmalgamState::Aggroed:
-
-		break;
-
-	default:
-		break;
+		PathFragment.NextPoint();
 	}
 
-	return Distance <= DistanceThreshold;
-}
-
-bool UAmalgamMoveProcessor::FollowPath(FTransformFragment& TrsfFrag, FAmalgamFluxFragment& FlxFrag, FAmalgamPathfindingFragment& PathFragment, FAmalgamDirectionFragment& DirFragment, float Speed, const float DeltaTime)
-{
-	TArray<FVector>& Path = PathFragment.Path;
-
-	FTransform& Transform = TrsfFrag.GetMutableTransform();
-	const auto CurrentLocation = TrsfFrag.GetTransform().GetLocation();
-	if (Path.Num() == 0)
+	if (!PathFragment.HasPathPoint())
 	{
 		return false;
 	}
 
-	const FVector TargetLocation = Path[0];
+	const FVector TargetLocation = PathFragment.GetPathPoint();
 	const auto Direction = TargetLocation - CurrentLocation;
-	const auto Distance = Direction.Length();
-
-	if (Distance < PathFragment.GetAcceptancePathfindingRadius())
-	{
-		FlxFrag.NextSplinePoint();
-		PathFragment.NextPoint();
-		return true;
-	}
 
 	const auto DirectionNormalized = Direction.GetSafeNormal();
 	//Speed = TransmutationComponent->GetEffectUnitSpeed(Speed);
 	const auto NewLocation = CurrentLocation + DirectionNormalized * Speed * DeltaTime;
-	const auto OldLocation = CurrentLocation;
 	Transform.SetLocation(NewLocation);
 	
 	DirFragment.Direction = DirectionNormalized;
@@ -382,6 +264,23 @@ bool UAmalgamMoveProcessor::FollowPath(FTransformFragment& TrsfFrag, FAmalgamFlu
 	
 }
 
+bool UAmalgamMoveProcessor::TryStartDeadReckoning(const FVector Location, const FAmalgamPathfindingFragment& PathFragment, float WakeRange, ETeam Team, float Speed, double SimulationTime, FAmalgamDeadReckoningFragment& DeadReckoningFragment)
+{
+	if (!PathFragment.HasPathPoint()) return false;
+
+	// We are heading towards the current path point, so we are that far behind it along the path
+	const FAmalgamFluxPathLUT& PathLUT = *PathFragment.GetPathLUT();
+	const float Distance = FMath::Max(0.f, PathLUT.GetDistanceAtIndex(PathFragment.GetPathIndex()) - FVector::Dist2D(Location, PathFragment.GetPathPoint()));
+
+	// Amalgams pushed off the path (after a fight) first walk back onto it, otherwise they would snap
+	if (FVector::Dist2D(PathLUT.GetPositionAtDistance(Distance), Location) > PathFragment.GetAcceptancePathfindingRadius()) return false;
+
+	if (ASpatialHashGrid::HasPotentialTargetsAround(Location, WakeRange, Team)) return false;
+
+	DeadReckoningFragment.Start(Distance, SimulationTime, Speed);
+	return true;
+}
+
 bool UAmalgamMoveProcessor::FollowTarget(FTransformFragment& TrsfFrag, FVector TargetLocation, FAmalgamDirectionFragment& DirFragment, float Speed, float AcceptanceRadiusAttack, const float DeltaTime)
 {
 	FTransform& Transform = TrsfFrag.GetMutableTransform();
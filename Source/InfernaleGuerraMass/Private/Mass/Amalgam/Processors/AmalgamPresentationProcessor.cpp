@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Processors/AmalgamPresentationProcessor.h"
+
+//Fragments
+#include "Mass/Army/AmalgamFragments.h"
+
+//Processor
+#include "MassExecutionContext.h"
+#include "Mass/Amalgam/Processors/AmalgamVisibilityProcessor.h"
+
+//Subsystem
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include <Mass/Collision/SpatialHashGrid.h>
+#include "Mass/Replication/AmalgamViewReportComponent.h"
+
+// Misc
+#include "GameMode/Infernale/GameModeInfernale.h"
+#include "Kismet/GameplayStatics.h"
+#include "Structs/ReplicationStructs.h"
+
+UAmalgamPresentationProcessor::UAmalgamPresentationProcessor()
+{
+	ExecutionFlags = (int32)(EProcessorExecutionFlags::Server | EProcessorExecutionFlags::Standalone);
+	ExecutionOrder.ExecuteAfter.Add(UAmalgamVisibilityProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
+
+	bAutoRegisterWithProcessingPhases = true;
+
+	// Talks to the player controllers and the visualisation manager
+	bRequiresGameThreadExecution = true;
+}
+
+void UAmalgamPresentationProcessor::ConfigureQueries()
+{
+	// Doesn't iterate entities, only snapshots the player views
+}
+
+void UAmalgamPresentationProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	if (!VisualisationManager)
+	{
+		TArray<AActor*> OutActors;
+		UGameplayStatics::GetAllActorsOfClass(GetWorld(), AAmalgamVisualisationManager::StaticClass(), OutActors);
+
+		if (OutActors.Num() > 0)
+			VisualisationManager = static_cast<AAmalgamVisualisationManager*>(OutActors[0]);
+		else
+			VisualisationManager = nullptr;
+
+		check(VisualisationManager);
+	}
+	if (!GameModeInfernale)
+	{
+		const auto GameMode = Cast<AGameModeInfernale>(UGameplayStatics::GetGameMode(GetWorld()));
+		if (GameMode)
+			GameModeInfernale = GameMode;
+		else
+			GameModeInfernale = nullptr;
+
+		check(GameModeInfernale);
+	}
+
+	// Updates are sent by the collector once the phase is over, we only refresh the views here
+	FAmalgamVisualUpdateCollector& Collector = SimulationSubsystem->GetVisualUpdateCollector();
+
+	// Snapshot the views for the next visibility pass
+	const FIntVector2 CellSize = ASpatialHashGrid::GetCellSize();
+	const FVector GridLocation = ASpatialHashGrid::GetGridLocation();
+	const FIntVector2 GridSize = ASpatialHashGrid::GetGridSize();
+	const auto Radius = VisualisationManager->GetRadius();
+	const bool bUseViewReports = SimulationSubsystem->UsesViewReports();
+	const bool bUseClientPaths = SimulationSubsystem->UsesClientPathSimulation();
+
+	FAmalgamViewCullingSettings CullingSettings;
+	CullingSettings.UnitSize = SimulationSubsystem->GetUnitVisualSize();
+	CullingSettings.MinScreenSize = SimulationSubsystem->GetMinUnitScreenSize();
+	CullingSettings.ImpostorBlockSize = SimulationSubsystem->GetImpostorBlockSize();
+
+	// Block summaries are shared by every player, rebuilt once before the impostors are sent
+	bool bSendImpostors = false;
+	if (bUseViewReports && SimulationSubsystem->UsesImpostors())
+	{
+		CullingSettings.ImpostorScreenSize = SimulationSubsystem->GetImpostorScreenSize();
+
+		const float Now = GetWorld()->GetTimeSeconds();
+		if (Now - LastImpostorUpdateTime >= SimulationSubsystem->GetImpostorUpdateInterval())
+		{
+			LastImpostorUpdateTime = Now;
+			ASpatialHashGrid::RefreshCoarseSummaries(CullingSettings.ImpostorBlockSize);
+			bSendImpostors = true;
+		}
+	}
+
+	TArray<FAmalgamPlayerView> NewPlayerViews;
+	for (const auto PC : GameModeInfernale->GetPlayerControllers())
+	{
+		const FVector CameraCenter = PC->GetCameraCenterPoint();
+
+		FAmalgamPlayerView& View = NewPlayerViews.AddDefaulted_GetRef();
+		View.PlayerController = PC;
+		View.TeamBit = FAmalgamVisibilityFragment::GetTeamBit(PC->GetTeam());
+
+		// Clients also confirm their flux bakes through it. Players that haven't reported their view yet keep the radius around their camera
+		UAmalgamViewReportComponent* ViewReport = bUseViewReports || bUseClientPaths ? UAmalgamViewReportComponent::FindOrAdd(PC) : nullptr;
+		const FAmalgamViewReport* Report = ViewReport ? ViewReport->GetReport(SimulationSubsystem->GetViewReportTimeout()) : nullptr;
+		if (Report)
+		{
+			// Between two sends the blocks stay the ones the client draws as impostors
+			View.InitFromReport(*Report, CullingSettings, FVector2D(GridLocation.X, GridLocation.Y), FVector2D(CellSize.X, CellSize.Y), FIntPoint(GridSize.X, GridSize.Y),
+				bSendImpostors ? nullptr : &ViewReport->GetImpostorBlocks());
+			if (bSendImpostors)
+				SendImpostors(View, *ViewReport);
+			continue;
+		}
+
+		// Without a report the player sees every unit in its radius, drop the impostors it may still draw
+		if (bSendImpostors && ViewReport)
+			ViewReport->SendImpostors({}, {});
+
+		View.Init(FVector2D(CameraCenter.X, CameraCenter.Y), Radius, FVector2D(GridLocation.X, GridLocation.Y), FVector2D(CellSize.X, CellSize.Y));
+	}
+	Collector.SetPlayerViews(MoveTemp(NewPlayerViews));
+}
+
+void UAmalgamPresentationProcessor::SendImpostors(const FAmalgamPlayerView& View, UAmalgamViewReportComponent& ViewReport) const
+{
+	TArray<FAmalgamImpostor> Impostors;
+	for (const FIntPoint& Block : View.ImpostorBlocks)
+	{
+		const FGridCoarseCell* CoarseCell = ASpatialHashGrid::GetCoarseCell(Block);
+		if (!CoarseCell) continue;
+
+		for (const FGridCoarseSummary& Summary : *CoarseCell)
+		{
+			if (Summary.Count == 0) continue;
+
+			FAmalgamImpostor& Impostor = Impostors.AddDefaulted_GetRef();
+			Impostor.Centroid = Summary.GetCentroid();
+			Impostor.Spread = Summary.GetSpread();
+			Impostor.Count = Summary.Count;
+			Impostor.Team = Summary.Team;
+		}
+	}
+	ViewReport.SendImpostors(Impostors, View.ImpostorBlocks);
+}
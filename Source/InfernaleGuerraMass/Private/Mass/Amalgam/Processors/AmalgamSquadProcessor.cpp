@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Processors/AmalgamSquadProcessor.h"
+
+//Tags
+#include "Mass/Army/AmalgamTags.h"
+
+//Fragments
+#include "Mass/Army/AmalgamFragments.h"
+#include "MassCommonFragments.h"
+
+//Processor
+#include "MassExecutionContext.h"
+#include "Mass/Amalgam/Processors/AmalgamAggroProcessor.h"
+#include "Mass/Amalgam/Processors/AmalgamDeadReckoningProcessor.h"
+#include "Mass/Amalgam/Processors/AmalgamMoveProcessor.h"
+
+//Subsystem
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include <Mass/Collision/SpatialHashGrid.h>
+
+UAmalgamSquadProcessor::UAmalgamSquadProcessor() : EntityQuery(*this)
+{
+	ExecutionFlags = (int32)(EProcessorExecutionFlags::Server | EProcessorExecutionFlags::Standalone);
+	// Squad bounds must be taken once everyone moved for the step, members query from where they stand
+	ExecutionOrder.ExecuteAfter.Add(UAmalgamMoveProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteAfter.Add(UAmalgamDeadReckoningProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(UAmalgamAggroProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
+
+	bAutoRegisterWithProcessingPhases = true;
+
+	// Owns the squad registry, which the aggro workers read afterwards
+	bRequiresGameThreadExecution = true;
+}
+
+void UAmalgamSquadProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamSquadFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamAggroFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamFluxFragment>(EMassFragmentAccess::ReadOnly);
+
+	EntityQuery.AddTagRequirement<FAmalgamClientExecuteTag>(EMassFragmentPresence::None);
+
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UAmalgamSquadProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	if (!SimulationSubsystem->UsesSquads()) return;
+
+	const FAmalgamSimulationClock& Clock = SimulationSubsystem->GetSimulationClock();
+	if (!Clock.ShouldStep()) return;
+
+	FAmalgamSquadRegistry& SquadRegistry = SimulationSubsystem->GetSquadRegistry();
+
+	Members.Reset();
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context)
+		{
+			const TConstArrayView<FTransformFragment> TransformView = Context.GetFragmentView<FTransformFragment>();
+			const TConstArrayView<FAmalgamSquadFragment> SquadFragView = Context.GetFragmentView<FAmalgamSquadFragment>();
+			const TConstArrayView<FAmalgamStateFragment> StateFragView = Context.GetFragmentView<FAmalgamStateFragment>();
+			const TConstArrayView<FAmalgamAggroFragment> AggroFragView = Context.GetFragmentView<FAmalgamAggroFragment>();
+			const TConstArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetFragmentView<FAmalgamOwnerFragment>();
+			const TConstArrayView<FAmalgamFluxFragment> FluxFragView = Context.GetFragmentView<FAmalgamFluxFragment>();
+
+			// Dead reckoned amalgams don't look for targets, they only count as members
+			const bool bDeadReckoned = Context.DoesArchetypeHaveTag<FAmalgamDeadReckoningTag>();
+
+			for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index)
+			{
+				if (SquadFragView[Index].GetSquadId() == INDEX_NONE) continue;
+
+				FAmalgamSquadMember& Member = Members.AddDefaulted_GetRef();
+				Member.Entity = Context.GetEntity(Index);
+				Member.SquadId = SquadFragView[Index].GetSquadId();
+				Member.Location = TransformView[Index].GetTransform().GetLocation();
+				Member.DetectionRange = AggroFragView[Index].GetAggroRange() + AggroFragView[Index].GetTargetableRange();
+				Member.FluxKey = FluxFragView[Index].GetFluxKey();
+				Member.Team = OwnerFragView[Index].GetOwner().Team;
+				Member.bActive = !bDeadReckoned && StateFragView[Index].GetState() == EAmalgamState::FollowPath;
+			}
+		});
+
+	// Staggered with the simulation tick, not every step needs to regroup
+	if (Clock.IsDueThisFrame(0, SimulationSubsystem->GetSquadClusterInterval()))
+	{
+		SquadRegistry.Recluster(Members);
+
+		for (const FAmalgamSquadMember& Member : Members)
+		{
+			if (!Member.bReassigned) continue;
+
+			if (FAmalgamSquadFragment* SquadFragment = EntityManager.GetFragmentDataPtr<FAmalgamSquadFragment>(Member.Entity))
+				SquadFragment->SetSquadId(Member.SquadId);
+		}
+	}
+
+	SquadRegistry.Accumulate(Members);
+
+	if (!ASpatialHashGrid::IsValid()) return;
+
+	ASpatialHashGrid::RefreshTargetSnapshots();
+	SquadRegistry.GatherCandidates();
+}
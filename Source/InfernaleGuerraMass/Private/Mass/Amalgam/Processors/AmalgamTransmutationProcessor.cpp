@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Processors/AmalgamTransmutationProcessor.h"
+
+//Fragments
+#include "Mass/Army/AmalgamFragments.h"
+
+//Processor
+#include "MassExecutionContext.h"
+#include "Mass/Amalgam/Processors/AmalgamMoveProcessor.h"
+#include "Mass/Amalgam/Processors/AmalgamFightProcessor.h"
+#include "Mass/Collision/SpatialHashGridProcessor.h"
+
+UAmalgamTransmutationProcessor::UAmalgamTransmutationProcessor() : EntityQuery(*this)
+{
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+	ExecutionOrder.ExecuteBefore.Add(UAmalgamMoveProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(UAmalgamFightProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(USpatialHashGridProcessor::StaticClass()->GetFName());
+
+	bAutoRegisterWithProcessingPhases = true;
+
+	// Reads the transmutation component
+	bRequiresGameThreadExecution = true;
+}
+
+void UAmalgamTransmutationProcessor::ConfigureQueries()
+{
+	EntityQuery.AddSharedRequirement<FAmalgamTransmutationSharedFragment>(EMassFragmentAccess::ReadWrite);
+
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UAmalgamTransmutationProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, ([this](FMassExecutionContext& Context)
+	{
+		// Every chunk shares the same fragment, later chunks see the UpdateIDs already matching and bail out immediately
+		FAmalgamTransmutationSharedFragment& Transmutation = Context.GetMutableSharedFragment<FAmalgamTransmutationSharedFragment>();
+		if (Transmutation.Refresh())
+		{
+			if (bDebug) GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Cyan, TEXT("AmalgamTransmutationProcessor : \n\t Multipliers refreshed"));
+		}
+	}));
+}
@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Processors/AmalgamVisibilityProcessor.h"
+
+//Tags
+#include "Mass/Army/AmalgamTags.h"
+
+//Fragments
+#include "Mass/Army/AmalgamFragments.h"
+#include "MassCommonFragments.h"
+
+//Processor
+#include "MassExecutionContext.h"
+#include "Mass/Amalgam/Processors/AmalgamMoveProcessor.h"
+
+//Subsystem
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Amalgam/Data/AmalgamStateDispatch.h"
+#include "GameMode/Infernale/GameModeInfernale.h"
+
+UAmalgamVisibilityProcessor::UAmalgamVisibilityProcessor() : EntityQuery(*this)
+{
+	ExecutionFlags = (int32)(EProcessorExecutionFlags::Server | EProcessorExecutionFlags::Standalone);
+	ExecutionOrder.ExecuteAfter.Add(UAmalgamMoveProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(UE::Mass::ProcessorGroupNames::Avoidance);
+
+	bAutoRegisterWithProcessingPhases = true;
+	bRequiresGameThreadExecution = false;
+}
+
+void UAmalgamVisibilityProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamVisibilityFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadOnly);
+
+	if (GetDefault<UAmalgamSimulationSubsystem>()->UsesStateTags())
+		EntityQuery.AddTagRequirement<FAmalgamMoveTag>(EMassFragmentPresence::All);
+
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UAmalgamVisibilityProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	if (!SimulationSubsystem)
+	{
+		SimulationSubsystem = UWorld::GetSubsystem<UAmalgamSimulationSubsystem>(GetWorld());
+		check(SimulationSubsystem);
+	}
+	// Nothing moved, clients keep interpolating towards the last state we sent
+	if (!SimulationSubsystem->GetSimulationClock().ShouldStep()) return;
+
+	FAmalgamVisualUpdateCollector& Collector = SimulationSubsystem->GetVisualUpdateCollector();
+
+	// Views are only rewritten by the presentation processor, which runs after us
+	const TArray<FAmalgamPlayerView>& PlayerViews = Collector.GetPlayerViews();
+	if (PlayerViews.Num() == 0) return;
+
+	Collector.BeginFrame(EntityQuery.GetNumMatchingEntities(EntityManager));
+
+	// Same amalgams as the move processor
+	const uint32 StateMask = SimulationSubsystem->UsesStateTags() ? FAmalgamStateDispatch::AllStates
+		: FAmalgamStateDispatch::StateBit(EAmalgamState::FollowPath) | FAmalgamStateDispatch::StateBit(EAmalgamState::Aggroed);
+
+	// Remote clients move the amalgams replicated to them on a path themselves, see UAmalgamClientMoveProcessor.
+	// Only written by the replicator, which can't run at the same time as us
+	TArray<const TSet<FMassEntityHandle>*, TInlineAllocator<8>> ClientPathEntities;
+	ClientPathEntities.Init(nullptr, PlayerViews.Num());
+	if (SimulationSubsystem->UsesClientPathSimulation())
+	{
+		for (int32 ViewIndex = 0; ViewIndex < PlayerViews.Num(); ++ViewIndex)
+		{
+			const APlayerControllerInfernale* PlayerController = PlayerViews[ViewIndex].PlayerController.Get();
+			if (PlayerController && !PlayerController->IsLocalController())
+				ClientPathEntities[ViewIndex] = SimulationSubsystem->GetClientPathEntities(PlayerController);
+		}
+	}
+
+	EntityQuery.ParallelForEachEntityChunk(EntityManager, Context, ([&Collector, &PlayerViews, &ClientPathEntities, StateMask](FMassExecutionContext& Context)
+	{
+		const bool bDeadReckoned = Context.DoesArchetypeHaveTag<FAmalgamDeadReckoningTag>();
+
+		const TConstArrayView<FTransformFragment> TransformView = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FAmalgamDirectionFragment> DirectionFragView = Context.GetFragmentView<FAmalgamDirectionFragment>();
+		TArrayView<FAmalgamVisibilityFragment> VisibilityFragView = Context.GetMutableFragmentView<FAmalgamVisibilityFragment>();
+		const TConstArrayView<FAmalgamStateFragment> StateFragView = Context.GetFragmentView<FAmalgamStateFragment>();
+
+		// Per worker scratch, reused by every chunk the worker processes
+		static thread_local TArray<FAmalgamPlayerUpdateScratch> Scratch;
+		if (Scratch.Num() < PlayerViews.Num())
+			Scratch.SetNum(PlayerViews.Num());
+		for (int32 ViewIndex = 0; ViewIndex < PlayerViews.Num(); ++ViewIndex)
+		{
+			Scratch[ViewIndex].Shown.Reset();
+			Scratch[ViewIndex].Hidden.Reset();
+		}
+
+		FAmalgamStateDispatch::FEntityIndices EntityIndices;
+		FAmalgamStateDispatch::GatherEntities(StateFragView, StateMask, EntityIndices);
+		if (EntityIndices.IsEmpty()) return;
+
+		// Chunks are culled as a whole first, only the views that cut through their bounds test each entity
+		FVector2D ChunkMin(TNumericLimits<float>::Max()), ChunkMax(-TNumericLimits<float>::Max());
+		for (const int32 Index : EntityIndices)
+		{
+			const FVector& Location = TransformView[Index].GetTransform().GetLocation();
+			ChunkMin = FVector2D::Min(ChunkMin, FVector2D(Location.X, Location.Y));
+			ChunkMax = FVector2D::Max(ChunkMax, FVector2D(Location.X, Location.Y));
+		}
+
+		TArray<EAmalgamCellVisibility, TInlineAllocator<8>> ChunkStates;
+		ChunkStates.SetNumUninitialized(PlayerViews.Num());
+		for (int32 ViewIndex = 0; ViewIndex < PlayerViews.Num(); ++ViewIndex)
+		{
+			ChunkStates[ViewIndex] = PlayerViews[ViewIndex].ClassifyRegion(ChunkMin, ChunkMax, EntityIndices.Num());
+		}
+
+		for (const int32 Index : EntityIndices)
+		{
+			const FVector Location = TransformView[Index].GetTransform().GetLocation();
+			const FVector& Direction = DirectionFragView[Index].Direction;
+			FAmalgamVisibilityFragment& VisibilityFragment = VisibilityFragView[Index];
+			const FMassEntityHandle Entity = Context.GetEntity(Index);
+
+			const FVector2D Location2D(Location.X, Location.Y);
+
+			for (int32 ViewIndex = 0; ViewIndex < PlayerViews.Num(); ++ViewIndex)
+			{
+				const FAmalgamPlayerView& View = PlayerViews[ViewIndex];
+
+				const bool bVisible = ChunkStates[ViewIndex] == EAmalgamCellVisibility::Partial ? View.IsVisible(Location2D)
+					: ChunkStates[ViewIndex] == EAmalgamCellVisibility::Visible;
+				if (!bVisible)
+				{
+					if (VisibilityFragment.SetVisibleByBit(View.TeamBit, false))
+						Scratch[ViewIndex].Hidden.Add(Entity);
+					continue;
+				}
+
+				// The client already moves it, it only needs to know when it shows up
+				if (!VisibilityFragment.SetVisibleByBit(View.TeamBit, true) && bDeadReckoned
+					&& ClientPathEntities[ViewIndex] && ClientPathEntities[ViewIndex]->Contains(Entity))
+					continue;
+
+				FDataForVisualisation& Data = Scratch[ViewIndex].Shown.AddDefaulted_GetRef();
+				Data.EntityHandle = Entity;
+				Data.LocationX = Location.X;
+				Data.LocationY = Location.Y;
+				Data.RotationX = Direction.X;
+				Data.RotationY = Direction.Y;
+			}
+		}
+
+		for (int32 ViewIndex = 0; ViewIndex < PlayerViews.Num(); ++ViewIndex)
+		{
+			Collector.Append(ViewIndex, Scratch[ViewIndex].Shown, Scratch[ViewIndex].Hidden);
+		}
+	}));
+}
@@ -37,6 +37,8 @@ void USpatialHashGridProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FAmalgamTargetFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamTransmutationFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddSharedRequirement<FAmalgamTransmutationSharedFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadOnly);
 	
 	EntityQuery.AddTagRequirement<FAmalgamInitializeTag>(EMassFragmentPresence::None);
 	EntityQuery.AddTagRequirement<FAmalgamKillTag>(EMassFragmentPresence::None);
@@ -56,6 +58,8 @@ void USpatialHashGridProcessor::Execute(FMassEntityManager& EntityManager, FMass
 			TArrayView<FAmalgamTargetFragment> TargetFragView = Context.GetMutableFragmentView<FAmalgamTargetFragment>();
 			TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
 			TArrayView<FAmalgamTransmutationFragment> TransmFragView = Context.GetMutableFragmentView<FAmalgamTransmutationFragment>();
+			const FAmalgamTransmutationSharedFragment& Transmutation = Context.GetSharedFragment<FAmalgamTransmutationSharedFragment>();
+			TConstArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetFragmentView<FAmalgamOwnerFragment>();
 
 			const float WorldDeltaTime = Context.GetDeltaTimeSeconds();
 
@@ -70,13 +74,14 @@ void USpatialHashGridProcessor::Execute(FMassEntityManager& EntityManager, FMass
 
 				GridCellEntityData* GridEntityData = ASpatialHashGrid::GetMutableEntityData(EntityHandle);
 
-				if (TransmutationFragment.WasUpdated())
+				const FAmalgamTransmutationMultipliers& Multipliers = Transmutation.GetMultipliers(OwnerFragView[Index].GetOwner());
+				if (TransmutationFragment.WasUpdated(Multipliers))
 				{
-					float NewMax = TransmutationFragment.GetHealthModifier(GridEntityData->MaxEntityHealth);
+					float NewMax = Multipliers.GetHealthModifier(GridEntityData->MaxEntityHealth);
 					GridEntityData->EntityHealth = (GridEntityData->EntityHealth / GridEntityData->MaxEntityHealth) * NewMax;
 					GridEntityData->MaxEntityHealth = NewMax;
 
-					TransmutationFragment.Update();
+					TransmutationFragment.Update(Multipliers);
 				}
 
 				if (GridEntityData->EntityHealth <= 0.f) 
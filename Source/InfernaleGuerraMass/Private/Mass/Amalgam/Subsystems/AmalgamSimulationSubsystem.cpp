@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+
+#include "MassSimulationSubsystem.h"
+#include "Mass/Army/AmalgamFragments.h"
+#include "Flux/Flux.h"
+#include "Manager/UnitActorManager.h"
+#include "Manager/AmalgamVisualisationManager.h"
+#include "DataAssets/AmalgamReplicationLODAsset.h"
+#include <Kismet/GameplayStatics.h>
+
+void UAmalgamSimulationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	SimulationClock.Configure(bUseFixedTimestep, SimulationRate, MaxCatchUpSteps);
+	FluxPathCache.Configure(FluxPathSpacing);
+	AttackScheduler.Configure(SimulationClock.GetFixedStep());
+	SquadRegistry.Configure(MaxSquadSize);
+
+	FAmalgamUnitStreamSettings UnitStreamSettings;
+	UnitStreamSettings.KeyframeInterval = UnitStreamKeyframeInterval;
+	UnitStreamSettings.MaxPacketBytes = UnitStreamMaxPacketBytes;
+	VisualUpdateCollector.ConfigureUnitStream(bUseUnitStream, UnitStreamSettings);
+
+	FAmalgamVisualUpdateSchedulerSettings SchedulerSettings;
+	SchedulerSettings.Budget = FMath::Max(0, VisualUpdateBudget);
+	SchedulerSettings.MaxStaleness = FMath::Max(1, VisualUpdateMaxStaleness);
+	VisualUpdateCollector.ConfigureScheduler(SchedulerSettings);
+}
+
+void UAmalgamSimulationSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Amalgam processors all run in the default PrePhysics phase
+	UMassSimulationSubsystem* MassSimulationSubsystem = UWorld::GetSubsystem<UMassSimulationSubsystem>(&InWorld);
+	check(MassSimulationSubsystem);
+	PhaseStartedHandle = MassSimulationSubsystem->GetOnProcessingPhaseStarted(EMassProcessingPhase::PrePhysics).AddUObject(this, &UAmalgamSimulationSubsystem::OnPrePhysicsPhaseStarted);
+	PhaseFinishedHandle = MassSimulationSubsystem->GetOnProcessingPhaseFinished(EMassProcessingPhase::PrePhysics).AddUObject(this, &UAmalgamSimulationSubsystem::OnPrePhysicsPhaseFinished);
+	FrameEndFinishedHandle = MassSimulationSubsystem->GetOnProcessingPhaseFinished(EMassProcessingPhase::FrameEnd).AddUObject(this, &UAmalgamSimulationSubsystem::OnFrameEndPhaseFinished);
+}
+
+void UAmalgamSimulationSubsystem::Deinitialize()
+{
+	if (UMassSimulationSubsystem* MassSimulationSubsystem = UWorld::GetSubsystem<UMassSimulationSubsystem>(GetWorld()))
+	{
+		MassSimulationSubsystem->GetOnProcessingPhaseStarted(EMassProcessingPhase::PrePhysics).Remove(PhaseStartedHandle);
+		MassSimulationSubsystem->GetOnProcessingPhaseFinished(EMassProcessingPhase::PrePhysics).Remove(PhaseFinishedHandle);
+		MassSimulationSubsystem->GetOnProcessingPhaseFinished(EMassProcessingPhase::FrameEnd).Remove(FrameEndFinishedHandle);
+	}
+
+	Super::Deinitialize();
+}
+
+bool UAmalgamSimulationSubsystem::IsStateTagged(EAmalgamState State) const
+{
+	if (bUseStateTags) return true;
+
+	switch (State)
+	{
+	case EAmalgamState::FollowPath:	return bTagFollowPathState;
+	case EAmalgamState::Aggroed:	return bTagAggroedState;
+	case EAmalgamState::Fighting:	return bTagFightingState;
+	case EAmalgamState::Inactive:	return bTagInactiveState;
+	default:						return true;
+	}
+}
+
+UAmalgamReplicationLODAsset* UAmalgamSimulationSubsystem::GetReplicationLODAsset() const
+{
+	return ReplicationLODAsset.LoadSynchronous();
+}
+
+void UAmalgamSimulationSubsystem::SetClientPathEntity(const AActor* Client, FMassEntityHandle Entity, bool bOnPath)
+{
+	if (!Client) return;
+
+	if (bOnPath)
+	{
+		ClientPathEntities.FindOrAdd(FObjectKey(Client)).Add(Entity);
+		return;
+	}
+
+	if (TSet<FMassEntityHandle>* Entities = ClientPathEntities.Find(FObjectKey(Client)))
+		Entities->Remove(Entity);
+}
+
+void UAmalgamSimulationSubsystem::ConfirmClientFluxPath(const AActor* Client, const AFlux* Flux, uint32 UpdateID, uint32 UpdateVersion)
+{
+	if (!Client || !Flux) return;
+
+	ClientFluxPaths.Add(TPair<FObjectKey, FObjectKey>(FObjectKey(Client), FObjectKey(Flux)), TPair<uint32, uint32>(UpdateID, UpdateVersion));
+}
+
+bool UAmalgamSimulationSubsystem::HasClientFluxPath(const AActor* Client, FObjectKey FluxKey, const FAmalgamFluxPathLUT& PathLUT) const
+{
+	const TPair<uint32, uint32>* Bake = ClientFluxPaths.Find(TPair<FObjectKey, FObjectKey>(FObjectKey(Client), FluxKey));
+	return Bake && Bake->Key == PathLUT.UpdateID && Bake->Value == PathLUT.UpdateVersion;
+}
+
+void UAmalgamSimulationSubsystem::OnPrePhysicsPhaseStarted(const float DeltaSeconds)
+{
+	SimulationClock.Advance(DeltaSeconds);
+	FluxPathCache.Update();
+}
+
+void UAmalgamSimulationSubsystem::OnPrePhysicsPhaseFinished(const float DeltaSeconds)
+{
+	VisualUpdateCollector.Flush(PendingVisualRemovals);
+
+	if (bDebugVisualUpdateScheduler && VisualUpdateCollector.GetUpdateScheduler().IsEnabled())
+	{
+		const FAmalgamVisualUpdateSchedulerStats& Stats = VisualUpdateCollector.GetUpdateScheduler().GetStepStats();
+		GEngine->AddOnScreenDebugMessage(1, 1.f, FColor::Cyan, FString::Printf(TEXT("Visual updates : %d sent, %d deferred, %d overdue"), Stats.Sent, Stats.Deferred, Stats.Overdue));
+	}
+
+	FlushVisualRemovals();
+
+	if (!BattleEventBuffer.IsEmpty())
+		BattleEventBuffer.Flush(GetBattleManager());
+}
+
+void UAmalgamSimulationSubsystem::OnFrameEndPhaseFinished(const float DeltaSeconds)
+{
+	// Kills from the later phases (actor damage, structure hits) would otherwise wait for the next PrePhysics
+	if (!BattleEventBuffer.IsEmpty())
+		BattleEventBuffer.Flush(GetBattleManager());
+
+	if (PendingVisualRemovals.IsEmpty()) return;
+
+	// Nothing was collected since the PrePhysics flush, this only forgets the entities and queues their stream removal
+	VisualUpdateCollector.Flush(PendingVisualRemovals);
+	FlushVisualRemovals();
+}
+
+void UAmalgamSimulationSubsystem::FlushVisualRemovals()
+{
+	if (PendingVisualRemovals.IsEmpty()) return;
+
+	if (AAmalgamVisualisationManager* Manager = GetVisualisationManager())
+		Manager->BatchRemoveFromMapP(PendingVisualRemovals);
+	PendingVisualRemovals.Reset();
+}
+
+UBattleManagerComponent* UAmalgamSimulationSubsystem::GetBattleManager()
+{
+	if (BattleManager.IsValid()) return BattleManager.Get();
+
+	TArray<AActor*> OutActors;
+	UGameplayStatics::GetAllActorsOfClass(GetWorld(), AUnitActorManager::StaticClass(), OutActors);
+
+	if (OutActors.Num() == 0)
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, TEXT("AmalgamSimulationSubsystem : Unable to find UnitActorManager, dropping battle events."));
+		return nullptr;
+	}
+
+	auto UnitActorManager = static_cast<AUnitActorManager*>(OutActors[0]);
+	if (!UnitActorManager) return nullptr;
+
+	BattleManager = UnitActorManager->GetBattleManagerComponent().Get();
+	return BattleManager.Get();
+}
+
+AAmalgamVisualisationManager* UAmalgamSimulationSubsystem::GetVisualisationManager()
+{
+	if (VisualisationManager.IsValid()) return VisualisationManager.Get();
+
+	AActor* Actor = UGameplayStatics::GetActorOfClass(GetWorld(), AAmalgamVisualisationManager::StaticClass());
+	if (!Actor)
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, TEXT("AmalgamSimulationSubsystem : Unable to find AmalgamVisualisationManager, dropping visual removals."));
+		return nullptr;
+	}
+
+	VisualisationManager = static_cast<AAmalgamVisualisationManager*>(Actor);
+	return VisualisationManager.Get();
+}
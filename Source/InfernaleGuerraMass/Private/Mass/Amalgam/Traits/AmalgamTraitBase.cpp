@@ -7,6 +7,7 @@
 #include "Engine/World.h"
 #include "MassEntityTemplateRegistry.h"
 #include "MassCommonFragments.h"
+#include "MassEntityUtils.h"
 
 // Custom Includes
 #include "Mass/Army/AmalgamFragments.h"
@@ -23,6 +24,11 @@ void UAmalgamTraitBase::BuildTemplate(FMassEntityTemplateBuildContext& BuildCont
 	BuildContext.AddFragment<FAmalgamGridFragment>();
 	BuildContext.AddFragment<FAmalgamStateFragment>();
 	BuildContext.AddFragment<FAmalgamDirectionFragment>();
+	BuildContext.AddFragment<FAmalgamVisibilityFragment>();
+	BuildContext.AddFragment<FAmalgamTransmutationFragment>();
+	BuildContext.AddFragment<FAmalgamDeadReckoningFragment>();
+	BuildContext.AddFragment<FAmalgamClientPathFragment>();
+	BuildContext.AddFragment<FAmalgamSquadFragment>();
 
 	// Add Param bound Fragments
 	FAmalgamMovementFragment& MvtFrag = BuildContext.AddFragment_GetRef<FAmalgamMovementFragment>();
@@ -30,10 +36,7 @@ void UAmalgamTraitBase::BuildTemplate(FMassEntityTemplateBuildContext& BuildCont
 	FAmalgamFightFragment& FghtFrag = BuildContext.AddFragment_GetRef<FAmalgamFightFragment>();
 	FAmalgamNiagaraFragment& NiagFrag = BuildContext.AddFragment_GetRef<FAmalgamNiagaraFragment>();
 	FAmalgamPathfindingFragment& PathFrag = BuildContext.AddFragment_GetRef<FAmalgamPathfindingFragment>();
-	FAmalgamTransmutationFragment& TransmutFrag = BuildContext.AddFragment_GetRef<FAmalgamTransmutationFragment>();
 	FAmalgamSightFragment& SightFrag = BuildContext.AddFragment_GetRef<FAmalgamSightFragment>();
-		
-	TransmutFrag.Init(World);
 
 	MvtFrag.SetParameters(MovementParams.BaseSpeed, MovementParams.BaseRushSpeed, MovementParams.SpeedMultiplier);
 	AgrFrag.SetParameters(DetectionParams.BaseDetectionRange, CombatParams.BaseRange, DetectionParams.BaseDetectionAngle, DetectionParams.TargetableRange, CombatParams.EntityType);
@@ -43,7 +46,13 @@ void UAmalgamTraitBase::BuildTemplate(FMassEntityTemplateBuildContext& BuildCont
 	PathFrag.SetParameters(AcceptanceParams.AcceptancePathfindingRadius, AcceptanceParams.AcceptanceRadiusAttack);
 	SightFrag.SetParameters(SightParams.BaseSightRange, SightParams.BaseSightAngle, SightParams.BaseSightType);
 
-	//FMassEntityManager& EntityManager = UE::Mass::Utils::GetEntityManagerChecked(World);
+	FMassEntityManager& EntityManager = UE::Mass::Utils::GetEntityManagerChecked(World);
+
+	// A single transmutation fragment for every template, owners register their component in UAmalgamInitializeProcessor
+	FAmalgamTransmutationSharedFragment TransmutationParams;
+	const uint32 TransmutationHash = GetTypeHash(FAmalgamTransmutationSharedFragment::StaticStruct()->GetFName());
+	FSharedStruct TransmutationSharedFragment = EntityManager.GetOrCreateSharedFragmentByHash<FAmalgamTransmutationSharedFragment>(TransmutationHash, TransmutationParams);
+	BuildContext.AddSharedFragment(TransmutationSharedFragment);
 	
 	//int32 InitParamsHash = UE::StructUtils::GetStructCrc32(FConstStructView::Make(InitParams)); 
 	//FSharedStruct InitSharedFragment = EntityManager.GetOrCreateSharedFragmentByHash<FAmalgamInitializeFragment>(InitParamsHash, InitParams);
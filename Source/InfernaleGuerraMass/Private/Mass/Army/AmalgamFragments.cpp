@@ -3,6 +3,7 @@
 
 #include "Mass/Collision/SpatialHashGrid.h"
 #include "LD/Buildings/BuildingParent.h"
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
 
 float FAmalgamTargetFragment::GetTargetRangeOffset(EAmalgamAggro AggroType) const
 {
@@ -11,15 +12,31 @@ float FAmalgamTargetFragment::GetTargetRangeOffset(EAmalgamAggro AggroType) cons
 	case NoAggro:
 		return 0.f;
 	case Amalgam:
-		return ASpatialHashGrid::GetEntityData(TargetEntity).TargetableRadius;
+	{
+		const GridCellEntityData* Data = ASpatialHashGrid::GetMutableEntityData(TargetRef);
+		return Data ? Data->TargetableRadius : 0.f;
+	}
 	case Building:
-		if (TargetBuilding.IsValid())
-			return TargetBuilding->GetTargetableRange();
-		else
-			return 0.0f;
+	{
+		const FGridTargetSnapshot* Snapshot = ASpatialHashGrid::GetStaticTargetSnapshot(TargetRef);
+		return Snapshot ? Snapshot->TargetableRange : 0.f;
+	}
 	case LDElement:
 		return 0.f;
 	}
 
 	return 0.f;
-}
\ No newline at end of file
+}
+
+void FAmalgamStateFragment::SetStateAndNotify(EAmalgamState InState, FMassExecutionContext& Context, int32 EntityIndexInContext)
+{
+	if (AmalgamState == EAmalgamState::Killed) return;
+
+	// Config only, the class default object is enough and safe to read from any thread
+	const UAmalgamSimulationSubsystem* Settings = GetDefault<UAmalgamSimulationSubsystem>();
+	const bool bShouldNotify = Settings->IsStateTagged(AmalgamState) || Settings->IsStateTagged(InState);
+
+	AmalgamState = InState;
+	if (bShouldNotify)
+		NotifyContext(Context, EntityIndexInContext);
+}
@@ -42,8 +42,10 @@ bool ASpatialHashGrid::AddEntityToGrid(FVector WorldCoordinates, FMassEntityHand
 	if (Contains(Entity)) return false;
 	
 	int CoordsIndex = CoordsToIndex(GridCoordinates);
-	Instance->GridCells[CoordsIndex].Entities.Add(Entity, GridCellEntityData(Owner, Transform->GetTransform().GetLocation(), Health, TargetableRadius, Type));
-	Instance->HandleToCoordsMap.Add(Entity, GridCoordinates);
+	const FVector Location = Transform->GetTransform().GetLocation();
+	GridCellEntityData& Data = Instance->GridCells[CoordsIndex].Entities.Add(Entity, GridCellEntityData(Owner, Location, Health, TargetableRadius, Type));
+	Data.SlotIndex = AcquireEntitySlot(Entity, GridCoordinates, Location);
+	Instance->EntitySlots[Data.SlotIndex].CellElement = Instance->GridCells[CoordsIndex].Entities.FindId(Entity);
 
 	Instance->GridCells[CoordsIndex].UpdatePresentOwners();
 
@@ -70,7 +72,7 @@ bool ASpatialHashGrid::RemoveEntityFromGrid(FMassEntityHandle Entity)
 	if (Instance->GridCells[CellIndex].Entities.IsEmpty()) return false;
 
 	Instance->GridCells[CellIndex].Entities.Remove(Entity);
-	Instance->HandleToCoordsMap.Remove(Entity);
+	ReleaseEntitySlot(Instance->HandleToSlotMap.FindAndRemoveChecked(Entity));
 
 	Instance->GridCells[CellIndex].UpdatePresentOwners();
 
@@ -79,6 +81,45 @@ bool ASpatialHashGrid::RemoveEntityFromGrid(FMassEntityHandle Entity)
 	return true;
 }
 
+/*
+* @param Entities : Entities removed from the grid, unknown ones are skipped
+* 
+* @return The number of entities actually removed
+*/
+int32 ASpatialHashGrid::RemoveEntitiesFromGrid(TConstArrayView<FMassEntityHandle> Entities)
+{
+	if (Entities.Num() == 0) return 0;
+
+	TSet<int32> TouchedCells;
+	int32 NumRemoved = 0;
+
+	for (const FMassEntityHandle Entity : Entities)
+	{
+		int32 SlotIndex = INDEX_NONE;
+		if (!Instance->HandleToSlotMap.RemoveAndCopyValue(Entity, SlotIndex)) continue;
+
+		const FIntVector2 CellCoordinates = Instance->EntitySlots[SlotIndex].Coords;
+		ReleaseEntitySlot(SlotIndex);
+		++NumRemoved;
+
+		if (!IsInGrid(CellCoordinates)) continue;
+
+		const int CellIndex = CoordsToIndex(CellCoordinates);
+		Instance->GridCells[CellIndex].Entities.Remove(Entity);
+		TouchedCells.Add(CellIndex);
+	}
+
+	for (const int32 CellIndex : TouchedCells)
+	{
+		Instance->GridCells[CellIndex].UpdatePresentOwners();
+	}
+
+	if (NumRemoved > 0)
+		RefreshPresent();
+
+	return NumRemoved;
+}
+
 /*
 * @param Entity : Entity to be moved
 * @param WorldCoordinates : The Entity's current world coordinates
@@ -108,7 +149,9 @@ bool ASpatialHashGrid::MoveEntityToCell(FMassEntityHandle Entity, FVector WorldC
 	Instance->GridCells[NewCellIndex].UpdatePresentOwners();
 	Instance->GridCells[CurrentCellIndex].UpdatePresentOwners();
 
-	Instance->HandleToCoordsMap[Entity] = NewCellCoords;
+	FGridEntitySlot& Slot = Instance->EntitySlots[DataToMove.SlotIndex];
+	Slot.Coords = NewCellCoords;
+	Slot.CellElement = Instance->GridCells[NewCellIndex].Entities.FindId(Entity);
 
 	return true;
 }
@@ -117,12 +160,15 @@ void ASpatialHashGrid::UpdateCellTransform(FMassEntityHandle Entity, FTransform
 {
 	FIntVector2 CellCoords = CoordsFromHandle(Entity);
 	int CellIndex = CoordsToIndex(CellCoords);
-	auto GridCell = Instance->GridCells[CellIndex];
+	HashGridCell& GridCell = Instance->GridCells[CellIndex];
 	
 	//checkf(GridCell.Entities.Contains(Entity), TEXT("SpatialHashGrid Error : Entity not in cell"));
-	if(!DebugCheckExpr(GridCell.Entities.Contains(Entity), "SpatialHashGrid Error : Entity not in cell", Instance->bUseAsserts)) return;
+	GridCellEntityData* Data = GridCell.Entities.Find(Entity);
+	if(!DebugCheckExpr(Data != nullptr, "SpatialHashGrid Error : Entity not in cell", Instance->bUseAsserts)) return;
 
-	Instance->GridCells[CellIndex].Entities[Entity].Location = Transform.GetLocation();
+	// The slot keeps its own copy so target references can read it without going through the cell
+	Data->Location = Transform.GetLocation();
+	Instance->EntitySlots[Data->SlotIndex].Location = Data->Location;
 }
 
 void ASpatialHashGrid::DamageEntity(FMassEntityHandle Entity, float Damage)
@@ -141,6 +187,7 @@ bool ASpatialHashGrid::AddBuildingToGrid(FVector WorldCoordinates, ABuildingPare
 
 	// Reference to initial Cell
 	Instance->GridCells[CellIndex].Buildings.Add(Building);
+	AcquireStaticTargetSlot(Building);
 
 	// Reference to cells in range
 	TArray<HashGridCell*> CellsInRange = FindCellsInRange(WorldCoordinates, Building->GetTargetableRange(), 360.f, Building->GetActorForwardVector(), FMassEntityHandle(0, 0));
@@ -161,6 +208,8 @@ bool ASpatialHashGrid::RemoveBuildingFromGrid(FVector WorldCoordinates, ABuildin
 	if (Instance->GridCells[CellIndex].Buildings.IsEmpty()) return false;
 
 	Instance->GridCells[CellIndex].Buildings.Remove(Building);
+	if (const int32* SlotIndex = Instance->StaticTargetToSlotMap.Find(Building))
+		ReleaseStaticTargetSlot(*SlotIndex);
 	return true;
 }
 
@@ -182,6 +231,7 @@ bool ASpatialHashGrid::AddLDElementToGrid(FVector WorldCoordinates, ALDElement*
 	}
 
 	Instance->GridCells[CellIndex].LDElements.Add(LDElement);
+	AcquireStaticTargetSlot(LDElement);
 	// GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Green, FString::Printf(TEXT("LDElement added to grid at %s"), *WorldCoordinates.ToString()));
 	return true;
 }
@@ -203,6 +253,8 @@ bool ASpatialHashGrid::RemoveLDElementFromGrid(FVector WorldCoordinates, ALDElem
 	}
 
 	Instance->GridCells[CellIndex].LDElements.Remove(LDElement);
+	if (const int32* SlotIndex = Instance->StaticTargetToSlotMap.Find(LDElement))
+		ReleaseStaticTargetSlot(*SlotIndex);
 	// GEngine->AddOnScreenDebugMessage(-1, 10.f, FColor::Green, TEXT("LDElement removed from grid"));
 	return true;
 }
@@ -248,7 +300,7 @@ bool ASpatialHashGrid::AddSoulBeaconToGrid(ASoulBeacon* SoulBeacon)
 
 bool ASpatialHashGrid::Contains(FMassEntityHandle Entity)
 {
-	return Instance->PresentEntities.Contains(Entity);
+	return Instance->HandleToSlotMap.Contains(Entity);
 }
 
 bool ASpatialHashGrid::Contains(FVector Location, TWeakObjectPtr<ABuildingParent> Building)
@@ -267,7 +319,7 @@ bool ASpatialHashGrid::Contains(FVector Location, TWeakObjectPtr<ALDElement> LDE
 
 FIntVector2 ASpatialHashGrid::CoordsFromHandle(FMassEntityHandle Entity)
 {
-	return Instance->HandleToCoordsMap[Entity];
+	return Instance->EntitySlots[Instance->HandleToSlotMap[Entity]].Coords;
 }
 
 int ASpatialHashGrid::CoordsToIndex(FIntVector2 Coords)
@@ -277,7 +329,7 @@ int ASpatialHashGrid::CoordsToIndex(FIntVector2 Coords)
 
 void ASpatialHashGrid::RefreshPresent()
 {
-	Instance->HandleToCoordsMap.GenerateKeyArray(Instance->PresentEntities);
+	Instance->HandleToSlotMap.GenerateKeyArray(Instance->PresentEntities);
 }
 
 const GridCellEntityData ASpatialHashGrid::GetEntityData(FMassEntityHandle Entity)
@@ -286,7 +338,7 @@ const GridCellEntityData ASpatialHashGrid::GetEntityData(FMassEntityHandle Entit
 	
 	//checkf(Contains(Entity), TEXT("SpatialHashGrid Error : Accessing unknown Entity"));
 
-	FIntVector2 EntityCoords = Instance->HandleToCoordsMap[Entity];
+	FIntVector2 EntityCoords = CoordsFromHandle(Entity);
 	//checkf(IsInGrid(EntityCoords), TEXT("SpatialHashGrid Error : Accessing coords out of grid"));
 	if (!IsInGrid(EntityCoords)) return GridCellEntityData::None();
 	
@@ -304,7 +356,7 @@ const GridCellEntityData ASpatialHashGrid::GetEntityData(FMassEntityHandle Entit
 
 GridCellEntityData* ASpatialHashGrid::GetMutableEntityData(FMassEntityHandle Entity)
 {
-	FIntVector2 EntityCoords = Instance->HandleToCoordsMap[Entity];
+	FIntVector2 EntityCoords = CoordsFromHandle(Entity);
 	//checkf(IsInGrid(EntityCoords), TEXT("SpatialHashGrid Error : Accessing coords out of grid"));
 	if (!DebugCheckExpr(IsInGrid(EntityCoords), "SpatialHashGrid Error : Accessing coords out of grid", Instance->bUseAsserts)) return nullptr;
 
@@ -320,6 +372,107 @@ GridCellEntityData* ASpatialHashGrid::GetMutableEntityData(FMassEntityHandle Ent
 	return ToReturn;
 }
 
+FGridTargetRef ASpatialHashGrid::GetEntityRef(FMassEntityHandle Entity)
+{
+	const int32* SlotIndex = Instance->HandleToSlotMap.Find(Entity);
+	if (!SlotIndex) return FGridTargetRef();
+
+	return FGridTargetRef(EGridTargetKind::Entity, *SlotIndex, Instance->EntitySlots[*SlotIndex].Generation);
+}
+
+bool ASpatialHashGrid::IsTargetValid(const FGridTargetRef& Target)
+{
+	switch (Target.Kind)
+	{
+	case EGridTargetKind::Entity:
+		return Instance->EntitySlots.IsValidIndex(Target.Index) && Instance->EntitySlots[Target.Index].Generation == Target.Generation;
+	case EGridTargetKind::Static:
+		return Instance->StaticTargetSlots.IsValidIndex(Target.Index) && Instance->StaticTargetSlots[Target.Index].Generation == Target.Generation;
+	default:
+		return false;
+	}
+}
+
+bool ASpatialHashGrid::GetTargetLocation(const FGridTargetRef& Target, FVector& OutLocation)
+{
+	if (!IsTargetValid(Target)) return false;
+
+	OutLocation = Target.Kind == EGridTargetKind::Entity ? Instance->EntitySlots[Target.Index].Location : Instance->StaticTargetSlots[Target.Index].Snapshot.Location;
+	return true;
+}
+
+const FGridTargetSnapshot* ASpatialHashGrid::GetStaticTargetSnapshot(const FGridTargetRef& Target)
+{
+	if (Target.Kind != EGridTargetKind::Static || !IsTargetValid(Target)) return nullptr;
+
+	return &Instance->StaticTargetSlots[Target.Index].Snapshot;
+}
+
+GridCellEntityData* ASpatialHashGrid::GetMutableEntityData(const FGridTargetRef& Target)
+{
+	if (Target.Kind != EGridTargetKind::Entity || !IsTargetValid(Target)) return nullptr;
+
+	// The slot knows where the entity sits in its cell, no hashing on the fight path
+	const FGridEntitySlot& Slot = Instance->EntitySlots[Target.Index];
+	TPair<FMassEntityHandle, GridCellEntityData>& Element = Instance->GridCells[CoordsToIndex(Slot.Coords)].Entities.Get(Slot.CellElement);
+	checkSlow(Element.Key == Slot.Entity);
+	return &Element.Value;
+}
+
+int32 ASpatialHashGrid::AcquireEntitySlot(FMassEntityHandle Entity, FIntVector2 Coords, FVector Location)
+{
+	const int32 SlotIndex = Instance->FreeEntitySlots.IsEmpty() ? Instance->EntitySlots.AddDefaulted() : Instance->FreeEntitySlots.Pop();
+
+	FGridEntitySlot& Slot = Instance->EntitySlots[SlotIndex];
+	Slot.Entity = Entity;
+	Slot.Coords = Coords;
+	Slot.Location = Location;
+
+	Instance->HandleToSlotMap.Add(Entity, SlotIndex);
+	return SlotIndex;
+}
+
+void ASpatialHashGrid::ReleaseEntitySlot(int32 SlotIndex)
+{
+	// Bumping the generation is what invalidates the references still pointing to this slot
+	FGridEntitySlot& Slot = Instance->EntitySlots[SlotIndex];
+	Slot.Entity = FMassEntityHandle();
+	Slot.CellElement = FSetElementId();
+	++Slot.Generation;
+
+	Instance->FreeEntitySlots.Add(SlotIndex);
+}
+
+int32 ASpatialHashGrid::AcquireStaticTargetSlot(AActor* Actor)
+{
+	// Buildings are added once per cell they cover, they still get a single slot
+	if (const int32* SlotIndex = Instance->StaticTargetToSlotMap.Find(Actor))
+		return *SlotIndex;
+
+	const int32 SlotIndex = Instance->FreeStaticTargetSlots.IsEmpty() ? Instance->StaticTargetSlots.AddDefaulted() : Instance->FreeStaticTargetSlots.Pop();
+
+	FGridStaticTargetSlot& Slot = Instance->StaticTargetSlots[SlotIndex];
+	Slot.Actor = Actor;
+	Slot.Snapshot = FGridTargetSnapshot();
+	Slot.bUsed = true;
+	RefreshStaticTargetSnapshot(Slot);
+
+	Instance->StaticTargetToSlotMap.Add(Actor, SlotIndex);
+	return SlotIndex;
+}
+
+void ASpatialHashGrid::ReleaseStaticTargetSlot(int32 SlotIndex)
+{
+	FGridStaticTargetSlot& Slot = Instance->StaticTargetSlots[SlotIndex];
+	Instance->StaticTargetToSlotMap.Remove(Slot.Actor);
+
+	Slot.Actor = nullptr;
+	Slot.bUsed = false;
+	++Slot.Generation;
+
+	Instance->FreeStaticTargetSlots.Add(SlotIndex);
+}
+
 bool ASpatialHashGrid::IsInGrid(FVector WorldCoordinates)
 {
 	FVector TLCellCorner = Instance->GridLocation;
@@ -550,6 +703,329 @@ FDetectionResult ASpatialHashGrid::FindClosestElementsInRange(FVector WorldCoord
 	return Result;
 }
 
+void ASpatialHashGrid::RefreshTargetSnapshots()
+{
+	check(IsInGameThread());
+
+	for (FGridStaticTargetSlot& Slot : Instance->StaticTargetSlots)
+	{
+		if (!Slot.bUsed) continue;
+
+		// Destroyed without being removed from the grid, references to it must fail from now on
+		if (!Slot.Actor.IsValid())
+		{
+			ReleaseStaticTargetSlot(&Slot - Instance->StaticTargetSlots.GetData());
+			continue;
+		}
+
+		RefreshStaticTargetSnapshot(Slot);
+	}
+}
+
+void ASpatialHashGrid::RefreshCoarseSummaries(int32 BlockSize)
+{
+	check(IsInGameThread());
+
+	BlockSize = FMath::Max(1, BlockSize);
+	const FIntVector2 Size = Instance->GridSize;
+	const FIntVector2 CoarseSize((Size.X + BlockSize - 1) / BlockSize, (Size.Y + BlockSize - 1) / BlockSize);
+
+	Instance->CoarseBlockSize = BlockSize;
+	Instance->CoarseGridSize = CoarseSize;
+	Instance->CoarseCells.SetNum(CoarseSize.X * CoarseSize.Y);
+	for (FGridCoarseCell& CoarseCell : Instance->CoarseCells)
+	{
+		CoarseCell.Reset();
+	}
+
+	for (int32 Y = 0; Y < Size.Y; ++Y)
+	{
+		for (int32 X = 0; X < Size.X; ++X)
+		{
+			const HashGridCell& Cell = Instance->GridCells[X + Size.X * Y];
+			if (Cell.Entities.IsEmpty()) continue;
+
+			FGridCoarseCell& CoarseCell = Instance->CoarseCells[X / BlockSize + CoarseSize.X * (Y / BlockSize)];
+			for (const TPair<FMassEntityHandle, GridCellEntityData>& Pair : Cell.Entities)
+			{
+				const ETeam Team = Pair.Value.Owner.Team;
+				FGridCoarseSummary* Summary = CoarseCell.FindByPredicate([Team](const FGridCoarseSummary& Other) { return Other.Team == Team; });
+				if (!Summary)
+				{
+					Summary = &CoarseCell.AddDefaulted_GetRef();
+					Summary->Team = Team;
+				}
+
+				const FVector2D Location(Pair.Value.Location.X, Pair.Value.Location.Y);
+				++Summary->Count;
+				Summary->LocationSum += Location;
+				Summary->SquaredLengthSum += Location.SizeSquared();
+			}
+		}
+	}
+}
+
+const FGridCoarseCell* ASpatialHashGrid::GetCoarseCell(FIntPoint BlockCoords)
+{
+	const FIntVector2 CoarseSize = Instance->CoarseGridSize;
+	if (BlockCoords.X < 0 || BlockCoords.Y < 0 || BlockCoords.X >= CoarseSize.X || BlockCoords.Y >= CoarseSize.Y) return nullptr;
+
+	return &Instance->CoarseCells[BlockCoords.X + CoarseSize.X * BlockCoords.Y];
+}
+
+void ASpatialHashGrid::RefreshStaticTargetSnapshot(FGridStaticTargetSlot& Slot)
+{
+	FGridTargetSnapshot& Snapshot = Slot.Snapshot;
+	Snapshot.Location = Slot.Actor->GetActorLocation();
+
+	if (ABuildingParent* Building = Cast<ABuildingParent>(Slot.Actor.Get()))
+	{
+		Snapshot.TargetableRange = Building->GetTargetableRange();
+		Snapshot.Team = Building->GetOwner().Team;
+		Snapshot.bHasTeam = true;
+	}
+	else if (ALDElement* LD = Cast<ALDElement>(Slot.Actor.Get()))
+	{
+		if (LD->GetLDElementType() == ELDElementType::LDElementNeutralCampType)
+			Snapshot.TargetableRange = Cast<ANeutralCamp>(LD)->GetTargetableRange();
+
+		// Soul beacons can be captured, neutral camps stay without a team
+		if (IOwnable* Ownable = Cast<IOwnable>(LD))
+		{
+			Snapshot.Team = Ownable->GetOwner().Team;
+			Snapshot.bHasTeam = true;
+		}
+	}
+}
+
+bool ASpatialHashGrid::IsStaticTargetHostileTo(const TWeakObjectPtr<AActor>& Actor, ETeam Team)
+{
+	// Removed targets have no slot anymore
+	const int32* SlotIndex = Instance->StaticTargetToSlotMap.Find(Actor);
+	if (!SlotIndex) return false;
+
+	return Instance->StaticTargetSlots[*SlotIndex].Snapshot.IsHostileTo(Team);
+}
+
+FDetectionResult ASpatialHashGrid::FindClosestElementsInRangeThreadSafe(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, ETeam CallerTeam)
+{
+	FDetectionResult Result;
+	if (!IsInGrid(WorldCoordinates)) return Result;
+
+	const FVector DetectionCenter = WorldCoordinates;
+	const FVector Forward = EntityForwardVector.GetSafeNormal();
+	const int DetectionRangeX = Range / Instance->CellSize.X;
+	const int DetectionRangeY = Range / Instance->CellSize.Y;
+
+	const FIntVector2 GridCoords = WorldToGridCoords(WorldCoordinates);
+
+	// Same angle test as FindClosestElementsInRange, without the acos
+	const float CosAngle = FMath::Cos(FMath::DegreesToRadians(Angle));
+	auto IsInCone = [&](const FVector& TargetLocation)
+	{
+		if (Angle >= 180.f) return true;
+		return FVector::DotProduct((TargetLocation - DetectionCenter).GetSafeNormal(), Forward) > CosAngle;
+	};
+
+	for (int x = -DetectionRangeX; x <= DetectionRangeX; ++x)
+	{
+		for (int y = -DetectionRangeY; y <= DetectionRangeY; ++y)
+		{
+			const int Index = (GridCoords.X + x) + ((GridCoords.Y + y) * Instance->GridSize.X);
+			if (Index < 0 || Index >= Instance->GridCells.Num())
+				continue;
+
+			const HashGridCell& Cell = Instance->GridCells[Index];
+
+			for (const TPair<FMassEntityHandle, GridCellEntityData>& Pair : Cell.Entities)
+			{
+				const GridCellEntityData& Data = Pair.Value;
+				if (CallerTeam == Data.Owner.Team) continue;
+				if (!IsInCone(Data.Location)) continue;
+
+				const float Distance = (Data.Location - DetectionCenter).Length() - Data.TargetableRadius;
+				if (Distance > Range || Distance > Result.EntityDistance) continue;
+
+				Result.EntityDistance = Distance;
+				Result.Entity = Pair.Key;
+				Result.EntityRef = FGridTargetRef(EGridTargetKind::Entity, Data.SlotIndex, Instance->EntitySlots[Data.SlotIndex].Generation);
+			}
+
+			for (const TWeakObjectPtr<ABuildingParent>& Building : Cell.Buildings)
+			{
+				// Removed buildings have no slot anymore
+				const int32* SlotIndex = Instance->StaticTargetToSlotMap.Find(Building);
+				if (!SlotIndex) continue;
+
+				const FGridStaticTargetSlot& Slot = Instance->StaticTargetSlots[*SlotIndex];
+				const FGridTargetSnapshot& Snapshot = Slot.Snapshot;
+				if (!Snapshot.IsHostileTo(CallerTeam)) continue;
+				if (!IsInCone(Snapshot.Location)) continue;
+
+				const float Distance = (Snapshot.Location - DetectionCenter).Length() - Snapshot.TargetableRange;
+				if (Distance > Range || Distance > Result.BuildingDistance) continue;
+
+				Result.BuildingDistance = Distance;
+				Result.Building = Building;
+				Result.BuildingRef = FGridTargetRef(EGridTargetKind::Static, *SlotIndex, Slot.Generation);
+			}
+
+			for (const TWeakObjectPtr<ALDElement>& LD : Cell.LDElements)
+			{
+				const int32* SlotIndex = Instance->StaticTargetToSlotMap.Find(LD);
+				if (!SlotIndex) continue;
+
+				const FGridStaticTargetSlot& Slot = Instance->StaticTargetSlots[*SlotIndex];
+				const FGridTargetSnapshot& Snapshot = Slot.Snapshot;
+				if (!Snapshot.IsHostileTo(CallerTeam)) continue;
+				if (!IsInCone(Snapshot.Location)) continue;
+
+				const float Distance = (Snapshot.Location - DetectionCenter).Length() - Snapshot.TargetableRange;
+				if (Distance > Range || Distance > Result.LDDistance) continue;
+
+				Result.LDDistance = Distance;
+				Result.LD = LD;
+				Result.LDRef = FGridTargetRef(EGridTargetKind::Static, *SlotIndex, Slot.Generation);
+			}
+		}
+	}
+
+	return Result;
+}
+
+void ASpatialHashGrid::GatherTargetCandidatesThreadSafe(FVector WorldCoordinates, float Range, ETeam CallerTeam, TArray<FGridTargetCandidate>& OutCandidates)
+{
+	OutCandidates.Reset();
+	if (!IsInGrid(WorldCoordinates)) return;
+
+	// A member's own window is its cell offset plus the truncated detection range, both fit in the rounded up range plus one cell
+	const FIntVector2 GridCoords = WorldToGridCoords(WorldCoordinates);
+	const int32 RangeX = FMath::CeilToInt(Range / Instance->CellSize.X) + 1;
+	const int32 RangeY = FMath::CeilToInt(Range / Instance->CellSize.Y) + 1;
+
+	// Buildings and LD elements can cover several cells, maps their slot to their candidate
+	TMap<int32, int32, TInlineSetAllocator<16>> SeenStaticSlots;
+
+	// Returns null if the target was already gathered or can't be aggroed from here
+	auto AddStaticTarget = [&](const TWeakObjectPtr<AActor>& Actor, const FIntVector2& Coords) -> FGridTargetCandidate*
+	{
+		const int32* SlotIndex = Instance->StaticTargetToSlotMap.Find(Actor);
+		if (!SlotIndex) return nullptr;
+
+		if (const int32* CandidateIndex = SeenStaticSlots.Find(*SlotIndex))
+		{
+			if (*CandidateIndex == INDEX_NONE) return nullptr;
+
+			FGridTargetCandidate& Candidate = OutCandidates[*CandidateIndex];
+			Candidate.MinCoords = FIntVector2(FMath::Min(Candidate.MinCoords.X, Coords.X), FMath::Min(Candidate.MinCoords.Y, Coords.Y));
+			Candidate.MaxCoords = FIntVector2(FMath::Max(Candidate.MaxCoords.X, Coords.X), FMath::Max(Candidate.MaxCoords.Y, Coords.Y));
+			return nullptr;
+		}
+
+		const FGridStaticTargetSlot& Slot = Instance->StaticTargetSlots[*SlotIndex];
+		const FGridTargetSnapshot& Snapshot = Slot.Snapshot;
+		if (!Snapshot.IsHostileTo(CallerTeam) || (Snapshot.Location - WorldCoordinates).Length() - Snapshot.TargetableRange > Range)
+		{
+			SeenStaticSlots.Add(*SlotIndex, INDEX_NONE);
+			return nullptr;
+		}
+
+		SeenStaticSlots.Add(*SlotIndex, OutCandidates.Num());
+		FGridTargetCandidate& Candidate = OutCandidates.AddDefaulted_GetRef();
+		Candidate.Ref = FGridTargetRef(EGridTargetKind::Static, *SlotIndex, Slot.Generation);
+		Candidate.Location = Snapshot.Location;
+		Candidate.TargetableRange = Snapshot.TargetableRange;
+		Candidate.MinCoords = Coords;
+		Candidate.MaxCoords = Coords;
+		return &Candidate;
+	};
+
+	for (int x = FMath::Max(GridCoords.X - RangeX, 0); x <= FMath::Min(GridCoords.X + RangeX, Instance->GridSize.X - 1); ++x)
+	{
+		for (int y = FMath::Max(GridCoords.Y - RangeY, 0); y <= FMath::Min(GridCoords.Y + RangeY, Instance->GridSize.Y - 1); ++y)
+		{
+			const FIntVector2 Coords(x, y);
+			const HashGridCell& Cell = Instance->GridCells[CoordsToIndex(Coords)];
+
+			for (const TPair<FMassEntityHandle, GridCellEntityData>& Pair : Cell.Entities)
+			{
+				const GridCellEntityData& Data = Pair.Value;
+				if (CallerTeam == Data.Owner.Team) continue;
+				if ((Data.Location - WorldCoordinates).Length() - Data.TargetableRadius > Range) continue;
+
+				FGridTargetCandidate& Candidate = OutCandidates.AddDefaulted_GetRef();
+				Candidate.Ref = FGridTargetRef(EGridTargetKind::Entity, Data.SlotIndex, Instance->EntitySlots[Data.SlotIndex].Generation);
+				Candidate.Entity = Pair.Key;
+				Candidate.Location = Data.Location;
+				Candidate.TargetableRange = Data.TargetableRadius;
+				Candidate.MinCoords = Coords;
+				Candidate.MaxCoords = Coords;
+			}
+
+			for (const TWeakObjectPtr<ABuildingParent>& Building : Cell.Buildings)
+			{
+				if (FGridTargetCandidate* Candidate = AddStaticTarget(Building, Coords))
+					Candidate->Building = Building;
+			}
+
+			for (const TWeakObjectPtr<ALDElement>& LD : Cell.LDElements)
+			{
+				if (FGridTargetCandidate* Candidate = AddStaticTarget(LD, Coords))
+					Candidate->LD = LD;
+			}
+		}
+	}
+}
+
+FDetectionResult ASpatialHashGrid::FindClosestElementsInCandidates(TConstArrayView<FGridTargetCandidate> Candidates, FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector)
+{
+	FDetectionResult Result;
+	if (!IsInGrid(WorldCoordinates)) return Result;
+
+	const FVector Forward = EntityForwardVector.GetSafeNormal();
+	const float CosAngle = FMath::Cos(FMath::DegreesToRadians(Angle));
+
+	// The candidates were gathered around the squad, keep those found in a cell the per entity query would have scanned from here
+	const FIntVector2 GridCoords = WorldToGridCoords(WorldCoordinates);
+	const int DetectionRangeX = Range / Instance->CellSize.X;
+	const int DetectionRangeY = Range / Instance->CellSize.Y;
+
+	for (const FGridTargetCandidate& Candidate : Candidates)
+	{
+		if (Candidate.MaxCoords.X < GridCoords.X - DetectionRangeX || Candidate.MinCoords.X > GridCoords.X + DetectionRangeX) continue;
+		if (Candidate.MaxCoords.Y < GridCoords.Y - DetectionRangeY || Candidate.MinCoords.Y > GridCoords.Y + DetectionRangeY) continue;
+
+		if (Angle < 180.f && FVector::DotProduct((Candidate.Location - WorldCoordinates).GetSafeNormal(), Forward) <= CosAngle) continue;
+
+		const float Distance = (Candidate.Location - WorldCoordinates).Length() - Candidate.TargetableRange;
+		if (Distance > Range) continue;
+
+		if (Candidate.Ref.Kind == EGridTargetKind::Entity)
+		{
+			if (Distance > Result.EntityDistance) continue;
+			Result.EntityDistance = Distance;
+			Result.Entity = Candidate.Entity;
+			Result.EntityRef = Candidate.Ref;
+		}
+		else if (!Candidate.Building.IsExplicitlyNull())
+		{
+			if (Distance > Result.BuildingDistance) continue;
+			Result.BuildingDistance = Distance;
+			Result.Building = Candidate.Building;
+			Result.BuildingRef = Candidate.Ref;
+		}
+		else
+		{
+			if (Distance > Result.LDDistance) continue;
+			Result.LDDistance = Distance;
+			Result.LD = Candidate.LD;
+			Result.LDRef = Candidate.Ref;
+		}
+	}
+
+	return Result;
+}
+
 /*
 * Returns an array of entites gathered from cells up to a Range distance from the center cell
 * @param WorldCoordinates Position of the entity in the center cell
@@ -775,6 +1251,39 @@ TMap<FMassEntityHandle, GridCellEntityData> ASpatialHashGrid::FindEntitiesAround
 	return FoundEntities;
 }
 
+/*
+* Cheap conservative check used to wake dead reckoned amalgams up, doesn't allocate nor touch UObjects.
+* Buildings and LD elements are filtered on the team cached in their snapshot, LD elements without an owner always count.
+*/
+bool ASpatialHashGrid::HasPotentialTargetsAround(FVector WorldCoordinates, float Range, ETeam Team)
+{
+	if (!IsInGrid(WorldCoordinates)) return true;
+
+	const FIntVector2 GridCoords = WorldToGridCoords(WorldCoordinates);
+	const int32 RangeX = FMath::CeilToInt(Range / Instance->CellSize.X);
+	const int32 RangeY = FMath::CeilToInt(Range / Instance->CellSize.Y);
+
+	for (int x = FMath::Max(GridCoords.X - RangeX, 0); x <= FMath::Min(GridCoords.X + RangeX, Instance->GridSize.X - 1); ++x)
+	{
+		for (int y = FMath::Max(GridCoords.Y - RangeY, 0); y <= FMath::Min(GridCoords.Y + RangeY, Instance->GridSize.Y - 1); ++y)
+		{
+			const HashGridCell& Cell = Instance->GridCells[CoordsToIndex(FIntVector2(x, y))];
+			if (Cell.HasEnemyEntitiesFor(Team)) return true;
+
+			for (const TWeakObjectPtr<ABuildingParent>& Building : Cell.Buildings)
+			{
+				if (IsStaticTargetHostileTo(Building, Team)) return true;
+			}
+			for (const TWeakObjectPtr<ALDElement>& LD : Cell.LDElements)
+			{
+				if (IsStaticTargetHostileTo(LD, Team)) return true;
+			}
+		}
+	}
+
+	return false;
+}
+
 FMassEntityHandle ASpatialHashGrid::FindClosestEntity(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, FMassEntityHandle Entity, ETeam Team)
 {
 	TMap<FMassEntityHandle, GridCellEntityData> FoundEntities = Instance->FindEntitiesInRange(WorldCoordinates, Range, Angle, EntityForwardVector, Entity);
@@ -1210,6 +1719,16 @@ int HashGridCell::GetTotalNumByTeam(FOwner Owner)
 	return NumEntities + NumBuildings;
 }
 
+bool HashGridCell::HasEnemyEntitiesFor(ETeam Team) const
+{
+	for (const FOwner& Owner : PresentOwners)
+	{
+		if (Owner.Team != Team) return true;
+	}
+
+	return false;
+}
+
 int HashGridCell::GetTotalNumByTeamDifference(FOwner Owner)
 {
 	return GetTotalNum() - GetTotalNumByTeam(Owner);
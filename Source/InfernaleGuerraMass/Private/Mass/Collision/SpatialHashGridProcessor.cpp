@@ -37,6 +37,7 @@ void USpatialHashGridProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FAmalgamTargetFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamTransmutationFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddSharedRequirement<FAmalgamTransmutationSharedFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAmalgamOwnerFragment>(EMassFragmentAccess::ReadWrite);
 	
 	EntityQuery.AddTagRequirement<FAmalgamInitializeTag>(EMassFragmentPresence::None);
@@ -57,6 +58,7 @@ void USpatialHashGridProcessor::Execute(FMassEntityManager& EntityManager, FMass
 			TArrayView<FAmalgamTargetFragment> TargetFragView = Context.GetMutableFragmentView<FAmalgamTargetFragment>();
 			TArrayView<FAmalgamStateFragment> StateFragView = Context.GetMutableFragmentView<FAmalgamStateFragment>();
 			TArrayView<FAmalgamTransmutationFragment> TransmFragView = Context.GetMutableFragmentView<FAmalgamTransmutationFragment>();
+			const FAmalgamTransmutationSharedFragment& Transmutation = Context.GetSharedFragment<FAmalgamTransmutationSharedFragment>();
 			TArrayView<FAmalgamOwnerFragment> OwnerFragView = Context.GetMutableFragmentView<FAmalgamOwnerFragment>();
 
 			const float WorldDeltaTime = Context.GetDeltaTimeSeconds();
@@ -74,13 +76,14 @@ void USpatialHashGridProcessor::Execute(FMassEntityManager& EntityManager, FMass
 				GridCellEntityData* GridEntityData = ASpatialHashGrid::GetMutableEntityData(EntityHandle);
 				if (!GridEntityData) continue;
 
-				if (TransmutationFragment.WasUpdated())
+				const FAmalgamTransmutationMultipliers& Multipliers = Transmutation.GetMultipliers(OwnerFragView[Index].GetOwner());
+				if (TransmutationFragment.WasUpdated(Multipliers))
 				{
-					float NewMax = TransmutationFragment.GetHealthModifier(GridEntityData->MaxEntityHealth);
+					float NewMax = Multipliers.GetHealthModifier(GridEntityData->MaxEntityHealth);
 					GridEntityData->EntityHealth = (GridEntityData->EntityHealth / GridEntityData->MaxEntityHealth) * NewMax;
 					GridEntityData->MaxEntityHealth = NewMax;
 
-					TransmutationFragment.Update();
+					TransmutationFragment.Update(Multipliers);
 				}
 
 				if (GridEntityData->EntityHealth <= 0.f) 
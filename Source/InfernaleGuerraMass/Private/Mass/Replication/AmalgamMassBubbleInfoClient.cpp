@@ -9,6 +9,9 @@
 
 // Infernale Guerra Includes
 #include "Net/Serialization/FastArraySerializer.h"
+#include "GameFramework/PlayerController.h"
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Replication/AmalgamViewReportComponent.h"
 
 #if UE_REPLICATION_COMPILE_SERVER_CODE
 
@@ -31,10 +34,56 @@ void FAmalgamMassClientBubbleHandler::MarkItemDirty(FAmalgamMassFastArrayItem& I
 
 #if UE_REPLICATION_COMPILE_CLIENT_CODE
 
+FAmalgamMassClientBubbleHandler::FClientPathContext FAmalgamMassClientBubbleHandler::GetClientPathContext() const
+{
+	FClientPathContext PathContext;
+	UWorld* World = Serializer ? Serializer->GetWorld() : nullptr;
+	UAmalgamSimulationSubsystem* SimulationSubsystem = World ? World->GetSubsystem<UAmalgamSimulationSubsystem>() : nullptr;
+	if (!SimulationSubsystem || !SimulationSubsystem->UsesClientPathSimulation()) return PathContext;
+
+	PathContext.FluxPathCache = &SimulationSubsystem->GetFluxPathCache();
+	PathContext.ViewReport = UAmalgamViewReportComponent::FindOrAdd(World->GetFirstPlayerController());
+	return PathContext;
+}
+
+/*
+* Amalgams on a path are moved by UAmalgamClientMoveProcessor when the local bake of the flux matches the server one.
+* Returns false if the client can't simulate the path, the amalgam then follows the replicated location
+*/
+static bool ApplyReplicatedPath(const FAmalgamReplicatedAgent& Agent, FAmalgamClientPathFragment& PathFragment, const FAmalgamMassClientBubbleHandler::FClientPathContext& PathContext)
+{
+	if (!Agent.IsOnPath())
+	{
+		PathFragment.Stop();
+		return false;
+	}
+
+	AFlux* Flux = Agent.GetPathFlux();
+	PathFragment.Start(Flux, Agent.GetPathUpdateID(), Agent.GetPathUpdateVersion(), Agent.GetPathStartDistance(), Agent.GetPathStartTime(), Agent.GetPathSpeed(), Agent.GetVisualHandle());
+	if (!Flux || !PathContext.FluxPathCache) return false;
+
+	// Baked on first sight so the server can stop sending the location right away
+	const TSharedPtr<const FAmalgamFluxPathLUT>* FluxPath = PathContext.FluxPathCache->Find(FObjectKey(Flux));
+	if (!FluxPath)
+	{
+		PathContext.FluxPathCache->Register(Flux);
+		FluxPath = PathContext.FluxPathCache->Find(FObjectKey(Flux));
+	}
+	if (!FluxPath || !FluxPath->IsValid() || !PathFragment.MatchesPath(**FluxPath)) return false;
+
+	// The server sends the location until the bake is confirmed, see UAmalgamMassReplicator
+	if (PathContext.ViewReport)
+		PathContext.ViewReport->ConfirmFluxPath(Flux, **FluxPath);
+	return true;
+}
+
 void FAmalgamMassClientBubbleHandler::PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize)
 {
 	TArrayView<FTransformFragment> TransformFragments;
 	TArrayView<FAmalgamStateFragment> StateFragments;
+	TArrayView<FAmalgamDirectionFragment> DirectionFragments;
+	TArrayView<FAmalgamClientPathFragment> PathFragments;
+	const FClientPathContext PathContext = GetClientPathContext();
 	
 	// Add the requirements for the query used to grab all the transform fragments
 	auto AddRequirementsForSpawnQuery = [this](FMassEntityQuery& InQuery)
@@ -48,6 +97,8 @@ void FAmalgamMassClientBubbleHandler::PostReplicatedAdd(const TArrayView<int32>
 		{
 			TransformFragments = InExecContext.GetMutableFragmentView<FTransformFragment>();
 			StateFragments = InExecContext.GetMutableFragmentView<FAmalgamStateFragment>();
+			DirectionFragments = InExecContext.GetMutableFragmentView<FAmalgamDirectionFragment>();
+			PathFragments = InExecContext.GetMutableFragmentView<FAmalgamClientPathFragment>();
 		};
 
 	// Called when a new entity is spawned. Stores the entity location in the transform fragment
@@ -60,11 +111,18 @@ void FAmalgamMassClientBubbleHandler::PostReplicatedAdd(const TArrayView<int32>
 
 			StateFragments[EntityIdx].SetState(ReplicatedEntity.GetEntityState());
 			StateFragments[EntityIdx].SetAggro(ReplicatedEntity.GetEntityAggro());
+
+			// Optional on clients
+			if (DirectionFragments.Num() > 0)
+				DirectionFragments[EntityIdx].Direction = ReplicatedEntity.GetEntityDirection();
+
+			if (PathFragments.Num() > 0)
+				ApplyReplicatedPath(ReplicatedEntity, PathFragments[EntityIdx], PathContext);
 		};
 
-	auto PostReplicatedChange = [this](const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item)
+	auto PostReplicatedChange = [this, &PathContext](const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item)
 		{
-			PostReplicatedChangeEntity(EntityView, Item);
+			PostReplicatedChangeEntity(EntityView, Item, PathContext);
 		};
 
 	// PostReplicatedChangeEntity is called when there are multiples adds without a remove so it's treated as a change
@@ -73,28 +131,39 @@ void FAmalgamMassClientBubbleHandler::PostReplicatedAdd(const TArrayView<int32>
 
 void FAmalgamMassClientBubbleHandler::PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize)
 {
-	PostReplicatedChangeHelper(ChangedIndices, [this](const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item)
+	const FClientPathContext PathContext = GetClientPathContext();
+	PostReplicatedChangeHelper(ChangedIndices, [this, &PathContext](const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item)
 		{
-			PostReplicatedChangeEntity(EntityView, Item);
+			PostReplicatedChangeEntity(EntityView, Item, PathContext);
 		});
 }
 
-void FAmalgamMassClientBubbleHandler::PostReplicatedChangeEntity(const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item) const
+void FAmalgamMassClientBubbleHandler::PostReplicatedChangeEntity(const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item, const FClientPathContext& PathContext) const
 {
 	// Grabs the transform fragment from the entity
 	FTransformFragment& TransformFragment = EntityView.GetFragmentData<FTransformFragment>();
-	FAmalgamStateFragment StateFragment = EntityView.GetFragmentData<FAmalgamStateFragment>();
+	FAmalgamStateFragment& StateFragment = EntityView.GetFragmentData<FAmalgamStateFragment>();
 
-	// Sets the transform location with the agent location
-	TransformFragment.GetMutableTransform().SetLocation(Item.GetEntityLocation());
 	StateFragment.SetState(Item.GetEntityState());
 	StateFragment.SetAggro(Item.GetEntityAggro());
+
+	// A state change resends the location the path started from, the move processor owns the transform of simulated amalgams
+	FAmalgamClientPathFragment* PathFragment = EntityView.GetFragmentDataPtr<FAmalgamClientPathFragment>();
+	if (PathFragment && ApplyReplicatedPath(Item, *PathFragment, PathContext)) return;
+
+	// Sets the transform location with the agent location
+	TransformFragment.GetMutableTransform().SetLocation(Item.GetEntityLocation());
+
+	if (FAmalgamDirectionFragment* DirectionFragment = EntityView.GetFragmentDataPtr<FAmalgamDirectionFragment>())
+		DirectionFragment->Direction = Item.GetEntityDirection();
 }
 
 void FAmalgamMassClientBubbleHandler::AddQueryRequirements(FMassEntityQuery& InQuery) const
 {
 	InQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
 	InQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadWrite);
+	InQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	InQuery.AddRequirement<FAmalgamClientPathFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
 	//InQuery.AddTagRequirement<FAmalgamInitializeTag>(EMassFragmentPresence::None);
 }
 
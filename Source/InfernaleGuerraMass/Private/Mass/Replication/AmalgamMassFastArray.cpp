@@ -1,4 +1,100 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 
-#include "Mass/Replication/AmalgamMassFastArray.h"
\ No newline at end of file
+#include "Mass/Replication/AmalgamMassFastArray.h"
+
+#include "Mass/Replication/AmalgamUnitStream.h"
+
+FVector FAmalgamReplicatedAgent::GetEntityDirection() const
+{
+	return FVector(FAmalgamStreamQuantizer::DequantizeYaw(EntityHeading), 0.f);
+}
+
+void FAmalgamReplicatedAgent::SetEntityDirection(const FVector& InDirection)
+{
+	EntityHeading = FAmalgamStreamQuantizer::QuantizeYaw(InDirection.X, InDirection.Y);
+}
+
+void FAmalgamReplicatedAgent::SetPath(AFlux* InFlux, uint32 InUpdateID, uint32 InUpdateVersion, float InStartDistance, float InStartTime, float InSpeed, uint64 InVisualHandle)
+{
+	bOnPath = true;
+	PathFlux = InFlux;
+	PathUpdateID = InUpdateID;
+	PathUpdateVersion = InUpdateVersion;
+	PathStartDistance = InStartDistance;
+	PathStartTime = InStartTime;
+	PathSpeed = InSpeed;
+	VisualHandle = InVisualHandle;
+}
+
+bool FAmalgamReplicatedAgent::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = true;
+
+	// Replaces the default serializer, so the base agent data has to be sent here too. The client maps agents to entities with it
+	uint32 NetIDValue = Ar.IsSaving() ? GetNetID().GetValue() : 0;
+	Ar.SerializeIntPacked(NetIDValue);
+	if (Ar.IsLoading())
+		SetNetID(FMassNetworkID(NetIDValue));
+
+	// Same encoding as the unit stream. The sender tags the bounds it used, the receiver only decodes with identical ones
+	FAmalgamStreamQuantizer Quantizer;
+	uint8 bQuantized = Ar.IsSaving() ? Quantizer.InitFromGrid() : 0;
+	Ar.SerializeBits(&bQuantized, 1);
+
+	if (bQuantized)
+	{
+		uint8 BoundsTag = Quantizer.GetBoundsTag();
+		uint16 X = 0, Y = 0;
+		if (Ar.IsSaving())
+			Quantizer.QuantizeLocation(EntityLocation.X, EntityLocation.Y, X, Y);
+		Ar << BoundsTag << X << Y;
+
+		if (Ar.IsLoading())
+		{
+			if (Quantizer.InitFromGrid() && Quantizer.GetBoundsTag() == BoundsTag)
+			{
+				EntityLocation = FVector(Quantizer.DequantizeLocation(X, Y), 0.);
+			}
+			else
+			{
+				// The bits are still read so the rest of the bunch stays aligned, the location is kept until an update can be decoded
+				ensureMsgf(false, TEXT("FAmalgamReplicatedAgent : Quantized location received with grid bounds the client doesn't have"));
+				UE_LOG(LogTemp, Warning, TEXT("FAmalgamReplicatedAgent : Dropped the location of agent %u, grid bounds mismatch"), NetIDValue);
+			}
+		}
+	}
+	else
+	{
+		EntityLocation.NetSerialize(Ar, Map, bOutSuccess);
+	}
+
+	// Both enums have less than 16 values
+	uint8 StateAndAggro = Ar.IsSaving() ? (((uint8)EntityState & 0x0F) | ((uint8)EntityAggro << 4)) : 0;
+	Ar << StateAndAggro;
+	if (Ar.IsLoading())
+	{
+		EntityState = (EAmalgamState)(StateAndAggro & 0x0F);
+		EntityAggro = (EAmalgamAggro)(StateAndAggro >> 4);
+	}
+
+	Ar << EntityHeading;
+
+	// Sent with every update of an amalgam on a path. The replicator only changes it when the amalgam starts a path,
+	// changes speed or drifts from what the client predicts, state changes resend the same descriptor
+	uint8 bHasPath = bOnPath;
+	Ar.SerializeBits(&bHasPath, 1);
+	bOnPath = bHasPath != 0;
+	if (bOnPath)
+	{
+		UObject* Flux = PathFlux.Get();
+		bOutSuccess &= Map ? Map->SerializeObject(Ar, AFlux::StaticClass(), Flux) : false;
+		PathFlux = Cast<AFlux>(Flux);
+
+		Ar.SerializeIntPacked(PathUpdateID);
+		Ar.SerializeIntPacked(PathUpdateVersion);
+		Ar << PathStartDistance << PathStartTime << PathSpeed << VisualHandle;
+	}
+
+	return bOutSuccess;
+}
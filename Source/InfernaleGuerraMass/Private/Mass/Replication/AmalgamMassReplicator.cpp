@@ -5,16 +5,23 @@
 
 // UE Includes
 #include "MassCommonFragments.h"
+#include "GameFramework/GameStateBase.h"
 
 // InfernaleGuerra Includes
 #include "Mass/Replication/AmalgamMassBubbleInfoClient.h"
 #include "Mass/Replication/AmalgamMassFastArray.h"
 #include "Mass/Army/AmalgamFragments.h"
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "DataAssets/AmalgamReplicationLODAsset.h"
 
 void UAmalgamMassReplicator::AddRequirements(FMassEntityQuery& EntityQuery)
 {
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FAmalgamStateFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FAmalgamDirectionFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamDeadReckoningFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamPathfindingFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAmalgamFluxFragment>(EMassFragmentAccess::ReadOnly);
 }
 
 void UAmalgamMassReplicator::ProcessClientReplication(FMassExecutionContext& Context, FMassReplicationContext& ReplicationContext)
@@ -25,12 +32,62 @@ void UAmalgamMassReplicator::ProcessClientReplication(FMassExecutionContext& Con
 	FMassReplicationSharedFragment* RepSharedFrag = nullptr;
 	TConstArrayView<FTransformFragment> TransformFragments;
 	TConstArrayView<FAmalgamStateFragment> StateFragments;
+	TConstArrayView<FAmalgamDirectionFragment> DirectionFragments;
+	TConstArrayView<FAmalgamDeadReckoningFragment> DeadReckoningFragments;
+	TConstArrayView<FAmalgamPathfindingFragment> PathFragments;
+	TConstArrayView<FAmalgamFluxFragment> FluxFragments;
 	TArrayView<FMassReplicatedAgentFragment> AgentFragments;
+	bool bChunkOnPath = false;
+
+	const UAmalgamReplicationLODAsset* LODSettingsAsset = GetLODAsset();
+	const FAmalgamReplicationLODSettings DefaultLODSettings;
+
+	// Dead reckoned amalgams are simulated by the clients, see UAmalgamClientMoveProcessor
+	UAmalgamSimulationSubsystem* SimulationSubsystem = ReplicationContext.World.GetSubsystem<UAmalgamSimulationSubsystem>();
+	const bool bUseClientPaths = SimulationSubsystem && SimulationSubsystem->UsesClientPathSimulation();
+	const float CorrectionThreshold = bUseClientPaths ? SimulationSubsystem->GetClientPathCorrectionThreshold() : 0.f;
+	const double SimulationTime = bUseClientPaths ? SimulationSubsystem->GetSimulationClock().GetSimulationTime() : 0.;
+
+	// Clients only know the server time through the game state
+	const AGameStateBase* GameState = ReplicationContext.World.GetGameState();
+	const float ServerTime = GameState ? GameState->GetServerWorldTimeSeconds() : ReplicationContext.World.GetTimeSeconds();
+
+	// Returns true if the path held by the agent changed
+	auto UpdatePath = [&](FMassExecutionContext& InContext, const int32 EntityIdx, FAmalgamReplicatedAgent& Agent)
+		{
+			const TSharedPtr<const FAmalgamFluxPathLUT>& PathLUT = PathFragments[EntityIdx].GetPathLUT();
+			AFlux* Flux = FluxFragments[EntityIdx].GetFlux().Get();
+
+			// Clients bake their own path from the flux, so only the current path of a flux can be simulated there
+			const TSharedPtr<const FAmalgamFluxPathLUT>* FluxPath = bChunkOnPath && Flux && PathLUT.IsValid()
+				? SimulationSubsystem->GetFluxPathCache().Find(FluxFragments[EntityIdx].GetFluxKey()) : nullptr;
+			if (!FluxPath || *FluxPath != PathLUT)
+			{
+				if (!Agent.IsOnPath()) return false;
+				Agent.ClearPath();
+				return true;
+			}
+
+			const float Distance = DeadReckoningFragments[EntityIdx].GetDistance(SimulationTime);
+			const float Speed = DeadReckoningFragments[EntityIdx].GetSpeed();
+			if (Agent.IsOnPath() && Agent.GetPathFlux() == Flux && Agent.GetPathSpeed() == Speed
+				&& Agent.GetPathUpdateID() == PathLUT->UpdateID && Agent.GetPathUpdateVersion() == PathLUT->UpdateVersion
+				&& FMath::Abs(Agent.PredictPathDistance(ServerTime) - Distance) <= CorrectionThreshold)
+				return false;
+
+			Agent.SetPath(Flux, PathLUT->UpdateID, PathLUT->UpdateVersion, Distance, ServerTime, Speed, InContext.GetEntity(EntityIdx).AsNumber());
+			return true;
+		};
 
 	auto CacheViewsCallback = [&](FMassExecutionContext& InContext)
 		{
 			TransformFragments = InContext.GetFragmentView<FTransformFragment>();
 			StateFragments = InContext.GetFragmentView<FAmalgamStateFragment>();
+			DirectionFragments = InContext.GetFragmentView<FAmalgamDirectionFragment>();
+			DeadReckoningFragments = InContext.GetFragmentView<FAmalgamDeadReckoningFragment>();
+			PathFragments = InContext.GetFragmentView<FAmalgamPathfindingFragment>();
+			FluxFragments = InContext.GetFragmentView<FAmalgamFluxFragment>();
+			bChunkOnPath = bUseClientPaths && InContext.DoesArchetypeHaveTag<FAmalgamDeadReckoningTag>();
 			AgentFragments = InContext.GetMutableFragmentView<FMassReplicatedAgentFragment>();
 			RepSharedFrag = &InContext.GetMutableSharedFragment<FMassReplicationSharedFragment>();
 		};
@@ -44,6 +101,9 @@ void UAmalgamMassReplicator::ProcessClientReplication(FMassExecutionContext& Con
 			InReplicatedAgent.SetEntityLocation(TransformFragments[EntityIdx].GetTransform().GetLocation());
 			InReplicatedAgent.SetEntityState(StateFragments[EntityIdx].GetState());
 			InReplicatedAgent.SetEntityAggro(StateFragments[EntityIdx].GetAggro());
+			InReplicatedAgent.SetEntityDirection(DirectionFragments[EntityIdx].Direction);
+			// The client only takes over once it confirmed its bake, see ModifyEntityCallback
+			UpdatePath(InContext, EntityIdx, InReplicatedAgent);
 
 			// Adds the new agent in the client bubble
 			FAmalgamMassClientBubbleHandler* ClientHandler = static_cast<FAmalgamMassClientBubbleHandler*>(BubbleInfo.GetBubbleSerializer().GetClientHandler());
@@ -64,13 +124,47 @@ void UAmalgamMassReplicator::ProcessClientReplication(FMassExecutionContext& Con
 			bool bMarkItemDirty = false;
 
 			const FVector& EntityLocation = TransformFragments[EntityIdx].GetTransform().GetLocation();
-			constexpr float LocationTolerance = 10.0f;
-			if (!FVector::PointsAreNear(EntityLocation, Item->Agent.GetEntityLocation(), LocationTolerance))
+			const FAmalgamStateFragment& StateFragment = StateFragments[EntityIdx];
+
+			// Far amalgams are sent less often and with a coarser tolerance
+			const FAmalgamReplicationLODSettings& LODSettings = LODSettingsAsset ? LODSettingsAsset->GetSettings(LOD) : DefaultLODSettings;
+			const bool bPathChanged = UpdatePath(InContext, EntityIdx, Item->Agent);
+
+			// Clients whose bake of the flux differs can't simulate the path, they keep receiving the location until they confirm a matching one
+			const bool bClientSimulatesPath = Item->Agent.IsOnPath()
+				&& SimulationSubsystem->HasClientFluxPath(BubbleInfo.GetOwner(), FluxFragments[EntityIdx].GetFluxKey(), *PathFragments[EntityIdx].GetPathLUT());
+			if (bClientSimulatesPath != Item->bClientSimulatesPath)
+			{
+				Item->bClientSimulatesPath = bClientSimulatesPath;
+				SimulationSubsystem->SetClientPathEntity(BubbleInfo.GetOwner(), InContext.GetEntity(EntityIdx), bClientSimulatesPath);
+			}
+
+			if (bPathChanged)
+			{
+				// Starting or leaving a path, the client snaps to the real location either way
+				Item->Agent.SetEntityLocation(EntityLocation);
+				Item->Agent.SetEntityDirection(DirectionFragments[EntityIdx].Direction);
+				Item->LastLocationUpdateTime = Time;
+				bMarkItemDirty = true;
+			}
+			// The client moves amalgams on a confirmed path itself
+			else if (!bClientSimulatesPath
+				&& !FVector::PointsAreNear(EntityLocation, Item->Agent.GetEntityLocation(), LODSettings.LocationTolerance)
+				&& Time - Item->LastLocationUpdateTime >= LODSettings.UpdateInterval
+				&& ConsumeBudget(ClientHandle, LOD, LODSettings.UpdateBudgetPerSecond, Time))
 			{
 				// Only updates the agent position if the transform fragment location has changed
 				Item->Agent.SetEntityLocation(EntityLocation);
-				Item->Agent.SetEntityState(StateFragments[EntityIdx].GetState());
-				Item->Agent.SetEntityAggro(StateFragments[EntityIdx].GetAggro());
+				Item->Agent.SetEntityDirection(DirectionFragments[EntityIdx].Direction);
+				Item->LastLocationUpdateTime = Time;
+				bMarkItemDirty = true;
+			}
+
+			// State and aggro share a byte with the location, cheap enough to send on their own at any LOD
+			if (StateFragment.GetState() != Item->Agent.GetEntityState() || StateFragment.GetAggro() != Item->Agent.GetEntityAggro())
+			{
+				Item->Agent.SetEntityState(StateFragment.GetState());
+				Item->Agent.SetEntityAggro(StateFragment.GetAggro());
 				bMarkItemDirty = true;
 			}
 
@@ -87,6 +181,11 @@ void UAmalgamMassReplicator::ProcessClientReplication(FMassExecutionContext& Con
 			AAmalgamMassClientBubbleInfo& BubbleInfo = RepSharedFrag->GetTypedClientBubbleInfoChecked<AAmalgamMassClientBubbleInfo>(ClientHandle);
 			FAmalgamMassClientBubbleHandler* Bubble = static_cast<FAmalgamMassClientBubbleHandler*>(BubbleInfo.GetBubbleSerializer().GetClientHandler());
 
+			// The visual handle is the entity handle, see UpdatePath
+			const FAmalgamMassFastArrayItem* Item = Bubble->GetMutableItem(Handle);
+			if (Item && Item->bClientSimulatesPath)
+				SimulationSubsystem->SetClientPathEntity(BubbleInfo.GetOwner(), FMassEntityHandle::FromNumber(Item->Agent.GetVisualHandle()), false);
+
 			// Remove the entity agent from the bubble
 			Bubble->RemoveAgent(Handle);
 		};
@@ -94,3 +193,33 @@ void UAmalgamMassReplicator::ProcessClientReplication(FMassExecutionContext& Con
 	CalculateClientReplication<FAmalgamMassFastArrayItem>(Context, ReplicationContext, CacheViewsCallback, AddEntityCallback, ModifyEntityCallback, RemoveEntityCallback);
 #endif // UE_REPLICATION_COMPILE_SERVER_CODE
 }
+
+const UAmalgamReplicationLODAsset* UAmalgamMassReplicator::GetLODAsset()
+{
+	if (!bLODAssetLoaded)
+	{
+		LODAsset = GetDefault<UAmalgamSimulationSubsystem>()->GetReplicationLODAsset();
+		bLODAssetLoaded = true;
+	}
+	return LODAsset;
+}
+
+bool UAmalgamMassReplicator::ConsumeBudget(const FMassClientHandle ClientHandle, const EMassLOD::Type LOD, const int32 BudgetPerSecond, const double Time)
+{
+	if (BudgetPerSecond <= 0 || LOD >= EMassLOD::Max) return true;
+
+	const int32 ClientIndex = ClientHandle.GetIndex();
+	if (ClientIndex >= ClientBudgets.Num())
+		ClientBudgets.SetNum(ClientIndex + 1);
+
+	// Starts full, and never saves more than one second of updates
+	FLODBudget& Budget = ClientBudgets[ClientIndex][LOD];
+	const float Elapsed = Budget.LastRefillTime < 0. ? 1.f : (float)(Time - Budget.LastRefillTime);
+	Budget.Tokens = FMath::Min(Budget.Tokens + Elapsed * BudgetPerSecond, (float)BudgetPerSecond);
+	Budget.LastRefillTime = Time;
+
+	if (Budget.Tokens < 1.f) return false;
+
+	Budget.Tokens -= 1.f;
+	return true;
+}
@@ -0,0 +1,399 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Replication/AmalgamUnitStream.h"
+
+#include "Mass/Collision/SpatialHashGrid.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+namespace
+{
+	const FAmalgamStreamUnit EmptyUnit;
+	const FAmalgamStreamSnapshot EmptySnapshot;
+
+	// Stream ids are sent as packed deltas, this only bounds what a corrupted packet can allocate
+	constexpr int32 MaxStreamId = MAX_uint16;
+
+	// Worst case sizes, a packed value below MaxStreamId takes up to 3 bytes
+	constexpr int32 HeaderBytes = 32;
+	constexpr int32 RemovedBytes = 3;
+	constexpr int32 AddedBytes = 3 + 8 + 2 + 2 + 1;
+	constexpr int32 ChangedBytes = 3 + 3 + 3 + 1;
+
+	const FAmalgamStreamUnit& GetUnit(const FAmalgamStreamSnapshot& Snapshot, int32 Id)
+	{
+		return Snapshot.IsValidIndex(Id) ? Snapshot[Id] : EmptyUnit;
+	}
+
+	bool IsSameSnapshot(const FAmalgamStreamSnapshot& A, const FAmalgamStreamSnapshot& B)
+	{
+		const int32 Num = FMath::Max(A.Num(), B.Num());
+		for (int32 Id = 0; Id < Num; ++Id)
+		{
+			if (!GetUnit(A, Id).SameState(GetUnit(B, Id))) return false;
+		}
+		return true;
+	}
+
+	uint32 ZigZag(int32 Value) { return (uint32)((Value << 1) ^ (Value >> 31)); }
+	int32 UnZigZag(uint32 Value) { return (int32)(Value >> 1) ^ -(int32)(Value & 1); }
+
+	void WriteId(FBitWriter& Writer, int32 Id, int32& PreviousId)
+	{
+		uint32 Delta = Id - PreviousId;
+		Writer.SerializeIntPacked(Delta);
+		PreviousId = Id;
+	}
+
+	bool ReadId(FBitReader& Reader, int32& PreviousId)
+	{
+		uint32 Delta = 0;
+		Reader.SerializeIntPacked(Delta);
+
+		// Checked before the addition so a corrupted delta can't wrap the id below zero
+		if (Reader.IsError() || PreviousId < 0 || Delta > (uint32)(MaxStreamId - PreviousId))
+		{
+			Reader.SetError();
+			return false;
+		}
+
+		PreviousId += Delta;
+		return true;
+	}
+}
+
+bool FAmalgamStreamQuantizer::InitFromGrid()
+{
+	if (!ASpatialHashGrid::IsValid()) return false;
+
+	const FVector GridLocation = ASpatialHashGrid::GetGridLocation();
+	const FIntVector2 GridSize = ASpatialHashGrid::GetGridSize();
+	const FIntVector2 CellSize = ASpatialHashGrid::GetCellSize();
+	Origin = FVector2D(GridLocation.X, GridLocation.Y);
+	Extent = FVector2D(FMath::Max(1, GridSize.X * CellSize.X), FMath::Max(1, GridSize.Y * CellSize.Y));
+	return true;
+}
+
+uint8 FAmalgamStreamQuantizer::GetBoundsTag() const
+{
+	const uint32 Hash = HashCombine(GetTypeHash(Origin), GetTypeHash(Extent));
+	return (uint8)(Hash ^ (Hash >> 8) ^ (Hash >> 16) ^ (Hash >> 24));
+}
+
+void FAmalgamStreamQuantizer::Quantize(const FDataForVisualisation& Data, FAmalgamStreamUnit& OutUnit) const
+{
+	QuantizeLocation(Data.LocationX, Data.LocationY, OutUnit.X, OutUnit.Y);
+	OutUnit.Yaw = QuantizeYaw(Data.RotationX, Data.RotationY);
+}
+
+void FAmalgamStreamQuantizer::Dequantize(const FAmalgamStreamUnit& Unit, FDataForVisualisation& OutData) const
+{
+	OutData.EntityHandle = FMassEntityHandle::FromNumber(Unit.Handle);
+
+	const FVector2D Location = DequantizeLocation(Unit.X, Unit.Y);
+	OutData.LocationX = Location.X;
+	OutData.LocationY = Location.Y;
+
+	const FVector2D Direction = DequantizeYaw(Unit.Yaw);
+	OutData.RotationX = Direction.X;
+	OutData.RotationY = Direction.Y;
+}
+
+void FAmalgamStreamQuantizer::QuantizeLocation(double X, double Y, uint16& OutX, uint16& OutY) const
+{
+	OutX = (uint16)FMath::RoundToInt(FMath::Clamp((X - Origin.X) / Extent.X, 0., 1.) * MAX_uint16);
+	OutY = (uint16)FMath::RoundToInt(FMath::Clamp((Y - Origin.Y) / Extent.Y, 0., 1.) * MAX_uint16);
+}
+
+FVector2D FAmalgamStreamQuantizer::DequantizeLocation(uint16 X, uint16 Y) const
+{
+	return FVector2D(Origin.X + X / (double)MAX_uint16 * Extent.X, Origin.Y + Y / (double)MAX_uint16 * Extent.Y);
+}
+
+uint8 FAmalgamStreamQuantizer::QuantizeYaw(double DirectionX, double DirectionY)
+{
+	const double Angle = FMath::Atan2(DirectionY, DirectionX);
+	return (uint8)(FMath::RoundToInt(Angle / UE_TWO_PI * 256.) & 0xFF);
+}
+
+FVector2D FAmalgamStreamQuantizer::DequantizeYaw(uint8 Yaw)
+{
+	const double Angle = Yaw / 256. * UE_TWO_PI;
+	return FVector2D(FMath::Cos(Angle), FMath::Sin(Angle));
+}
+
+const FAmalgamStreamSnapshot* FAmalgamStreamHistory::Find(uint32 Frame) const
+{
+	const int32 Index = Frame % Size;
+	return Frame != 0 && Frames[Index] == Frame ? &Snapshots[Index] : nullptr;
+}
+
+void FAmalgamStreamHistory::Store(uint32 Frame, const FAmalgamStreamSnapshot& Snapshot)
+{
+	const int32 Index = Frame % Size;
+	Frames[Index] = Frame;
+	Snapshots[Index] = Snapshot;
+}
+
+void FAmalgamUnitStreamEncoder::Apply(const FAmalgamStreamQuantizer& Quantizer, TConstArrayView<FDataForVisualisation> Shown, TConstArrayView<FMassEntityHandle> Hidden, TConstArrayView<FMassEntityHandle> Removed)
+{
+	for (const FMassEntityHandle& Entity : Hidden)
+	{
+		ReleaseId(Entity.AsNumber());
+	}
+	for (const FMassEntityHandle& Entity : Removed)
+	{
+		ReleaseId(Entity.AsNumber());
+	}
+
+	for (const FDataForVisualisation& Data : Shown)
+	{
+		const uint64 Handle = Data.EntityHandle.AsNumber();
+		const int32 Id = AcquireId(Handle);
+		if (Id == INDEX_NONE) continue;
+
+		Quantizer.Quantize(Data, Current[Id]);
+		Current[Id].Handle = Handle;
+	}
+}
+
+bool FAmalgamUnitStreamEncoder::Encode(const FAmalgamStreamQuantizer& Quantizer, const FAmalgamUnitStreamSettings& Settings, TArray<uint8>& OutData, int32& OutNumBits)
+{
+	const FAmalgamStreamSnapshot* Base = History.Find(AckedFrame);
+	if (Base && IsSameSnapshot(*Base, Current)) return false;
+
+	const int32 Budget = FMath::Max(Settings.MaxPacketBytes, HeaderBytes + AddedBytes);
+
+	uint32 Frame = NextFrame++;
+	// A periodic keyframe resends every unit and waits until they fit in a single frame,
+	// so beyond (MaxPacketBytes - HeaderBytes) / AddedBytes units (62 at 1024 bytes) only the initial and recovery keyframes are sent
+	const bool bKeyframeDue = Frame - LastKeyframe >= (uint32)FMath::Max(1, Settings.KeyframeInterval);
+	const bool bKeyframe = !Base || (bKeyframeDue && HeaderBytes + HandleToId.Num() * AddedBytes <= Budget);
+	const FAmalgamStreamSnapshot& From = bKeyframe ? EmptySnapshot : *Base;
+
+	// What the client will have once it applies this frame, units over budget keep their state from the base
+	FAmalgamStreamSnapshot Sent = From;
+	Sent.SetNum(FMath::Max(From.Num(), Current.Num()));
+	const int32 Num = Sent.Num();
+	int32 Bytes = HeaderBytes;
+
+	TArray<int32> Removed, Added, Changed;
+	for (int32 Id = 0; Id < Num && Bytes + RemovedBytes <= Budget; ++Id)
+	{
+		// A recycled id is sent as a removal followed by an addition
+		const FAmalgamStreamUnit& Old = GetUnit(From, Id);
+		if (!Old.IsSet() || Old.Handle == GetUnit(Current, Id).Handle) continue;
+
+		Removed.Add(Id);
+		Sent[Id] = FAmalgamStreamUnit();
+		Bytes += RemovedBytes;
+	}
+
+	for (int32 Id = 0; Id < Num && Bytes + AddedBytes <= Budget; ++Id)
+	{
+		const FAmalgamStreamUnit& New = GetUnit(Current, Id);
+		if (!New.IsSet() || Sent[Id].IsSet()) continue;
+
+		Added.Add(Id);
+		Sent[Id] = New;
+		Bytes += AddedBytes;
+	}
+
+	// Frames encoded against the same base start from the same id so they mostly send the same units. When removals or additions
+	// take a different share of the budget, a unit sent by the previous frame can be left out and show its base state until the next ack.
+	// The next base carries on from where this one stopped, so the first ids can't starve the others
+	const int32 FirstChangeId = bKeyframe ? 0 : ChangeCursors[AckedFrame % FAmalgamStreamHistory::Size];
+	int32 Step = 0;
+	for (; Step < Num && Bytes + ChangedBytes <= Budget; ++Step)
+	{
+		const int32 Id = (FirstChangeId + Step) % Num;
+		const FAmalgamStreamUnit& New = GetUnit(Current, Id);
+		if (!New.IsSet() || Sent[Id].Handle != New.Handle || Sent[Id].SameState(New)) continue;
+
+		Changed.Add(Id);
+		Sent[Id] = New;
+		Bytes += ChangedBytes;
+	}
+	Changed.Sort();
+
+	FBitWriter Writer(Bytes * 8, true);
+	Writer << Frame;
+	Writer.WriteBit(bKeyframe ? 1 : 0);
+	if (bKeyframe)
+	{
+		float OriginX = Quantizer.Origin.X, OriginY = Quantizer.Origin.Y;
+		float ExtentX = Quantizer.Extent.X, ExtentY = Quantizer.Extent.Y;
+		Writer << OriginX << OriginY << ExtentX << ExtentY;
+	}
+	else
+	{
+		uint32 BaseFrame = AckedFrame;
+		Writer << BaseFrame;
+	}
+
+	uint32 Count = Removed.Num();
+	Writer.SerializeIntPacked(Count);
+	int32 PreviousId = 0;
+	for (const int32 Id : Removed)
+	{
+		WriteId(Writer, Id, PreviousId);
+	}
+
+	Count = Added.Num();
+	Writer.SerializeIntPacked(Count);
+	PreviousId = 0;
+	for (const int32 Id : Added)
+	{
+		FAmalgamStreamUnit Unit = Current[Id];
+		WriteId(Writer, Id, PreviousId);
+		Writer << Unit.Handle << Unit.X << Unit.Y << Unit.Yaw;
+	}
+
+	Count = Changed.Num();
+	Writer.SerializeIntPacked(Count);
+	PreviousId = 0;
+	for (const int32 Id : Changed)
+	{
+		FAmalgamStreamUnit Unit = Current[Id];
+		uint32 DeltaX = ZigZag((int32)Unit.X - (int32)From[Id].X);
+		uint32 DeltaY = ZigZag((int32)Unit.Y - (int32)From[Id].Y);
+		WriteId(Writer, Id, PreviousId);
+		Writer.SerializeIntPacked(DeltaX);
+		Writer.SerializeIntPacked(DeltaY);
+		Writer << Unit.Yaw;
+	}
+
+	History.Store(Frame, Sent);
+	ChangeCursors[Frame % FAmalgamStreamHistory::Size] = Num > 0 ? (FirstChangeId + Step) % Num : 0;
+	if (bKeyframe) LastKeyframe = Frame;
+
+	OutData = *Writer.GetBuffer();
+	OutNumBits = Writer.GetNumBits();
+	return true;
+}
+
+void FAmalgamUnitStreamEncoder::Ack(uint32 Frame)
+{
+	// Acks are unreliable too, an older one can arrive after a newer one
+	if (Frame > AckedFrame && Frame < NextFrame)
+		AckedFrame = Frame;
+}
+
+int32 FAmalgamUnitStreamEncoder::AcquireId(uint64 Handle)
+{
+	if (const int32* Id = HandleToId.Find(Handle)) return *Id;
+
+	int32 Id;
+	if (FreeIds.Num() > 0)
+	{
+		Id = FreeIds.Pop();
+	}
+	else
+	{
+		if (Current.Num() > MaxStreamId) return INDEX_NONE;
+		Id = Current.AddDefaulted();
+	}
+
+	HandleToId.Add(Handle, Id);
+	return Id;
+}
+
+void FAmalgamUnitStreamEncoder::ReleaseId(uint64 Handle)
+{
+	int32 Id;
+	if (!HandleToId.RemoveAndCopyValue(Handle, Id)) return;
+
+	Current[Id] = FAmalgamStreamUnit();
+	FreeIds.Add(Id);
+}
+
+bool FAmalgamUnitStreamDecoder::Decode(const TArray<uint8>& Data, int32 NumBits, uint32& OutFrame, TArray<FDataForVisualisation>& OutShown, TArray<FMassEntityHandle>& OutHidden)
+{
+	if (NumBits <= 0 || NumBits > Data.Num() * 8) return false;
+
+	FBitReader Reader(const_cast<uint8*>(Data.GetData()), NumBits);
+
+	uint32 Frame = 0;
+	Reader << Frame;
+	const bool bKeyframe = Reader.ReadBit() != 0;
+	if (Reader.IsError() || Frame <= LastAppliedFrame) return false;
+
+	FAmalgamStreamSnapshot Snapshot;
+	FAmalgamStreamQuantizer FrameQuantizer = Quantizer;
+	if (bKeyframe)
+	{
+		float OriginX = 0.f, OriginY = 0.f, ExtentX = 1.f, ExtentY = 1.f;
+		Reader << OriginX << OriginY << ExtentX << ExtentY;
+		FrameQuantizer.Origin = FVector2D(OriginX, OriginY);
+		FrameQuantizer.Extent = FVector2D(ExtentX, ExtentY);
+	}
+	else
+	{
+		uint32 BaseFrame = 0;
+		Reader << BaseFrame;
+		const FAmalgamStreamSnapshot* Base = bHasKeyframe ? History.Find(BaseFrame) : nullptr;
+		if (!Base) return false;
+		Snapshot = *Base;
+	}
+
+	uint32 Count = 0;
+	Reader.SerializeIntPacked(Count);
+	int32 Id = 0;
+	for (uint32 Index = 0; Index < Count; ++Index)
+	{
+		if (!ReadId(Reader, Id)) return false;
+		if (Snapshot.IsValidIndex(Id)) Snapshot[Id] = FAmalgamStreamUnit();
+	}
+
+	Reader.SerializeIntPacked(Count);
+	Id = 0;
+	for (uint32 Index = 0; Index < Count; ++Index)
+	{
+		if (!ReadId(Reader, Id)) return false;
+		if (Id >= Snapshot.Num()) Snapshot.SetNum(Id + 1);
+
+		FAmalgamStreamUnit& Unit = Snapshot[Id];
+		Reader << Unit.Handle << Unit.X << Unit.Y << Unit.Yaw;
+	}
+
+	Reader.SerializeIntPacked(Count);
+	Id = 0;
+	for (uint32 Index = 0; Index < Count; ++Index)
+	{
+		if (!ReadId(Reader, Id) || !Snapshot.IsValidIndex(Id)) return false;
+
+		uint32 DeltaX = 0, DeltaY = 0;
+		FAmalgamStreamUnit& Unit = Snapshot[Id];
+		Reader.SerializeIntPacked(DeltaX);
+		Reader.SerializeIntPacked(DeltaY);
+		Reader << Unit.Yaw;
+		Unit.X = (uint16)((int32)Unit.X + UnZigZag(DeltaX));
+		Unit.Y = (uint16)((int32)Unit.Y + UnZigZag(DeltaY));
+	}
+
+	if (Reader.IsError()) return false;
+
+	// What changes on screen is relative to the last frame applied, not to the base of the delta
+	const int32 Num = FMath::Max(LastApplied.Num(), Snapshot.Num());
+	for (Id = 0; Id < Num; ++Id)
+	{
+		const FAmalgamStreamUnit& Old = GetUnit(LastApplied, Id);
+		const FAmalgamStreamUnit& New = GetUnit(Snapshot, Id);
+
+		if (Old.IsSet() && Old.Handle != New.Handle)
+			OutHidden.Add(FMassEntityHandle::FromNumber(Old.Handle));
+
+		if (New.IsSet() && !Old.SameState(New))
+			FrameQuantizer.Dequantize(New, OutShown.AddDefaulted_GetRef());
+	}
+
+	History.Store(Frame, Snapshot);
+	LastApplied = MoveTemp(Snapshot);
+	LastAppliedFrame = Frame;
+	Quantizer = FrameQuantizer;
+	bHasKeyframe |= bKeyframe;
+
+	OutFrame = Frame;
+	return true;
+}
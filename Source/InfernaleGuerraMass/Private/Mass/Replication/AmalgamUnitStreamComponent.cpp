@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Replication/AmalgamUnitStreamComponent.h"
+
+#include "GameFramework/PlayerController.h"
+#include "Manager/AmalgamVisualisationManager.h"
+#include <Kismet/GameplayStatics.h>
+
+UAmalgamUnitStreamComponent::UAmalgamUnitStreamComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+UAmalgamUnitStreamComponent* UAmalgamUnitStreamComponent::FindOrAdd(APlayerController* PlayerController)
+{
+	if (!PlayerController) return nullptr;
+
+	if (UAmalgamUnitStreamComponent* Existing = PlayerController->FindComponentByClass<UAmalgamUnitStreamComponent>())
+		return Existing;
+
+	if (!PlayerController->HasAuthority()) return nullptr;
+
+	// Replicated to the owning client, which receives the packets on its own copy
+	UAmalgamUnitStreamComponent* Component = NewObject<UAmalgamUnitStreamComponent>(PlayerController);
+	Component->RegisterComponent();
+	return Component;
+}
+
+void UAmalgamUnitStreamComponent::SendUpdates(const FAmalgamStreamQuantizer& Quantizer, const FAmalgamUnitStreamSettings& Settings, TConstArrayView<FDataForVisualisation> InShown, TConstArrayView<FMassEntityHandle> InHidden, TConstArrayView<FMassEntityHandle> Removed)
+{
+	Encoder.Apply(Quantizer, InShown, InHidden, Removed);
+
+	int32 NumBits = 0;
+	if (!Encoder.Encode(Quantizer, Settings, PacketData, NumBits)) return;
+
+	ClientReceiveUnits(PacketData, NumBits);
+}
+
+void UAmalgamUnitStreamComponent::ClientReceiveUnits_Implementation(const TArray<uint8>& Data, int32 NumBits)
+{
+	Shown.Reset();
+	Hidden.Reset();
+
+	uint32 Frame = 0;
+	if (!Decoder.Decode(Data, NumBits, Frame, Shown, Hidden)) return;
+
+	ServerAckUnits(Frame);
+
+	AAmalgamVisualisationManager* Manager = GetVisualisationManager();
+	if (!Manager) return;
+
+	if (Shown.Num() > 0 || Hidden.Num() > 0)
+		Manager->UpdatePositionOfSpecificUnits(Shown, Hidden);
+}
+
+void UAmalgamUnitStreamComponent::ServerAckUnits_Implementation(int32 Frame)
+{
+	Encoder.Ack((uint32)Frame);
+}
+
+AAmalgamVisualisationManager* UAmalgamUnitStreamComponent::GetVisualisationManager()
+{
+	if (VisualisationManager.IsValid()) return VisualisationManager.Get();
+
+	AActor* Actor = UGameplayStatics::GetActorOfClass(GetWorld(), AAmalgamVisualisationManager::StaticClass());
+	if (!Actor)
+	{
+		GEngine->AddOnScreenDebugMessage(-1, 2.5f, FColor::Red, TEXT("AmalgamUnitStreamComponent : Unable to find AmalgamVisualisationManager, dropping unit updates."));
+		return nullptr;
+	}
+
+	VisualisationManager = static_cast<AAmalgamVisualisationManager*>(Actor);
+	return VisualisationManager.Get();
+}
@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Replication/AmalgamViewReportComponent.h"
+
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+#include "Mass/Amalgam/Subsystems/AmalgamSimulationSubsystem.h"
+#include "Mass/Amalgam/Data/AmalgamFluxPathLUT.h"
+#include "Flux/Flux.h"
+#include "Manager/AmalgamVisualisationManager.h"
+#include <Kismet/GameplayStatics.h>
+
+UAmalgamViewReportComponent::UAmalgamViewReportComponent()
+{
+	// Only ticks on the owning client, see BeginPlay
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	SetIsReplicatedByDefault(true);
+}
+
+UAmalgamViewReportComponent* UAmalgamViewReportComponent::FindOrAdd(APlayerController* PlayerController)
+{
+	if (!PlayerController) return nullptr;
+
+	if (UAmalgamViewReportComponent* Existing = PlayerController->FindComponentByClass<UAmalgamViewReportComponent>())
+		return Existing;
+
+	if (!PlayerController->HasAuthority()) return nullptr;
+
+	UAmalgamViewReportComponent* Component = NewObject<UAmalgamViewReportComponent>(PlayerController);
+	Component->RegisterComponent();
+	return Component;
+}
+
+const FAmalgamViewReport* UAmalgamViewReportComponent::GetReport(float MaxAge) const
+{
+	if (ReportTime < 0.f || GetWorld()->GetTimeSeconds() - ReportTime > MaxAge) return nullptr;
+	return &Report;
+}
+
+void UAmalgamViewReportComponent::SendImpostors(const TArray<FAmalgamImpostor>& Impostors, const TSet<FIntPoint>& Blocks)
+{
+	ImpostorBlocks = Blocks;
+
+	if (Impostors.Num() > 0)
+	{
+		bHasSentImpostors = true;
+		ClientReceiveImpostors(Impostors);
+		return;
+	}
+
+	// Nothing replaces a lost clear, so it is the only reliable call
+	if (!bHasSentImpostors) return;
+	bHasSentImpostors = false;
+	ClientClearImpostors();
+}
+
+void UAmalgamViewReportComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const APlayerController* PlayerController = Cast<APlayerController>(GetOwner());
+	if (!PlayerController || !PlayerController->IsLocalController()) return;
+
+	// Also added for client path simulation alone, see UAmalgamPresentationProcessor
+	if (!GetDefault<UAmalgamSimulationSubsystem>()->UsesViewReports()) return;
+
+	SetComponentTickInterval(GetDefault<UAmalgamSimulationSubsystem>()->GetViewReportInterval());
+	SetComponentTickEnabled(true);
+}
+
+void UAmalgamViewReportComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	FAmalgamViewReport NewReport;
+	if (BuildReport(NewReport))
+		ServerReportView(NewReport);
+}
+
+void UAmalgamViewReportComponent::ServerReportView_Implementation(const FAmalgamViewReport& InReport)
+{
+	Report = InReport;
+	ReportTime = GetWorld()->GetTimeSeconds();
+}
+
+void UAmalgamViewReportComponent::ConfirmFluxPath(AFlux* Flux, const FAmalgamFluxPathLUT& PathLUT)
+{
+	if (!Flux) return;
+
+	const TPair<uint32, uint32> Bake(PathLUT.UpdateID, PathLUT.UpdateVersion);
+	const TPair<uint32, uint32>* Confirmed = ConfirmedFluxPaths.Find(FObjectKey(Flux));
+	if (Confirmed && *Confirmed == Bake) return;
+
+	ConfirmedFluxPaths.Add(FObjectKey(Flux), Bake);
+	ServerConfirmFluxPath(Flux, Bake.Key, Bake.Value);
+}
+
+void UAmalgamViewReportComponent::ServerConfirmFluxPath_Implementation(AFlux* Flux, uint32 UpdateID, uint32 UpdateVersion)
+{
+	if (UAmalgamSimulationSubsystem* SimulationSubsystem = GetWorld()->GetSubsystem<UAmalgamSimulationSubsystem>())
+		SimulationSubsystem->ConfirmClientFluxPath(GetOwner(), Flux, UpdateID, UpdateVersion);
+}
+
+void UAmalgamViewReportComponent::ClientReceiveImpostors_Implementation(const TArray<FAmalgamImpostor>& Impostors)
+{
+	AAmalgamVisualisationManager* Manager = GetVisualisationManager();
+	if (!Manager) return;
+
+	Manager->UpdateImpostors(Impostors);
+}
+
+void UAmalgamViewReportComponent::ClientClearImpostors_Implementation()
+{
+	AAmalgamVisualisationManager* Manager = GetVisualisationManager();
+	if (!Manager) return;
+
+	Manager->UpdateImpostors({});
+}
+
+bool UAmalgamViewReportComponent::BuildReport(FAmalgamViewReport& OutReport) const
+{
+	const APlayerController* PlayerController = Cast<APlayerController>(GetOwner());
+	if (!PlayerController || !PlayerController->PlayerCameraManager) return false;
+
+	int32 SizeX, SizeY;
+	PlayerController->GetViewportSize(SizeX, SizeY);
+	if (SizeX <= 0 || SizeY <= 0) return false;
+
+	// Rays above the horizon never reach the ground, they are cut at this distance
+	const float MaxDistance = GetDefault<UAmalgamSimulationSubsystem>()->GetViewReportMaxDistance();
+
+	const FVector2D ScreenCorners[4] = { FVector2D(0.f, 0.f), FVector2D(SizeX, 0.f), FVector2D(SizeX, SizeY), FVector2D(0.f, SizeY) };
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		FVector RayOrigin, RayDirection;
+		if (!PlayerController->DeprojectScreenPositionToWorld(ScreenCorners[Index].X, ScreenCorners[Index].Y, RayOrigin, RayDirection)) return false;
+
+		// Amalgams walk on the Z = 0 plane
+		float Distance = MaxDistance;
+		if (RayDirection.Z < -UE_KINDA_SMALL_NUMBER)
+			Distance = FMath::Min(-RayOrigin.Z / RayDirection.Z, MaxDistance);
+
+		const FVector Hit = RayOrigin + RayDirection * Distance;
+		OutReport.Corners[Index] = FVector2D(Hit.X, Hit.Y);
+	}
+
+	OutReport.CameraLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+	const float HalfFOV = FMath::DegreesToRadians(PlayerController->PlayerCameraManager->GetFOVAngle() * .5f);
+	OutReport.FocalLength = SizeX / (2.f * FMath::Tan(FMath::Max(HalfFOV, UE_KINDA_SMALL_NUMBER)));
+	return true;
+}
+
+AAmalgamVisualisationManager* UAmalgamViewReportComponent::GetVisualisationManager()
+{
+	if (VisualisationManager.IsValid()) return VisualisationManager.Get();
+
+	AActor* Actor = UGameplayStatics::GetActorOfClass(GetWorld(), AAmalgamVisualisationManager::StaticClass());
+	if (!Actor) return nullptr;
+
+	VisualisationManager = static_cast<AAmalgamVisualisationManager*>(Actor);
+	return VisualisationManager.Get();
+}
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "MassLODTypes.h"
+#include "AmalgamReplicationLODAsset.generated.h"
+
+/*
+ * How often an amalgam is sent to a client at one replication LOD. Defaults are the behaviour without an asset
+ */
+USTRUCT(BlueprintType)
+struct FAmalgamReplicationLODSettings
+{
+	GENERATED_BODY()
+
+	FAmalgamReplicationLODSettings() = default;
+	FAmalgamReplicationLODSettings(float InLocationTolerance, float InUpdateInterval)
+		: LocationTolerance(InLocationTolerance), UpdateInterval(InUpdateInterval) {}
+
+	// Distance the amalgam has to move before it is sent again
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float LocationTolerance = 10.f;
+
+	// Minimum seconds between two location updates of the same amalgam
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float UpdateInterval = 0.f;
+
+	// Location updates per client and second at this LOD, the others wait for the next pass. 0 is unlimited
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	int32 UpdateBudgetPerSecond = 0;
+};
+
+/**
+ * Replication thresholds of UAmalgamMassReplicator per replication LOD.
+ * The LOD distances themselves come from the replication trait of the amalgam entity config.
+ * State and aggro changes ignore these limits.
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamReplicationLODAsset : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+public:
+	const FAmalgamReplicationLODSettings& GetSettings(EMassLOD::Type LOD) const;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "LOD")
+	FAmalgamReplicationLODSettings High;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "LOD")
+	FAmalgamReplicationLODSettings Medium = FAmalgamReplicationLODSettings(50.f, .25f);
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "LOD")
+	FAmalgamReplicationLODSettings Low = FAmalgamReplicationLODSettings(200.f, 1.f);
+};
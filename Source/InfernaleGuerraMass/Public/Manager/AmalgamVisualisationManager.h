@@ -21,7 +21,142 @@
 #include "AmalgamVisualisationManager.generated.h"
 
 struct FDataForVisualisation;
+struct FAmalgamImpostor;
 enum class EEntityType : uint8;
+class UAmalgamSimulationSubsystem;
+
+struct FVisualSample
+{
+	FVector Location = FVector::ZeroVector;
+	FQuat Rotation = FQuat::Identity;
+	float Time = 0.f;
+};
+
+/*
+ * Last two simulation states received for a visual element,
+ * rendered in between when the simulation runs at a fixed timestep.
+ * In buffered mode, keeps the last updates with their arrival time instead and is sampled in the past
+ */
+USTRUCT()
+struct FVisualInterpolationState
+{
+	GENERATED_USTRUCT_BODY()
+
+	static constexpr int32 MaxSamples = 4;
+
+	FVector PreviousLocation = FVector::ZeroVector;
+	FVector TargetLocation = FVector::ZeroVector;
+	FQuat PreviousRotation = FQuat::Identity;
+	FQuat TargetRotation = FQuat::Identity;
+	float UpdateTime = 0.f;
+	bool bActive = false;
+
+	void SetTarget(const FVector& Location, const FQuat& Rotation, float Time, float Alpha)
+	{
+		if (bActive)
+		{
+			// Start from what is on screen so a late update doesn't make the element pop
+			PreviousLocation = FMath::Lerp(PreviousLocation, TargetLocation, Alpha);
+			PreviousRotation = FQuat::Slerp(PreviousRotation, TargetRotation, Alpha);
+		}
+		else
+		{
+			PreviousLocation = Location;
+			PreviousRotation = Rotation;
+		}
+		TargetLocation = Location;
+		TargetRotation = Rotation;
+		UpdateTime = Time;
+		bActive = true;
+	}
+
+	FVector GetLocation(float Alpha) const { return FMath::Lerp(PreviousLocation, TargetLocation, Alpha); }
+	FRotator GetRotation(float Alpha) const { return FQuat::Slerp(PreviousRotation, TargetRotation, Alpha).Rotator(); }
+
+	FVisualSample Samples[MaxSamples];
+	int32 NewestSample = 0;
+	int32 NumSamples = 0;
+
+	/* RenderTime and MaxExtrapolation are the ones Sample is called with this frame */
+	void AddSample(const FVector& Location, const FQuat& Rotation, float Time, float RenderTime, float MaxExtrapolation)
+	{
+		// Several updates arrived in the same frame, only the last one matters
+		if (NumSamples > 0 && GetSample(0).Time >= Time)
+		{
+			Samples[NewestSample] = { Location, Rotation, GetSample(0).Time };
+			return;
+		}
+
+		// Rendered past the newest sample, the new one is blended in from what is on screen instead of popping back
+		if (NumSamples > 0 && RenderTime > GetSample(0).Time && RenderTime < Time)
+		{
+			FVisualSample Shown;
+			FRotator ShownRotation;
+			Sample(RenderTime, MaxExtrapolation, Shown.Location, ShownRotation);
+			Shown.Rotation = ShownRotation.Quaternion();
+			Shown.Time = RenderTime;
+			PushSample(Shown);
+		}
+
+		PushSample({ Location, Rotation, Time });
+		bActive = true;
+	}
+
+	void PushSample(const FVisualSample& InSample)
+	{
+		NewestSample = (NewestSample + 1) % MaxSamples;
+		Samples[NewestSample] = InSample;
+		NumSamples = FMath::Min(NumSamples + 1, MaxSamples);
+	}
+
+	/* The next update snaps instead of sliding in from stale samples */
+	void Reset()
+	{
+		NumSamples = 0;
+		bActive = false;
+	}
+
+	/* Age 0 is the newest sample */
+	const FVisualSample& GetSample(int32 Age) const { return Samples[(NewestSample - Age + MaxSamples) % MaxSamples]; }
+
+	/*
+	 * Interpolates between the samples around RenderTime, or extrapolates along the last velocity for at most MaxExtrapolation.
+	 * Past that it holds the extrapolated position, units that stop get no further updates and stay at most that far ahead
+	 */
+	void Sample(float RenderTime, float MaxExtrapolation, FVector& OutLocation, FRotator& OutRotation) const
+	{
+		const FVisualSample& Newest = GetSample(0);
+		if (RenderTime >= Newest.Time)
+		{
+			OutLocation = Newest.Location;
+			OutRotation = Newest.Rotation.Rotator();
+			if (NumSamples < 2) return;
+
+			const FVisualSample& Previous = GetSample(1);
+			const float Elapsed = RenderTime - Newest.Time;
+			const float Ahead = FMath::Min(Elapsed, MaxExtrapolation);
+			OutLocation += (Newest.Location - Previous.Location) / (Newest.Time - Previous.Time) * Ahead;
+			return;
+		}
+
+		for (int32 Age = 1; Age < NumSamples; ++Age)
+		{
+			const FVisualSample& Older = GetSample(Age);
+			if (RenderTime < Older.Time) continue;
+
+			const FVisualSample& Newer = GetSample(Age - 1);
+			const float Alpha = (RenderTime - Older.Time) / (Newer.Time - Older.Time);
+			OutLocation = FMath::Lerp(Older.Location, Newer.Location, Alpha);
+			OutRotation = FQuat::Slerp(Older.Rotation, Newer.Rotation, Alpha).Rotator();
+			return;
+		}
+
+		// Older than anything buffered, wait on the oldest sample
+		const FVisualSample& Oldest = GetSample(NumSamples - 1);
+		OutLocation = Oldest.Location;
+		OutRotation = Oldest.Rotation.Rotator();
+	}
+};
 
 USTRUCT()
 struct FNiagaraVisualElement
@@ -36,6 +171,7 @@ struct FNiagaraVisualElement
 
 	uint64 Handle;
 	UNiagaraComponent* NiagaraComponent;
+	FVisualInterpolationState Interpolation;
 };
 
 USTRUCT()
@@ -52,8 +188,51 @@ struct FBPVisualElement
 
 	uint64 Handle;
 	TWeakObjectPtr<AActor> Element;
+	FVisualInterpolationState Interpolation;
 };
 
+/*
+ * Every unit of one (team, entity type) drawn by a single Niagara component.
+ * Slots are swap-removed, the arrays are pushed to the component's array data interfaces when dirty
+ */
+USTRUCT()
+struct FInstancedVisualBatch
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY() UNiagaraComponent* Component = nullptr;
+	ETeam Team;
+	EEntityType EntityType;
+
+	TArray<uint64> Handles;
+	TArray<FVector> Positions;
+	TArray<FVector> Directions;
+	// 1 shown, 0 hidden
+	TArray<int32> States;
+	TArray<FVisualInterpolationState> Interpolations;
+
+	bool bDirty = false;
+};
+
+/*
+ * Visualisation actors of one class waiting to be reused, hidden and deactivated
+ */
+USTRUCT()
+struct FVisualActorPool
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY() TArray<AActor*> FreeActors;
+	int32 Hits = 0;
+	int32 Misses = 0;
+	int32 Trimmed = 0;
+};
+
+struct FInstancedVisualSlot
+{
+	int32 Batch = INDEX_NONE;
+	int32 Slot = INDEX_NONE;
+};
 
 USTRUCT()
 struct FTruc
@@ -104,12 +283,18 @@ public: /* Public AVM Methods */
 	void BatchUpdatePosition(const TArray<FMassEntityHandle>& EntityHandles, const TArray<FDataForVisualisation>& DataForVisualisations);
 	void UpdatePositionP(FMassEntityHandle EntityHandle, const FDataForVisualisation DataForVisualisation);
 	void RemoveFromMapP(FMassEntityHandle EntityHandle);
+	void BatchRemoveFromMapP(const TArray<FMassEntityHandle>& EntityHandles);
 	void ChangeBatch(int Value);
 
 	float GetRadius();
 	void UpdatePositionOfSpecificUnits(const TArray<FDataForVisualisation>& DataForVisualisations, const TArray<FMassEntityHandle>& EntitiesToHide);
+	/* Client side, moves the units the client simulates itself. Units the server did not show are left hidden */
+	void UpdateSimulatedUnits(const TArray<FDataForVisualisation>& DataForVisualisations);
 
 	void ShowHideAllItems(bool bShow);
+
+	/* Client side, replaces the impostors drawn for the distant blocks of units */
+	void UpdateImpostors(const TArray<FAmalgamImpostor>& Impostors);
 	
 
 protected: /* Protected AVM Methods */
@@ -125,6 +310,7 @@ protected: /* Protected AVM Methods */
 	void HideItem(FMassEntityHandle EntityHandle);
 
 	void RemoveFromMap(FMassEntityHandle EntityHandle);
+	void BatchRemoveFromMap(const TArray<FMassEntityHandle>& EntityHandles);
 
 	UFUNCTION() void OnPreLaunchGame();
 
@@ -136,7 +322,9 @@ protected: /* Protected AVM Methods */
 	UFUNCTION(NetMulticast, Unreliable) void UpdatePositionMulticast(FMassEntityHandle EntityHandle, const FDataForVisualisation DataForVisualisation);
 	UFUNCTION(NetMulticast, Reliable) void BatchUpdatePositionMulticast(const TArray<FMassEntityHandle>& EntityHandles, const TArray<FDataForVisualisation>& DataForVisualisations);
 	UFUNCTION(NetMulticast, Reliable) void RemoveFromMapMulticast(FMassEntityHandle EntityHandle);
+	UFUNCTION(NetMulticast, Reliable) void BatchRemoveFromMapMulticast(const TArray<FMassEntityHandle>& EntityHandles);
 	UFUNCTION(NetMulticast, Reliable) void ChangeBatchMulticast(int Value);
+	UFUNCTION(NetMulticast, Reliable) void PrewarmActorPoolsMulticast();
 
 private: /* Private Methods */
 
@@ -145,6 +333,31 @@ private: /* Private Methods */
 	FBPVisualElement* FindElementBP(uint64 ElementHandle);
 	int32 FindElementIndex(uint64 ElementHandle);
 	bool ContainsElement(uint64 ElementHandle);
+	void AddElement(const FNiagaraVisualElement& NewElement);
+	void AddElementBP(const FBPVisualElement& NewElement);
+	/* Swaps the last element into the removed slot, only the moved element index has to be patched */
+	void RemoveElement(uint64 ElementHandle);
+
+	int32 FindOrCreateInstancedBatch(ETeam Team, EEntityType EntityType);
+	void AddInstancedElement(uint64 ElementHandle, ETeam Team, EEntityType EntityType, const FVector& Location);
+	void RemoveInstancedElement(uint64 ElementHandle);
+	void PushInstancedBatches();
+
+	AActor* AcquireVisualActor(TSubclassOf<AActor> ActorClass, const FVector& Location);
+	/* Destroys the actor instead when the pool is above PoolHighWatermark */
+	void ReleaseVisualActor(AActor* Actor);
+	AActor* SpawnPooledActor(UClass* ActorClass);
+	/* Tops the pools up to PoolLowWatermark, a few actors per tick so it never spikes */
+	void RefillActorPools();
+	void DebugActorPools();
+
+	bool ShouldInterpolate();
+	bool UsesVisualBuffer() const;
+	float GetInterpolationAlpha(const FVisualInterpolationState& Interpolation) const;
+	void PushInterpolationTarget(FVisualInterpolationState& Interpolation, const FVector& Location, const FQuat& Rotation, float Now);
+	void ResetInterpolation(uint64 HandleAsNumber);
+	void GetInterpolatedTransform(const FVisualInterpolationState& Interpolation, float Now, FVector& OutLocation, FRotator& OutRotation) const;
+	void InterpolateElements();
 	TArray<FTruc> Trucs = TArray<FTruc>();
 
 public: /* Public Member variables */
@@ -155,14 +368,57 @@ private: /* Private Member variables */
 
 	TArray<FBPVisualElement> BPElementsArray;
 
+	/* Handle to index in ElementArray / BPElementsArray, kept in sync by AddElement and RemoveElement */
+	TMap<uint64, int32> ElementIndices;
+	TMap<uint64, int32> BPElementIndices;
+
 	UPROPERTY(EditAnywhere) bool bUseBPVisualisation = false;
 
+	/* Clients render the units InterpolationDelay seconds in the past between buffered updates, so the server can send them at a low rate */
+	UPROPERTY(EditAnywhere) bool bBufferVisualUpdates = false;
+	/* Should cover at least the interval between two updates */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bBufferVisualUpdates")) float InterpolationDelay = 0.15f;
+	/* When updates stop coming, units keep moving along their last velocity for this long, then hold there until the next one */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bBufferVisualUpdates")) float MaxExtrapolationTime = 0.25f;
+
+	/*
+	 * Draws the units with one InstancedSystem component per (team, entity type) instead of one component or actor per unit.
+	 * The system reads the "Positions", "Directions" (vector) and "States" (int) array data interfaces, one particle per entry.
+	 * Takes precedence over bUseBPVisualisation
+	 */
+	UPROPERTY(EditAnywhere) bool bUseInstancedVisualisation = false;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseInstancedVisualisation")) UNiagaraSystem* InstancedSystem = nullptr;
+
+	UPROPERTY() TArray<FInstancedVisualBatch> InstancedBatches;
+	TMap<uint64, FInstancedVisualSlot> InstancedIndices;
+
+	/* Elements shown by the last server update, whatever the visualisation mode */
+	TSet<uint64> ShownElements;
+
+	/* BP visualisation actors are recycled instead of spawned and destroyed for each entity */
+	UPROPERTY(EditAnywhere) bool bUseActorPool = false;
+	/* Pools filled with PoolPrewarmCount actors at PreLaunchGame, other classes get a pool on first use */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseActorPool")) TArray<TSubclassOf<AActor>> PrewarmedActorClasses;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseActorPool")) int32 PoolPrewarmCount = 64;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseActorPool")) int32 PoolLowWatermark = 16;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseActorPool")) int32 PoolHighWatermark = 256;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseActorPool")) int32 PoolRefillPerTick = 4;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseActorPool")) bool bDebugActorPool = false;
+
+	UPROPERTY() TMap<UClass*, FVisualActorPool> ActorPools;
+
+	/*
+	 * Draws the impostors sent by UAmalgamViewReportComponent, one particle per impostor.
+	 * The system reads the "ImpostorPositions" (vector), "ImpostorSpreads" (float), "ImpostorCounts" (int) and "ImpostorColors" (color) arrays
+	 */
+	UPROPERTY(EditAnywhere) UNiagaraSystem* ImpostorSystem = nullptr;
+	UPROPERTY() UNiagaraComponent* ImpostorComponent = nullptr;
+
 	bool bDebugReplicationNumbers = false;
 	bool bHideAll = true;
-	int CurrentBatch = 0;
-	int UnitsByBatch = 50;
 
 	AInfernalePawn* InfernalePawn;
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
 	FVector LocalPointLocation;
 
 	
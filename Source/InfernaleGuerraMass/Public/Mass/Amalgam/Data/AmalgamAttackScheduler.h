@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+
+/*
+ * An attack waiting in the scheduler. Entries are never removed when an entity leaves the fight,
+ * the consumer drops the ones whose tick doesn't match the one stored on the entity anymore.
+ */
+struct FAmalgamScheduledAttack
+{
+	FMassEntityHandle Entity;
+	uint64 Tick = 0;
+};
+
+/*
+ * Hierarchical timing wheel holding the next attack of every fighting amalgam.
+ * Simulation time is cut in ticks of Resolution seconds, the near wheel covers the next 256 ticks,
+ * the far wheel the next 256 * 64 ticks and anything later waits in an overflow list.
+ * Far entries are moved down to the near wheel when their block of 256 ticks comes up.
+ */
+struct INFERNALETESTING_API FAmalgamAttackScheduler
+{
+public:
+	void Configure(float InResolution);
+
+	/* Fight pass only, the wheels have no lock. Returns the tick the attack was scheduled at, to be stored on the entity */
+	uint64 Schedule(FMassEntityHandle Entity, double DueTime);
+
+	/* Thread safe. Tick an attack due at DueTime will be scheduled at, without scheduling it */
+	uint64 GetDueTick(double DueTime) const { return FMath::Max<int64>(FMath::CeilToInt64(DueTime / Resolution), 0); }
+
+	/* Thread safe, called once per chunk by parallel processors. The attacks are inserted on the next Advance */
+	void SchedulePending(TConstArrayView<FAmalgamScheduledAttack> Attacks);
+
+	/* Fight pass only. Moves the wheel up to SimulationTime and outputs the attacks that came due */
+	void Advance(double SimulationTime, TArray<FAmalgamScheduledAttack>& OutDueAttacks);
+
+	uint64 GetCurrentTick() const { return CurrentTick; }
+
+private:
+	static constexpr int32 NearBits = 8;
+	static constexpr int32 NearSize = 1 << NearBits;
+	static constexpr int32 FarBits = 6;
+	static constexpr int32 FarSize = 1 << FarBits;
+
+	void Insert(const FAmalgamScheduledAttack& Attack);
+	void Cascade(TArray<FAmalgamScheduledAttack>& Slot);
+
+	float Resolution = 1.f / 20.f;
+	uint64 CurrentTick = 0;
+
+	TArray<FAmalgamScheduledAttack> NearWheel[NearSize];
+	TArray<FAmalgamScheduledAttack> FarWheel[FarSize];
+	TArray<FAmalgamScheduledAttack> Overflow;
+
+	FCriticalSection PendingLock;
+	TArray<FAmalgamScheduledAttack> Pending;
+
+	// Kept between cascades to reuse the allocation
+	TArray<FAmalgamScheduledAttack> CascadeScratch;
+};
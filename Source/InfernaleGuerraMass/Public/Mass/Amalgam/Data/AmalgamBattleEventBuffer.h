@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Component/ActorComponents/BattleManagerComponent.h"
+#include "Enums/Enums.h"
+#include "Structs/SimpleStructs.h"
+
+class ABuildingParent;
+class ALDElement;
+
+/*
+ * One hit landed by an amalgam, kept small so the fight pass can record every hit without building a FBattleInfo
+ */
+struct FAmalgamBattleEvent
+{
+	FVector2D AttackerLocation;
+	FVector2D TargetLocation;
+	FOwner AttackerOwner;
+	FOwner TargetOwner;
+	EEntityType AttackerType;
+	EEntityType TargetType;
+	EUnitTargetType TargetKind;
+};
+
+/*
+ * Hit landed on a building or an LD element. Actors are only damaged on the game thread,
+ * its battle event is built once the damage went through, see FAmalgamBattleEventBuffer::Flush
+ */
+struct FAmalgamStructureHit
+{
+	TWeakObjectPtr<ABuildingParent> Building;
+	TWeakObjectPtr<ALDElement> LDElement;
+	float Damage = 0.f;
+	FVector2D AttackerLocation;
+	FOwner AttackerOwner;
+	EEntityType AttackerType;
+};
+
+/*
+ * Everything a FBattleInfo takes from its events besides the locations, hits only merge when all of it matches
+ */
+struct FAmalgamBattleClusterKey
+{
+	int32 CellIndex = INDEX_NONE;
+	FOwner AttackerOwner;
+	FOwner TargetOwner;
+	EEntityType AttackerType;
+	EEntityType TargetType;
+	EUnitTargetType TargetKind;
+
+	bool operator==(const FAmalgamBattleClusterKey& Other) const
+	{
+		return CellIndex == Other.CellIndex
+			&& AttackerOwner.Team == Other.AttackerOwner.Team && AttackerOwner.Player == Other.AttackerOwner.Player
+			&& TargetOwner.Team == Other.TargetOwner.Team && TargetOwner.Player == Other.TargetOwner.Player
+			&& AttackerType == Other.AttackerType && TargetType == Other.TargetType && TargetKind == Other.TargetKind;
+	}
+
+	friend uint32 GetTypeHash(const FAmalgamBattleClusterKey& Key)
+	{
+		uint32 Hash = ::GetTypeHash(Key.CellIndex);
+		Hash = HashCombine(Hash, static_cast<uint32>(Key.AttackerOwner.Team) | static_cast<uint32>(Key.AttackerOwner.Player) << 8 | static_cast<uint32>(Key.TargetOwner.Team) << 16 | static_cast<uint32>(Key.TargetOwner.Player) << 24);
+		return HashCombine(Hash, static_cast<uint32>(Key.AttackerType) | static_cast<uint32>(Key.TargetType) << 8 | static_cast<uint32>(Key.TargetKind) << 16);
+	}
+};
+
+/*
+ * Hits of the same grid cell, owners, unit types and target kind, merged into a single battle
+ */
+struct FAmalgamBattleCluster
+{
+	FAmalgamBattleClusterKey Key;
+	FVector2D AttackerLocationSum = FVector2D::ZeroVector;
+	FVector2D TargetLocationSum = FVector2D::ZeroVector;
+	int32 NumEvents = 0;
+};
+
+/*
+ * Collects the battle events of the frame and hands them to the battle manager once, at the end of the phase.
+ * Hits close to each other are clustered per grid cell so the battle manager gets one battle per fight instead of one per hit.
+ * Structure hits are held here too, so the fight pass never touches an actor and can run on worker threads.
+ */
+struct INFERNALETESTING_API FAmalgamBattleEventBuffer
+{
+public:
+	/* Thread safe, called once per chunk by the fight pass */
+	void Append(TConstArrayView<FAmalgamBattleEvent> Events, TConstArrayView<FAmalgamStructureHit> StructureHits);
+
+	bool IsEmpty() const { return Events.IsEmpty() && StructureHits.IsEmpty(); }
+
+	/* Game thread only, applies the structure hits, clusters the events, sends one AtPosBattleInfo per cluster and resets the buffer */
+	void Flush(UBattleManagerComponent* BattleManager);
+
+private:
+	void ApplyStructureHits();
+	FAmalgamBattleClusterKey GetClusterKey(const FAmalgamBattleEvent& Event) const;
+
+	FCriticalSection Lock;
+	TArray<FAmalgamBattleEvent> Events;
+	TArray<FAmalgamStructureHit> StructureHits;
+
+	// Kept between frames to reuse the allocation
+	TMap<FAmalgamBattleClusterKey, FAmalgamBattleCluster> Clusters;
+};
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SplineComponent.h"
+#include "Tasks/Task.h"
+#include "UObject/ObjectKey.h"
+
+class AFlux;
+
+/*
+ * Flux spline resampled at a fixed arc-length spacing, baked once per flux update.
+ * Immutable once built and shared between every amalgam following that flux, so movement never touches the spline component.
+ */
+struct INFERNALETESTING_API FAmalgamFluxPathLUT
+{
+	uint32 UpdateID = -1;
+	uint32 UpdateVersion = -1;
+	float SpeedMult = 1.f;
+
+	float Spacing = 100.f;
+	float Length = 0.f;
+
+	// Positions are flattened on the ground, tangents are normalized
+	TArray<FVector> Positions;
+	TArray<FVector> Tangents;
+
+	static TSharedPtr<FAmalgamFluxPathLUT> Bake(const FSplineCurves& Curves, const FTransform& SplineTransform, float InSpacing);
+
+	int32 Num() const { return Positions.Num(); }
+	bool IsValidIndex(int32 Index) const { return Positions.IsValidIndex(Index); }
+
+	// Closest sample to Location, only searching from StartIndex onwards
+	int32 FindClosestIndex(const FVector& Location, int32 StartIndex = 0) const;
+
+	float GetDistanceAtIndex(int32 Index) const { return FMath::Min(Index * Spacing, Length); }
+	// First sample strictly ahead of Distance, Num() once past the end
+	int32 GetIndexAfterDistance(float Distance) const { return FMath::Clamp(FMath::FloorToInt(Distance / Spacing) + 1, 0, Num()); }
+
+	FVector GetPositionAtDistance(float Distance) const;
+	FVector GetTangentAtDistance(float Distance) const;
+
+private:
+	void GetSegment(float Distance, int32& OutIndex, float& OutAlpha) const;
+};
+
+/*
+ * Per world cache of the baked flux paths, owned by UAmalgamSimulationSubsystem.
+ * Only mutated on the game thread outside of the amalgam processors, movement reads it from worker threads.
+ */
+class INFERNALETESTING_API FAmalgamFluxPathCache
+{
+public:
+	void Configure(float InSpacing);
+
+	/* Game thread. Bakes the flux synchronously the first time it is seen so new amalgams have a path right away */
+	void Register(AFlux* Flux);
+
+	/* Game thread, once per frame. Drops destroyed fluxes, swaps finished bakes in and starts new ones for updated fluxes */
+	void Update();
+
+	const TSharedPtr<const FAmalgamFluxPathLUT>* Find(FObjectKey FluxKey) const;
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<AFlux> Flux;
+		TSharedPtr<const FAmalgamFluxPathLUT> LUT;
+		UE::Tasks::TTask<TSharedPtr<FAmalgamFluxPathLUT>> PendingBake;
+		bool bBakePending = false;
+	};
+
+	static TSharedPtr<FAmalgamFluxPathLUT> BakeFlux(AFlux* Flux, float Spacing);
+	static UE::Tasks::TTask<TSharedPtr<FAmalgamFluxPathLUT>> LaunchBake(AFlux* Flux, float Spacing);
+
+	TMap<FObjectKey, FEntry> Entries;
+	float Spacing = 100.f;
+};
@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * Decides how much simulation time the amalgam processors integrate each frame.
+ * In fixed timestep mode, frame time is accumulated and consumed in steps of 1 / SimulationRate.
+ * A frame slower than a step consumes up to MaxCatchUpSteps steps at once, integrated as a single delta time,
+ * anything beyond is dropped so a hitch can't snowball.
+ */
+struct INFERNALETESTING_API FAmalgamSimulationClock
+{
+public:
+	void Configure(bool bInFixedTimestep, float InSimulationRate, int32 InMaxCatchUpSteps);
+
+	/* Game thread, once per frame before the amalgam processors run */
+	void Advance(float FrameDeltaTime);
+
+	bool IsFixedTimestep() const { return bFixedTimestep; }
+
+	// False on frames where the fixed step accumulator didn't fill up, the simulation should be skipped
+	bool ShouldStep() const { return StepsThisFrame > 0; }
+
+	// Fixed steps consumed this frame, Tick moved by as many
+	int32 GetStepsThisFrame() const { return StepsThisFrame; }
+
+	// True if one of the ticks consumed this frame is a multiple of Interval once offset by Offset, for work staggered over ticks
+	bool IsDueThisFrame(uint64 Offset, int32 Interval) const { return (Tick + Offset) % FMath::Max(1, Interval) < (uint64)StepsThisFrame; }
+
+	// Simulated time to integrate this frame, StepsThisFrame * FixedStep in fixed timestep mode
+	float GetStepDeltaTime() const { return StepDeltaTime; }
+	float GetFixedStep() const { return FixedStep; }
+
+	double GetSimulationTime() const { return SimulationTime; }
+	uint64 GetTick() const { return Tick; }
+
+private:
+	bool bFixedTimestep = false;
+	float FixedStep = 1.f / 20.f;
+	int32 MaxCatchUpSteps = 3;
+
+	float Accumulator = 0.f;
+	int32 StepsThisFrame = 0;
+	float StepDeltaTime = 0.f;
+
+	double SimulationTime = 0.0;
+	uint64 Tick = 0;
+};
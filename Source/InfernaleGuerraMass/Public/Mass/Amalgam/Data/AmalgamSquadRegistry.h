@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "UObject/ObjectKey.h"
+#include "Mass/Collision/SpatialHashGrid.h"
+
+/*
+ * One squad member as seen by the squad pass of the current step
+ */
+struct FAmalgamSquadMember
+{
+	FMassEntityHandle Entity;
+	int32 SquadId = INDEX_NONE;
+	FVector Location = FVector::ZeroVector;
+	float DetectionRange = 0.f;
+	FObjectKey FluxKey;
+	ETeam Team;
+	// Marching and not dead reckoned, the only members running an aggro query
+	bool bActive = false;
+	// Squad changed by the last Recluster, to be written back to the fragment
+	bool bReassigned = false;
+};
+
+/*
+ * Amalgams spawned together and still moving as a blob.
+ * The squad runs one grid query covering all of its members, each member then picks its target among the candidates.
+ */
+struct FAmalgamSquad
+{
+	ETeam Team;
+	int32 NumMembers = 0;
+	int32 NumActiveMembers = 0;
+
+	// Bounds of the active members, and the largest detection range among them
+	FBox ActiveBounds = FBox(ForceInit);
+	float MaxDetectionRange = 0.f;
+
+	TArray<FGridTargetCandidate> Candidates;
+	bool bHasCandidates = false;
+
+	// Created since the last squad pass, its members may not have been seen yet
+	bool bFresh = true;
+};
+
+/*
+ * Every squad of the world, indexed by squad id.
+ * Written on the game thread by the squad processor only, read by the aggro workers once it is done.
+ */
+struct INFERNALETESTING_API FAmalgamSquadRegistry
+{
+public:
+	void Configure(int32 InMaxSquadSize);
+
+	/* Game thread only */
+	int32 CreateSquad(ETeam Team);
+	int32 GetMaxSquadSize() const { return MaxSquadSize; }
+
+	/* Splits squads whose members spread over disconnected grid cells, then merges squads sharing a team, a flux and a cell */
+	void Recluster(TArray<FAmalgamSquadMember>& Members);
+
+	/* Recounts the squads from the members of this step and releases the empty ones */
+	void Accumulate(TConstArrayView<FAmalgamSquadMember> Members);
+
+	/* Runs the shared grid query of every squad with at least two active members */
+	void GatherCandidates();
+
+	/* Thread safe once GatherCandidates is done. Null if a member at Location should run its own query */
+	const TArray<FGridTargetCandidate>* FindCandidates(int32 SquadId, const FVector& Location) const;
+
+private:
+	TSparseArray<FAmalgamSquad> Squads;
+	int32 MaxSquadSize = 32;
+};
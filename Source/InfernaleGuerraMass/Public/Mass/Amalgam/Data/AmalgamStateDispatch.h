@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Mass/Army/AmalgamFragments.h"
+
+/*
+ * Lets processors work on the amalgams of some states only, without state tags.
+ * The states of a chunk are scanned once and the matching entities gathered in a dense index list,
+ * the processor then only iterates that list. In tag mode the queries already filter, every state is accepted.
+ */
+struct INFERNALETESTING_API FAmalgamStateDispatch
+{
+public:
+	using FEntityIndices = TArray<int32, TInlineAllocator<256>>;
+
+	static constexpr uint32 AllStates = MAX_uint32;
+
+	static uint32 StateBit(EAmalgamState State) { return 1u << static_cast<uint32>(State); }
+
+	/* Indices in the chunk of the entities whose state is in StateMask */
+	static void GatherEntities(TConstArrayView<FAmalgamStateFragment> States, uint32 StateMask, FEntityIndices& OutIndices);
+};
@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Structs/ReplicationStructs.h"
+#include "Mass/Amalgam/Data/AmalgamVisualUpdateScheduler.h"
+#include "Mass/Replication/AmalgamUnitStream.h"
+
+class APlayerControllerInfernale;
+struct FAmalgamViewReport;
+
+enum class EAmalgamCellVisibility : uint8
+{
+	Hidden,
+	Partial,
+	Visible,
+	// Too small on screen, drawn as part of a block impostor instead
+	Impostor
+};
+
+struct FAmalgamViewCullingSettings
+{
+	// World size of an amalgam visual
+	float UnitSize = 150.f;
+	// In pixels, smaller units are not sent
+	float MinScreenSize = 2.f;
+	// In pixels, blocks of cells whose units would all be smaller are replaced by impostors. 0 disables them
+	float ImpostorScreenSize = 0.f;
+	// In cells, side of the blocks summarized by an impostor
+	int32 ImpostorBlockSize = 4;
+};
+
+/*
+ * Snapshot of what a player can see, taken on the game thread so the visibility pass can run on workers.
+ * Cells are classified as a whole, only the cells crossed by the view circle need a per entity check.
+ * With a view report the circle is replaced by the ground quad seen by the camera and a screen size limit.
+ */
+struct INFERNALETESTING_API FAmalgamPlayerView
+{
+	TWeakObjectPtr<APlayerControllerInfernale> PlayerController;
+	uint8 TeamBit = 0;
+
+	FVector2D Center = FVector2D::ZeroVector;
+	float RadiusSquared = 0.f;
+
+	FVector2D GridOrigin = FVector2D::ZeroVector;
+	FVector2D CellSize = FVector2D(100.f, 100.f);
+
+	// Cells fully inside the view circle
+	FIntPoint InnerMin = FIntPoint(1, 1);
+	FIntPoint InnerMax = FIntPoint(0, 0);
+
+	// Cells overlapping the view circle bounds
+	FIntPoint OuterMin = FIntPoint(1, 1);
+	FIntPoint OuterMax = FIntPoint(0, 0);
+
+	// Quad mode, see InitFromReport
+	bool bUseQuad = false;
+	FVector2D Quad[4];
+	FVector CameraLocation = FVector::ZeroVector;
+	// Squared distance to the camera past which a unit is below the screen size limit
+	float MaxDistanceSquared = 0.f;
+	// Same for impostors, for a whole block of cells
+	float ImpostorDistanceSquared = 0.f;
+	// Classification of the cells in [OuterMin, OuterMax], computed once per view
+	TArray<EAmalgamCellVisibility> CellStates;
+	// Blocks drawn as impostors, see ASpatialHashGrid::GetCoarseCell
+	TSet<FIntPoint> ImpostorBlocks;
+
+	void Init(const FVector2D& InCenter, float Radius, const FVector2D& InGridOrigin, const FVector2D& InCellSize);
+	/*
+	 * GridSize bounds the cells classified when the camera sees far past the grid.
+	 * With FixedImpostorBlocks the impostor blocks are the ones the client draws, otherwise they are picked again from the screen size
+	 */
+	void InitFromReport(const FAmalgamViewReport& Report, const FAmalgamViewCullingSettings& Settings, const FVector2D& InGridOrigin, const FVector2D& InCellSize, const FIntPoint& GridSize,
+		const TSet<FIntPoint>* FixedImpostorBlocks = nullptr);
+
+	FIntPoint ToCell(const FVector2D& Location) const;
+	EAmalgamCellVisibility ClassifyCell(const FIntPoint& Cell) const;
+
+	bool IsVisible(const FVector2D& Location) const;
+
+	/*
+	 * Whole chunk culling. Hidden if nothing in the box can be visible, Visible if everything in it is, Partial otherwise.
+	 * Gives up with Partial past MaxCells cells, per entity checks are cheaper then
+	 */
+	EAmalgamCellVisibility ClassifyRegion(const FVector2D& Min, const FVector2D& Max, int32 MaxCells) const;
+
+private:
+	bool IsInQuad(const FVector2D& Location) const;
+	bool IsLargeEnough(const FVector2D& Location) const;
+	EAmalgamCellVisibility ClassifyCellAgainstQuad(const FIntPoint& Cell) const;
+	EAmalgamCellVisibility ClassifyCellScreenSize(const FIntPoint& Cell, EAmalgamCellVisibility QuadState) const;
+	bool IsImpostorBlock(const FIntPoint& Block, int32 BlockSize, const TSet<FIntPoint>* FixedImpostorBlocks) const;
+};
+
+/*
+ * Lock free version of FAmalgamPlayerUpdateBuffer, filled by a single worker before being appended to the collector
+ */
+struct FAmalgamPlayerUpdateScratch
+{
+	TArray<FDataForVisualisation> Shown;
+	TArray<FMassEntityHandle> Hidden;
+};
+
+/*
+ * Show/hide lists of one player for the current frame, kept alive between frames to reuse the allocations
+ */
+struct FAmalgamPlayerUpdateBuffer
+{
+	FCriticalSection Lock;
+
+	TArray<FDataForVisualisation> Shown;
+	TArray<FMassEntityHandle> Hidden;
+
+	// Only touched by the flush
+	FAmalgamPlayerSchedule Schedule;
+};
+
+/*
+ * Collects the visual updates of every chunk during the frame and sends them once per player at the end of the phase.
+ * Workers append under a per player lock, the buffers are only reset between frames so they don't reallocate.
+ */
+struct INFERNALETESTING_API FAmalgamVisualUpdateCollector
+{
+public:
+	/* Before the producers run. ExpectedUpdates is used to pre-reserve the buffers */
+	void BeginFrame(int32 ExpectedUpdates);
+
+	/* Thread safe, called from the simulation workers. ViewIndex is the index in GetPlayerViews */
+	void Append(int32 ViewIndex, TConstArrayView<FDataForVisualisation> Shown, TConstArrayView<FMassEntityHandle> Hidden);
+
+	/*
+	 * Game thread only, sends one UpdateUnits per player and resets the buffers.
+	 * Removed are the entities whose visuals are destroyed this frame, the unit stream stops tracking them
+	 */
+	void Flush(TConstArrayView<FMassEntityHandle> Removed);
+
+	/* Sends the updates through UAmalgamUnitStreamComponent instead of UpdateUnits */
+	void ConfigureUnitStream(bool bInUseUnitStream, const FAmalgamUnitStreamSettings& Settings);
+
+	/* Caps the updates sent per player, see FAmalgamVisualUpdateScheduler */
+	void ConfigureScheduler(const FAmalgamVisualUpdateSchedulerSettings& Settings) { UpdateScheduler.Configure(Settings); }
+	const FAmalgamVisualUpdateScheduler& GetUpdateScheduler() const { return UpdateScheduler; }
+
+	/* Written by the presentation processor, read by the visibility pass of the next frame */
+	const TArray<FAmalgamPlayerView>& GetPlayerViews() const { return PlayerViews; }
+	void SetPlayerViews(TArray<FAmalgamPlayerView>&& InPlayerViews);
+
+private:
+	void FlushUnitStream(TConstArrayView<FMassEntityHandle> Removed);
+	/* Trims the buffers to the budget of each player before they are sent */
+	void ScheduleUpdates(TConstArrayView<FMassEntityHandle> Removed);
+
+	TArray<FAmalgamPlayerView> PlayerViews;
+	TArray<TUniquePtr<FAmalgamPlayerUpdateBuffer>> PlayerBuffers;
+
+	// Receivers of the frame being collected, the views can be replaced before the flush
+	TArray<TWeakObjectPtr<APlayerControllerInfernale>> FramePlayerControllers;
+	// Camera of each receiver, ranks the updates of the frame
+	TArray<FVector> FrameViewPoints;
+
+	FAmalgamVisualUpdateScheduler UpdateScheduler;
+
+	bool bUseUnitStream = false;
+	FAmalgamUnitStreamSettings UnitStreamSettings;
+
+	// Removals since the last frame sent through the stream, frames are only sent on simulation steps
+	TArray<FMassEntityHandle> StreamRemovals;
+};
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Structs/ReplicationStructs.h"
+
+struct FAmalgamVisualUpdateSchedulerSettings
+{
+	// Updates sent per player and simulation step, 0 sends every visible unit
+	int32 Budget = 0;
+	// In simulation steps, a visible unit whose last update is this old goes before any other
+	int32 MaxStaleness = 10;
+	// World units of error added per step without an update, so idle units still come up
+	float StalenessWeight = 10.f;
+	// World units of error for a half turn since the last update
+	float TurnWeight = 200.f;
+	// Units closer to the view point than this all get the same screen weight
+	float MinViewDistance = 1000.f;
+};
+
+struct FAmalgamVisualUpdateSchedulerStats
+{
+	int32 Sent = 0;
+	int32 Deferred = 0;
+	// Deferred even though they reached MaxStaleness, the budget is too small for the units in view
+	int32 Overdue = 0;
+
+	void Reset() { *this = FAmalgamVisualUpdateSchedulerStats(); }
+	FAmalgamVisualUpdateSchedulerStats& operator+=(const FAmalgamVisualUpdateSchedulerStats& Other)
+	{
+		Sent += Other.Sent;
+		Deferred += Other.Deferred;
+		Overdue += Other.Overdue;
+		return *this;
+	}
+};
+
+/*
+ * What a player last received for each unit it sees
+ */
+struct FAmalgamPlayerSchedule
+{
+	struct FSentUnit
+	{
+		FVector2D Location = FVector2D::ZeroVector;
+		FVector2D Direction = FVector2D::ZeroVector;
+		uint32 Step = 0;
+	};
+
+	TMap<FMassEntityHandle, FSentUnit> SentUnits;
+};
+
+/*
+ * Caps the visual updates sent to a player each simulation step.
+ * Units are ranked by the error the client sees, the distance and turn since their last update divided by their distance
+ * to the view point, so fast units and units close to the camera come first. Units just shown go out first,
+ * then units whose last update is MaxStaleness steps old, oldest first. They still count against the budget, so
+ * a crowded view can't blow it up, and a unit left behind is only waiting on the ones that are older than it.
+ * Deferred units are simply dropped, the visibility pass reports them again on the next step.
+ */
+struct INFERNALETESTING_API FAmalgamVisualUpdateScheduler
+{
+public:
+	void Configure(const FAmalgamVisualUpdateSchedulerSettings& InSettings) { Settings = InSettings; }
+	bool IsEnabled() const { return Settings.Budget > 0; }
+
+	/* Once per simulation step, before the players are scheduled */
+	void BeginStep();
+
+	/* Keeps the units of InOutShown that fit in the budget, Hidden units are forgotten */
+	void Schedule(FAmalgamPlayerSchedule& Schedule, const FVector& ViewPoint, TArray<FDataForVisualisation>& InOutShown, TConstArrayView<FMassEntityHandle> Hidden);
+
+	/* Units whose visuals are destroyed, forgotten by every player */
+	static void Forget(FAmalgamPlayerSchedule& Schedule, TConstArrayView<FMassEntityHandle> Removed);
+
+	/* Totals of the last step, over every player */
+	const FAmalgamVisualUpdateSchedulerStats& GetStepStats() const { return StepStats; }
+	const FAmalgamVisualUpdateSchedulerStats& GetTotalStats() const { return TotalStats; }
+
+private:
+	FAmalgamVisualUpdateSchedulerSettings Settings;
+	uint32 Step = 0;
+
+	FAmalgamVisualUpdateSchedulerStats StepStats;
+	FAmalgamVisualUpdateSchedulerStats TotalStats;
+
+	// Reused between players
+	TArray<TPair<float, int32>> Candidates;
+	TArray<FDataForVisualisation> Selected;
+};
@@ -13,6 +13,7 @@
  * 
  */
 class AFogOfWarManager;
+class UAmalgamSimulationSubsystem;
 
 UCLASS()
 class INFERNALETESTING_API UAmalgamKillObserver : public UMassObserverProcessor
@@ -28,8 +29,11 @@ protected:
 
 private:
 	FMassEntityQuery EntityQuery;
-	AAmalgamVisualisationManager* VisualisationManager;
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
 	AFogOfWarManager* FogManager;
 
+	// Kept between executions to reuse the allocation
+	TArray<FMassEntityHandle> KilledEntities;
+
 	bool bDebug = false;
 };
@@ -6,8 +6,13 @@
 #include "MassObserverProcessor.h"
 #include "AmalgamStateHandlerObserver.generated.h"
 
+class UAmalgamSimulationSubsystem;
+
+enum EAmalgamState : uint8;
+
 /**
- * 
+ * Applies state changes to the entity tags.
+ * In tag mode every state has its tag, otherwise only the states opted in UAmalgamSimulationSubsystem do.
  */
 UCLASS()
 class INFERNALETESTING_API UAmalgamStateHandlerObserver : public UMassObserverProcessor
@@ -22,5 +27,8 @@ protected:
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 
 private:
+	void ApplyStateTags(EAmalgamState State, FMassExecutionContext& Context, int32 EntityIndex);
+	void SyncOptedInStateTags(EAmalgamState State, const UAmalgamSimulationSubsystem& Settings, FMassExecutionContext& Context, int32 EntityIndex);
+
 	FMassEntityQuery EntityQuery;
 };
@@ -14,7 +14,8 @@ enum EAmalgamAggro : uint8;
 struct FAmalgamStateFragment;
 struct FAmalgamTargetFragment;
 
-class IUnitTargetable;
+struct FDetectionResult;
+class UAmalgamSimulationSubsystem;
 
 UCLASS()
 class INFERNALETESTING_API UAmalgamAggroProcessor : public UMassProcessor
@@ -28,10 +29,11 @@ class INFERNALETESTING_API UAmalgamAggroProcessor : public UMassProcessor
 private:
 
 	EAmalgamAggro ClosestDetected(float AmalgamDist, float BuildingDist, float LDDist);
-	void AggroDetected(EAmalgamAggro Detected, FAmalgamStateFragment& StateFragment, FAmalgamTargetFragment& TargetFragment, FMassEntityHandle Handle, IUnitTargetable* Target, FMassExecutionContext& Context, int32 EntityIndex);
+	void AggroDetected(EAmalgamAggro Detected, FAmalgamStateFragment& StateFragment, FAmalgamTargetFragment& TargetFragment, const FDetectionResult& DetectionResult, FMassExecutionContext& Context, int32 EntityIndex);
 
 private:
 	FMassEntityQuery EntityQuery;
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
 
 	float CheckDelay = 1.0f;
 	float CheckTimer = 0.f;
@@ -4,10 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "MassProcessor.h"
+#include "Structs/ReplicationStructs.h"
 #include "AmalgamClientMoveProcessor.generated.h"
 
+class AAmalgamVisualisationManager;
+class UAmalgamSimulationSubsystem;
+
 /**
- * 
+ * Moves the dead reckoned amalgams along their flux from the path replicated by FAmalgamReplicatedAgent,
+ * so the server doesn't have to send their position every step. Only runs with bUseClientPathSimulation
  */
 UCLASS()
 class INFERNALETESTING_API UAmalgamClientMoveProcessor : public UMassProcessor
@@ -20,7 +25,15 @@ protected:
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 
 private:
+	AAmalgamVisualisationManager* GetVisualisationManager();
+
 	FMassEntityQuery EntityQuery;
 	int32 CycleCount = 0;
 	bool bDebug = true;
+
+	UPROPERTY() UAmalgamSimulationSubsystem* SimulationSubsystem = nullptr;
+	TWeakObjectPtr<AAmalgamVisualisationManager> VisualisationManager;
+
+	// Reused between frames
+	TArray<FDataForVisualisation> SimulatedUnits;
 };
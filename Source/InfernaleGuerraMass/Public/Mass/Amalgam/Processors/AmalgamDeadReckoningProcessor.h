@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//UE includes
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+
+#include "AmalgamDeadReckoningProcessor.generated.h"
+
+class UAmalgamSimulationSubsystem;
+
+/**
+ * Moves dead reckoned amalgams along their baked path from (start distance, start time, speed) alone.
+ * Every few steps each one checks the grid around it and goes back to the move and aggro processors
+ * as soon as something could be aggroed, its path changed or it reached the end of its flux.
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamDeadReckoningProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	UAmalgamDeadReckoningProcessor();
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+private:
+	FMassEntityQuery EntityQuery;
+
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "MassProcessor.h"
+#include "Mass/Amalgam/Data/AmalgamAttackScheduler.h"
 #include "AmalgamFightProcessor.generated.h"
 
 /**
@@ -11,12 +12,16 @@
  */
 
 enum class EEntityType : uint8;
-class UBattleManagerComponent;
+class UAmalgamSimulationSubsystem;
 class ABuildingParent;
 class ALDElement;
 struct FOwner;
 struct FAmalgamTargetFragment;
 struct FAmalgamStateFragment;
+struct FAmalgamBattleEvent;
+struct FAmalgamStructureHit;
+struct FGridTargetRef;
+struct FGridTargetSnapshot;
 
 UCLASS()
 class INFERNALETESTING_API UAmalgamFightProcessor : public UMassProcessor
@@ -28,29 +33,35 @@ protected:
 	virtual void ConfigureQueries() override;
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 
-	void GetBattleManager();
 private:
 	FMassEntityQuery EntityQuery;
-	UBattleManagerComponent* BattleManager;
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
+
+	// Reused every step, only the attacks coming out of the scheduler are processed
+	TArray<FAmalgamScheduledAttack> DueAttacks;
+	TArray<FMassEntityHandle> ReadyEntities;
 
 	bool bDebug = false;
 
 	/*
-	* @param TargetHandle Handle of the attacked entity, used to fetch entity from entities map
+	* @param TargetRef Grid reference of the attacked entity
 	* @param Damage The damage inflicted to the entity
+	* @param OutBattleEvents Receives the hit, sent to the battle manager at the end of the frame
 	* @return True if the attack succeded and the entity survives, False otherwise.
 	*/
-	bool ExecuteAmalgamFight(FMassEntityHandle TargetHandle, float Damage, FVector AttackerLocation, float AttackerRange, float DistanceOffset, FOwner Attacker, EEntityType AttackerType, EEntityType TargetType);
+	bool ExecuteAmalgamFight(const FGridTargetRef& TargetRef, float Damage, FVector AttackerLocation, float AttackerRange, float DistanceOffset, FOwner Attacker, EEntityType AttackerType, TArray<FAmalgamBattleEvent>& OutBattleEvents);
 
 	/*
 	* @param TargetBuilding The Building on which the damage are going to be inflicted for capture
+	* @param Snapshot Grid snapshot of the building, the actor itself is only touched on the game thread
 	* @param Damage The damage inflicted to the building
 	* @param AttackOwner Used to define the attacker's team, in order to change the building's team post capture
-	* @return True if the attack succeded, False otherwise. It is important to note that failing means that the buidling was either destroyed or switched teams.
+	* @param OutStructureHits Receives the hit, applied by the battle event buffer at the end of the frame
+	* @return True if the attack landed, False if the building is gone or out of range. A capture is seen on the next attack, once the snapshot is refreshed.
 	*/
-	bool ExecuteBuildingFight(TWeakObjectPtr<ABuildingParent> TargetBuilding, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset);
+	bool ExecuteBuildingFight(TWeakObjectPtr<ABuildingParent> TargetBuilding, const FGridTargetSnapshot& Snapshot, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset, TArray<FAmalgamStructureHit>& OutStructureHits);
 
-	bool ExecuteLDFight(TWeakObjectPtr<ALDElement> Element, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset);
+	bool ExecuteLDFight(TWeakObjectPtr<ALDElement> Element, const FGridTargetSnapshot& Snapshot, float Damage, FOwner AttackOwner, EEntityType AttackerType, FVector AttackerLocation, float AttackerRange, float DistanceOffset, TArray<FAmalgamStructureHit>& OutStructureHits);
 
 	bool CheckTargetValidity(FAmalgamTargetFragment& TgtFrag, FAmalgamStateFragment StateFrag, FOwner Owner);
 };
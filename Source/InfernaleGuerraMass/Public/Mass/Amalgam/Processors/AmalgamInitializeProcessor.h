@@ -12,6 +12,7 @@
  * 
  */
 class AFogOfWarManager;
+class UAmalgamSimulationSubsystem;
 
 UCLASS()
 class INFERNALETESTING_API UAmalgamInitializeProcessor : public UMassProcessor
@@ -28,6 +29,7 @@ private:
 	
 	AAmalgamVisualisationManager* VisualisationManager;
 	AFogOfWarManager* FogManager;
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
 
 	int32 CycleCount = 0;
 	bool bDebug = false;
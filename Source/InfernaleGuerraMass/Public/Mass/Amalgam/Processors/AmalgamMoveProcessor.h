@@ -8,8 +8,8 @@
 #include "MassCommonFragments.h"
 
 // Project Includes
-#include <Manager/AmalgamVisualisationManager.h>
 #include "Flux/Flux.h"
+#include "Enums/Enums.h"
 
 #include "AmalgamMoveProcessor.generated.h"
 
@@ -17,13 +17,15 @@
  * 
  */
 
-class AGameModeInfernale;
 struct FAmalgamFluxFragment;
 struct FAmalgamTargetFragment;
 struct FAmalgamAggroFragment;
 struct FAmalgamStateFragment;
 struct FAmalgamPathfindingFragment;
 struct FAmalgamDirectionFragment;
+struct FAmalgamDeadReckoningFragment;
+
+class UAmalgamSimulationSubsystem;
 
 enum EAmalgamState : uint8;
 
@@ -38,22 +40,18 @@ protected:
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 private:
 	FMassEntityQuery EntityQuery;
-	
-	AAmalgamVisualisationManager* VisualisationManager;
-	AGameModeInfernale* GameModeInfernale;
-
-	float DistanceThreshold = 15.f;
 
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
+	
 	bool bDebugMove = false;
 	bool bDebugEntities = false;
 
-	FVector GetDirectionFollow(const FVector Location, FVector& Destination, FAmalgamFluxFragment& FluxFragment);
-	FVector GetDirectionAggroed(const FVector Location, FVector& Destination, FAmalgamTargetFragment& TargetFragment, FAmalgamAggroFragment& AggroFragment, FAmalgamStateFragment& StateFragment);
-
-	FVector GetTargetLocation(const FAmalgamTargetFragment TargetFrag);
-
-	bool CheckIfPathEnded(FAmalgamFluxFragment& FluxFrag, FVector Location, FVector Destination, EAmalgamState State);
+	FVector GetTargetLocation(const FAmalgamTargetFragment& TargetFrag);
 
-	bool FollowPath(FTransformFragment& TrsfFrag, FAmalgamFluxFragment& FlxFrag, FAmalgamPathfindingFragment& PathFragment, FAmalgamDirectionFragment& DirFragment, float Speed, const float DeltaTime);
+	bool FollowPath(FTransformFragment& TrsfFrag, FAmalgamPathfindingFragment& PathFragment, FAmalgamDirectionFragment& DirFragment, float Speed, const float DeltaTime);
+	/*
+	* @return True if nothing can be aggroed around and the amalgam was handed over to UAmalgamDeadReckoningProcessor
+	*/
+	bool TryStartDeadReckoning(const FVector Location, const FAmalgamPathfindingFragment& PathFragment, float WakeRange, ETeam Team, float Speed, double SimulationTime, FAmalgamDeadReckoningFragment& DeadReckoningFragment);
 	bool FollowTarget(FTransformFragment& TrsfFrag, FVector TargetLocation, FAmalgamDirectionFragment& DirFragment, float Speed, float AcceptancePathfindingRadius, const float DeltaTime);
 };
@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//UE includes
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+
+// Project Includes
+#include <Manager/AmalgamVisualisationManager.h>
+
+#include "AmalgamPresentationProcessor.generated.h"
+
+class AGameModeInfernale;
+class UAmalgamSimulationSubsystem;
+class UAmalgamViewReportComponent;
+struct FAmalgamPlayerView;
+
+/**
+ * Game thread half of the amalgam movement, snapshots the player views used by the next visibility pass.
+ * The updates themselves are sent by FAmalgamVisualUpdateCollector at the end of the phase
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamPresentationProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	UAmalgamPresentationProcessor();
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+private:
+	/* One impostor per team and block the view draws as impostors, from the grid coarse summaries */
+	void SendImpostors(const FAmalgamPlayerView& View, UAmalgamViewReportComponent& ViewReport) const;
+
+	AAmalgamVisualisationManager* VisualisationManager;
+	AGameModeInfernale* GameModeInfernale;
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
+
+	float LastImpostorUpdateTime = -1000.f;
+
+	bool bDebug = false;
+};
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//UE includes
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+
+// Project Includes
+#include "Mass/Amalgam/Data/AmalgamSquadRegistry.h"
+
+#include "AmalgamSquadProcessor.generated.h"
+
+class UAmalgamSimulationSubsystem;
+
+/**
+ * Runs the shared aggro query of every squad before the aggro processor refines it per member.
+ * Every few steps squads are also split and merged from the grid cells their members occupy.
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamSquadProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	UAmalgamSquadProcessor();
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+private:
+	FMassEntityQuery EntityQuery;
+
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
+
+	// Kept between steps to reuse the allocation
+	TArray<FAmalgamSquadMember> Members;
+};
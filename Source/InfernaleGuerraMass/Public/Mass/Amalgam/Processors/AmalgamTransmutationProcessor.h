@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//UE includes
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+
+#include "AmalgamTransmutationProcessor.generated.h"
+
+/**
+ * Refreshes the cached transmutation multipliers of each owner before the processors reading them run.
+ * Only calls into the transmutation component, the rest of the simulation reads plain floats.
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamTransmutationProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	UAmalgamTransmutationProcessor();
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+private:
+	FMassEntityQuery EntityQuery;
+
+	bool bDebug = false;
+};
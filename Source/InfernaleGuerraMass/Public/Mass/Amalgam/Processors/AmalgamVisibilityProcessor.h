@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//UE includes
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+
+#include "AmalgamVisibilityProcessor.generated.h"
+
+class UAmalgamSimulationSubsystem;
+
+/**
+ * Culls moving amalgams against the player views and fills the presentation buffer.
+ * Hides are only emitted when a team bit goes from visible to hidden.
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamVisibilityProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+public:
+	UAmalgamVisibilityProcessor();
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+private:
+	FMassEntityQuery EntityQuery;
+
+	UAmalgamSimulationSubsystem* SimulationSubsystem;
+};
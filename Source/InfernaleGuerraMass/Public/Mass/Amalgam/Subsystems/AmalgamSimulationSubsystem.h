@@ -0,0 +1,243 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Mass/Amalgam/Data/AmalgamAttackScheduler.h"
+#include "Mass/Amalgam/Data/AmalgamBattleEventBuffer.h"
+#include "Mass/Amalgam/Data/AmalgamFluxPathLUT.h"
+#include "Mass/Amalgam/Data/AmalgamSimulationClock.h"
+#include "Mass/Amalgam/Data/AmalgamSquadRegistry.h"
+#include "Mass/Amalgam/Data/AmalgamVisualUpdateCollector.h"
+#include "AmalgamSimulationSubsystem.generated.h"
+
+class AAmalgamVisualisationManager;
+class UAmalgamReplicationLODAsset;
+
+enum EAmalgamState : uint8;
+
+/**
+ * Holds the per-world amalgam data that is shared between processors but doesn't belong to any entity
+ */
+UCLASS(Config = Game)
+class INFERNALETESTING_API UAmalgamSimulationSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	FAmalgamVisualUpdateCollector& GetVisualUpdateCollector() { return VisualUpdateCollector; }
+	const FAmalgamSimulationClock& GetSimulationClock() const { return SimulationClock; }
+	FAmalgamFluxPathCache& GetFluxPathCache() { return FluxPathCache; }
+	FAmalgamBattleEventBuffer& GetBattleEventBuffer() { return BattleEventBuffer; }
+	FAmalgamAttackScheduler& GetAttackScheduler() { return AttackScheduler; }
+	FAmalgamSquadRegistry& GetSquadRegistry() { return SquadRegistry; }
+
+	/* Game thread only. The visuals of dead amalgams are removed with a single message at the end of PrePhysics, late kills at the end of FrameEnd */
+	void QueueVisualRemovals(TConstArrayView<FMassEntityHandle> Entities) { PendingVisualRemovals.Append(Entities.GetData(), Entities.Num()); }
+
+	bool UsesDeadReckoning() const { return bUseDeadReckoning; }
+	int32 GetDeadReckoningCheckInterval() const { return FMath::Max(1, DeadReckoningCheckInterval); }
+	float GetDeadReckoningWakeMargin() const { return DeadReckoningWakeMargin; }
+
+	bool UsesViewReports() const { return bUseViewReports; }
+	float GetViewReportInterval() const { return ViewReportInterval; }
+	float GetViewReportMaxDistance() const { return ViewReportMaxDistance; }
+	float GetViewReportTimeout() const { return ViewReportTimeout; }
+	float GetUnitVisualSize() const { return UnitVisualSize; }
+	float GetMinUnitScreenSize() const { return MinUnitScreenSize; }
+
+	bool UsesImpostors() const { return bUseImpostors; }
+	float GetImpostorScreenSize() const { return ImpostorScreenSize; }
+	int32 GetImpostorBlockSize() const { return FMath::Max(1, ImpostorBlockSize); }
+	float GetImpostorUpdateInterval() const { return ImpostorUpdateInterval; }
+
+	/* Loads the asset on first use, null if none is set */
+	UAmalgamReplicationLODAsset* GetReplicationLODAsset() const;
+
+	bool UsesClientPathSimulation() const { return bUseClientPathSimulation; }
+	float GetClientPathCorrectionThreshold() const { return ClientPathCorrectionThreshold; }
+	/* Server only. Tracks the entities whose path Client simulates itself, they don't need visual updates while visible */
+	void SetClientPathEntity(const AActor* Client, FMassEntityHandle Entity, bool bOnPath);
+	const TSet<FMassEntityHandle>* GetClientPathEntities(const AActor* Client) const { return ClientPathEntities.Find(FObjectKey(Client)); }
+	/* Server only. Client baked Flux like the server did for this update, see UAmalgamViewReportComponent::ConfirmFluxPath */
+	void ConfirmClientFluxPath(const AActor* Client, const AFlux* Flux, uint32 UpdateID, uint32 UpdateVersion);
+	bool HasClientFluxPath(const AActor* Client, FObjectKey FluxKey, const FAmalgamFluxPathLUT& PathLUT) const;
+
+	bool UsesSquads() const { return bUseSquads; }
+	int32 GetSquadClusterInterval() const { return FMath::Max(1, SquadClusterInterval); }
+
+	/* Tag mode, processors filter on the state tags. Otherwise they read the state fragment and tags only mirror opted-in states */
+	bool UsesStateTags() const { return bUseStateTags; }
+	/* True if entering or leaving State goes through the state change observer. Killed always does */
+	bool IsStateTagged(EAmalgamState State) const;
+
+private:
+	void OnPrePhysicsPhaseStarted(const float DeltaSeconds);
+	void OnPrePhysicsPhaseFinished(const float DeltaSeconds);
+	void OnFrameEndPhaseFinished(const float DeltaSeconds);
+	void FlushVisualRemovals();
+
+	UBattleManagerComponent* GetBattleManager();
+	AAmalgamVisualisationManager* GetVisualisationManager();
+
+	// Runs the amalgam simulation at SimulationRate instead of once per frame
+	UPROPERTY(Config)
+	bool bUseFixedTimestep = false;
+
+	// Steps per second in fixed timestep mode, clamped to [15, 30]
+	UPROPERTY(Config)
+	float SimulationRate = 20.f;
+
+	// Max fixed steps a slow frame integrates at once, the time beyond is dropped
+	UPROPERTY(Config)
+	int32 MaxCatchUpSteps = 3;
+
+	// Distance between two samples of the baked flux paths
+	UPROPERTY(Config)
+	float FluxPathSpacing = 100.f;
+
+	// Lets marching amalgams far from any target move analytically along their flux
+	UPROPERTY(Config)
+	bool bUseDeadReckoning = true;
+
+	// Simulation steps between two neighbourhood checks of the same amalgam, checks are staggered across entities
+	UPROPERTY(Config)
+	int32 DeadReckoningCheckInterval = 10;
+
+	// Added to the aggro range when looking for targets, must cover what an amalgam travels between two checks
+	UPROPERTY(Config)
+	float DeadReckoningWakeMargin = 600.f;
+
+	// Groups amalgams spawned together in squads sharing a single aggro query
+	UPROPERTY(Config)
+	bool bUseSquads = false;
+
+	// Above this size squads are not merged anymore and spawn waves are cut in several squads
+	UPROPERTY(Config)
+	int32 MaxSquadSize = 32;
+
+	// Simulation steps between two split & merge passes over the squads
+	UPROPERTY(Config)
+	int32 SquadClusterInterval = 20;
+
+	// Drives processors with state tags, every state change moves the entity to another archetype
+	UPROPERTY(Config)
+	bool bUseStateTags = false;
+
+	// Without state tags, keeps the tag of these states in sync for code filtering on them
+	UPROPERTY(Config)
+	bool bTagFollowPathState = false;
+
+	UPROPERTY(Config)
+	bool bTagAggroedState = false;
+
+	UPROPERTY(Config)
+	bool bTagFightingState = false;
+
+	UPROPERTY(Config)
+	bool bTagInactiveState = false;
+
+	// Sends the visual updates as a quantized, delta compressed unreliable stream instead of UpdateUnits
+	UPROPERTY(Config)
+	bool bUseUnitStream = false;
+
+	// Stream frames between two full snapshots. Only sent while every unit fits in UnitStreamMaxPacketBytes,
+	// beyond that the deltas against acked frames are enough for the client to recover
+	UPROPERTY(Config)
+	int32 UnitStreamKeyframeInterval = 30;
+
+	// Upper bound of a stream frame, kept under the MTU so a frame never spans several packets. Larger updates are spread over the next frames
+	UPROPERTY(Config)
+	int32 UnitStreamMaxPacketBytes = 1024;
+
+	// Culls the visual updates against the ground area seen by each client instead of a radius around its camera
+	UPROPERTY(Config)
+	bool bUseViewReports = false;
+
+	// Seconds between two view reports of a client
+	UPROPERTY(Config)
+	float ViewReportInterval = .1f;
+
+	// Ground distance at which view rays going above the horizon are cut
+	UPROPERTY(Config)
+	float ViewReportMaxDistance = 30000.f;
+
+	// Past this age a report is ignored and the player falls back to the radius
+	UPROPERTY(Config)
+	float ViewReportTimeout = 1.f;
+
+	// World size of an amalgam visual, used to estimate how many pixels it covers
+	UPROPERTY(Config)
+	float UnitVisualSize = 150.f;
+
+	// Amalgams covering fewer pixels than this are not sent
+	UPROPERTY(Config)
+	float MinUnitScreenSize = 2.f;
+
+	// Per LOD thresholds of the mass agent replication, every LOD uses a 10 units tolerance without it
+	UPROPERTY(Config)
+	TSoftObjectPtr<UAmalgamReplicationLODAsset> ReplicationLODAsset;
+
+	// Clients move dead reckoned amalgams along their flux themselves, the server only replicates the path they follow
+	// once the client confirmed its bake of the flux matches
+	UPROPERTY(Config)
+	bool bUseClientPathSimulation = false;
+
+	// Arc-length a client prediction can drift from the server before the path is sent again
+	UPROPERTY(Config)
+	float ClientPathCorrectionThreshold = 50.f;
+
+	// Visual updates sent per player and simulation step, the others are deferred by priority. 0 sends every visible unit
+	UPROPERTY(Config)
+	int32 VisualUpdateBudget = 0;
+
+	// In simulation steps, a visible unit this long without an update goes before the others, within the budget
+	UPROPERTY(Config)
+	int32 VisualUpdateMaxStaleness = 10;
+
+	// Prints the updates sent and deferred each simulation step
+	UPROPERTY(Config)
+	bool bDebugVisualUpdateScheduler = false;
+
+	// Distant blocks of cells are sent as one impostor per team instead of their units, needs bUseViewReports
+	UPROPERTY(Config)
+	bool bUseImpostors = false;
+
+	// Blocks whose units would all cover fewer pixels than this become impostors
+	UPROPERTY(Config)
+	float ImpostorScreenSize = 6.f;
+
+	// In grid cells, side of the square blocks summarized by an impostor
+	UPROPERTY(Config)
+	int32 ImpostorBlockSize = 4;
+
+	// Seconds between two rebuilds of the block summaries and two impostor updates of a client
+	UPROPERTY(Config)
+	float ImpostorUpdateInterval = .25f;
+
+	FAmalgamSimulationClock SimulationClock;
+	FAmalgamFluxPathCache FluxPathCache;
+	FAmalgamVisualUpdateCollector VisualUpdateCollector;
+	FAmalgamBattleEventBuffer BattleEventBuffer;
+	FAmalgamAttackScheduler AttackScheduler;
+	FAmalgamSquadRegistry SquadRegistry;
+
+	TWeakObjectPtr<UBattleManagerComponent> BattleManager;
+	TWeakObjectPtr<AAmalgamVisualisationManager> VisualisationManager;
+
+	TArray<FMassEntityHandle> PendingVisualRemovals;
+
+	// Keyed by the player controller owning the client bubble
+	TMap<FObjectKey, TSet<FMassEntityHandle>> ClientPathEntities;
+	// Last bake of each flux a client confirmed, keyed by player controller and flux
+	TMap<TPair<FObjectKey, FObjectKey>, TPair<uint32, uint32>> ClientFluxPaths;
+
+	FDelegateHandle PhaseStartedHandle;
+	FDelegateHandle PhaseFinishedHandle;
+	FDelegateHandle FrameEndFinishedHandle;
+};
@@ -8,6 +8,8 @@
 #include "NiagaraComponent.h"
 #include "Components/SplineComponent.h"
 #include "Mass/Army/AmalgamTags.h"
+#include "Mass/Amalgam/Data/AmalgamFluxPathLUT.h"
+#include "Mass/Collision/GridTargetRef.h"
 
 #include "MassExecutionContext.h"
 #include <MassEntityTemplateRegistry.h>
@@ -40,9 +42,6 @@ private:
 
 	UPROPERTY(EditAnywhere)
 	float LocalSpeedMult = 1;
-
-	UPROPERTY(EditAnywhere)
-	TMap<ETeam, bool> VisibleBy;
 	
 public:
 	void SetParameters(float SpeedParam, float RushSpeedParam, float SpeedMultParam)
@@ -50,13 +49,6 @@ public:
 		LocalSpeed = SpeedParam;
 		LocalRushSpeed = RushSpeedParam;
 		LocalSpeedMult = SpeedMultParam;
-
-		VisibleBy = TMap<ETeam, bool>();
-		VisibleBy.Add(ETeam::Team1, true);
-		VisibleBy.Add(ETeam::Team2, true);
-		VisibleBy.Add(ETeam::Team3, true);
-		VisibleBy.Add(ETeam::Team4, true);
-		VisibleBy.Add(ETeam::NatureTeam, true);
 	}
 
 	float GetSpeed() const { return LocalSpeed * LocalSpeedMult; }
@@ -67,9 +59,40 @@ public:
 	
 	void SetSpeedMult(float InSpeedMult) { LocalSpeedMult = InSpeedMult; }
 	float GetSpeedMult() { return LocalSpeedMult; }
+};
+
+/*
+* Stores which teams currently display the entity, one bit per team
+*/
+USTRUCT()
+struct FAmalgamVisibilityFragment : public FMassFragment
+{
+	GENERATED_USTRUCT_BODY()
+
+private:
+	// Starts visible for everyone, units are spawned shown on every client
+	uint8 VisibleByMask = 0xFF;
+
+public:
+	static uint8 GetTeamBit(const ETeam InTeam)
+	{
+		checkSlow((uint8)InTeam < 8);
+		return 1 << (uint8)InTeam;
+	}
+
+	uint8 GetMask() const { return VisibleByMask; }
+
+	bool IsVisibleBy(const ETeam InTeam) const { return (VisibleByMask & GetTeamBit(InTeam)) != 0; }
+	bool IsVisibleByBit(const uint8 TeamBit) const { return (VisibleByMask & TeamBit) != 0; }
 
-	bool IsVisibleBy(const ETeam InTeam) { return VisibleBy[InTeam]; }
-	void SetVisibleBy(const ETeam InTeam, const bool NewVisible) { VisibleBy[InTeam] = NewVisible; }
+	// Returns true if the bit changed
+	bool SetVisibleByBit(const uint8 TeamBit, const bool NewVisible)
+	{
+		const uint8 OldMask = VisibleByMask;
+		VisibleByMask = NewVisible ? (VisibleByMask | TeamBit) : (VisibleByMask & ~TeamBit);
+		return OldMask != VisibleByMask;
+	}
+	bool SetVisibleBy(const ETeam InTeam, const bool NewVisible) { return SetVisibleByBit(GetTeamBit(InTeam), NewVisible); }
 };
 
 /*
@@ -140,7 +163,7 @@ private:
 	float LocalStrengthMult = 1.0f;
 	
 	float LocalAttackDelay;
-	float LocalAttackTimer = 0.f;
+	uint64 LocalNextAttackTick = 0;
 	EEntityType LocalEntityType = EEntityType::EntityTypeNone;
 
 public:
@@ -191,21 +214,11 @@ public:
 	}
 
 	/*
-	* Increases the attack timer based on DeltaTimeParameter, if the timer exceeds the attack delay, sets it to 0.
-	* @param DeltaTime Time elapsed since last tick in seconds.
-	* @return Returns true if the timer has exceeded the AttackDelay, false otherwise.
+	* Tick of the attack scheduler at which the next attack is due.
+	* Scheduler entries with another tick are outdated and must be ignored.
 	*/
-	bool TickAttackTimer(float DeltaTime) 
-	{ 
-		LocalAttackTimer += DeltaTime;
-		if (LocalAttackTimer < LocalAttackDelay)
-			return false;
-
-		LocalAttackTimer = 0.f;
-		return true;
-	}
-
-	void ResetTimer() { LocalAttackTimer = 0.f; }
+	uint64 GetNextAttackTick() const { return LocalNextAttackTick; }
+	void SetNextAttackTick(uint64 InTick) { LocalNextAttackTick = InTick; }
 };
 
 USTRUCT()
@@ -236,6 +249,9 @@ private:
 	TWeakObjectPtr<ABuildingParent> TargetBuilding = nullptr;
 	TWeakObjectPtr<ALDElement> TargetLDElem = nullptr;
 
+	// Whichever of the above is targeted, checked against the grid slots instead of the maps or the actors
+	FGridTargetRef TargetRef;
+
 	float TotalRangeOffset = TNumericLimits<float>::Max();
 
 public:
@@ -251,6 +267,9 @@ public:
 	TWeakObjectPtr<ALDElement> GetMutableTargetLDElem() { return TargetLDElem; }
 	void SetTargetLDElem(TWeakObjectPtr<ALDElement> InLDElement) { TargetLDElem = InLDElement; }
 
+	const FGridTargetRef& GetTargetRef() const { return TargetRef; }
+	void SetTargetRef(const FGridTargetRef& InTargetRef) { TargetRef = InTargetRef; }
+
 	float GetTargetRangeOffset(EAmalgamAggro AggroType) const;
 
 	float GetTotalRangeOffset() const { return TotalRangeOffset; }
@@ -264,6 +283,7 @@ public:
 		TargetEntity = FMassEntityHandle(0, 0);
 		TargetBuilding = nullptr;
 		TargetLDElem = nullptr;
+		TargetRef.Reset();
 	}
 };
 
@@ -278,80 +298,36 @@ public:
 		AcceptanceRadiusAttack = AcceptanceRadiusAttackParam;
 	}
 
-	void CopyPathFromFlux(TWeakObjectPtr<AFlux> FluxTarget, FVector EntityLocation, bool StartAtBeginning)
+	// Starts following a baked flux path from the sample closest to the entity
+	void SetPathLUT(const TSharedPtr<const FAmalgamFluxPathLUT>& InPathLUT, FVector EntityLocation)
 	{
-		if (!FluxTarget.IsValid()) return;
-		
-		Path.Empty();
-
-		AFlux* FluxPtr = FluxTarget.Get();
-
-		auto FluxPath = FluxPtr->GetPath();
-		if (FluxPath.Num() == 0) return;
-
-		auto StartIndex = StartAtBeginning ? 0 : -1;
-		if (!StartAtBeginning)
-		{
-			const auto Location = EntityLocation;
-			auto ClosestPoint = FluxPath[0];
-			auto ClosestDistance = FVector::Dist(Location, ClosestPoint);
-			StartIndex = 0;
-			for (int i = 1; i < FluxPath.Num(); i++)
-			{
-				const auto Distance = FVector::Dist(Location, FluxPath[i]);
-				if (Distance >= ClosestDistance) continue;
-				ClosestDistance = Distance;
-				ClosestPoint = FluxPath[i];
-				StartIndex = i;
-			}
-		}
-
-		Path = TArray<FVector>();
-		for (int i = StartIndex; i < FluxPath.Num(); i++)
-		{
-			Path.Add(FluxPath[i]);
-		}
-
-		FluxUpdateID = FluxPtr->GetUpdateID();
-		FluxUpdateVersion = FluxPtr->GetUpdateVersion();
+		if (!InPathLUT.IsValid()) return;
+
+		PathLUT = InPathLUT;
+		PathIndex = PathLUT->FindClosestIndex(EntityLocation);
+
+		FluxUpdateID = PathLUT->UpdateID;
+		FluxUpdateVersion = PathLUT->UpdateVersion;
 	}
 
 	void RecoverPath(FVector EntityLocation)
 	{
-		if (Path.Num() == 0) return;
-
-		int ClosestIndex = -1;
-		float SmallestDistance = TNumericLimits<float>::Max();
-
-		/*for (FVector& Point : Path)
-		{
-			float NextDistance = (Point - EntityLocation).Length();
-			if (NextDistance > SmallestDistance)
-				break;
-
-			ClosestIndex++;
-			SmallestDistance = NextDistance;
-		}*/
+		bRecoverPath = false;
+		if (!HasPathPoint()) return;
 
-		for (int32 Index = 0; Index < Path.Num(); ++Index)
-		{
-			float NextDistance = (Path[Index] - EntityLocation).Length();
-			if (NextDistance > SmallestDistance)
-				continue;
+		PathIndex = PathLUT->FindClosestIndex(EntityLocation, PathIndex);
+	}
 
-			ClosestIndex = Index;
-			SmallestDistance = NextDistance;
-		}
+	bool HasPathPoint() const { return PathLUT.IsValid() && PathLUT->IsValidIndex(PathIndex); }
+	const FVector& GetPathPoint() const { return PathLUT->Positions[PathIndex]; }
 
-		TArray<FVector> NewPath(&Path[ClosestIndex], Path.Num() - ClosestIndex);
-
-		Path = NewPath;
-		bRecoverPath = false;
-	}
+	const TSharedPtr<const FAmalgamFluxPathLUT>& GetPathLUT() const { return PathLUT; }
+	int32 GetPathIndex() const { return PathIndex; }
+	void SetPathIndex(int32 InIndex) { PathIndex = InIndex; }
 
 	void NextPoint()
 	{
-		Path.RemoveAt(0);
+		++PathIndex;
 	}
 
 	bool IsPathFinal() { return bFinalPath; }
@@ -371,10 +347,10 @@ public:
 	float GetAcceptancePathfindingRadius() { return AcceptancePathfindingRadius; }
 
 	
-public:
-	TArray<FVector> Path = TArray<FVector>();
-
 private:
+	// Shared with every amalgam on the same flux, kept alive here once the path is final
+	TSharedPtr<const FAmalgamFluxPathLUT> PathLUT;
+	int32 PathIndex = 0;
 
 	bool bRecoverPath = false;
 	bool bFinalPath = false;
@@ -401,13 +377,8 @@ private:
 public:
 	EAmalgamState GetState() const { return AmalgamState; }
 	void SetState(EAmalgamState InState) { AmalgamState = InState; }
-	void SetStateAndNotify(EAmalgamState InState, FMassExecutionContext& Context, int32 EntityIndexInContext) 
-	{
-		if (AmalgamState == EAmalgamState::Killed) return;
-
-		AmalgamState = InState; 
-		NotifyContext(Context, EntityIndexInContext); 
-	}
+	/* Only goes through the state change observer when a tagged state is entered or left, see UAmalgamSimulationSubsystem::IsStateTagged */
+	void SetStateAndNotify(EAmalgamState InState, FMassExecutionContext& Context, int32 EntityIndexInContext);
 
 	EAmalgamAggro GetAggro() const { return AggroState; }
 	void SetAggro(EAmalgamAggro InAggro) { AggroState = InAggro; }
@@ -432,22 +403,98 @@ struct FAmalgamFluxFragment : public FMassFragment
 
 private:
 	TWeakObjectPtr<AFlux> Flux;
-	int32 SplinePointIndex;	
+	FObjectKey FluxKey;
 
 public:
 	TWeakObjectPtr<AFlux> GetFlux() const { return Flux; }
 	TWeakObjectPtr<AFlux> GetMutableFlux() { return Flux; }
-	void SetFlux(TWeakObjectPtr<AFlux> InFlux) { Flux = InFlux; }
+	void SetFlux(TWeakObjectPtr<AFlux> InFlux) { Flux = InFlux; FluxKey = FObjectKey(InFlux.Get()); }
+
+	// Safe off the game thread, used to look the baked path up in FAmalgamFluxPathCache
+	FObjectKey GetFluxKey() const { return FluxKey; }
+};
+
+/*
+* Analytic movement of a dead reckoned amalgam along the baked path held by its FAmalgamPathfindingFragment.
+* The position is only a function of the simulation time until the amalgam gets woken up.
+*/
+USTRUCT()
+struct FAmalgamDeadReckoningFragment : public FMassFragment
+{
+	GENERATED_USTRUCT_BODY()
+
+private:
+	float StartDistance = 0.f;
+	double StartTime = 0.0;
+	float Speed = 0.f;
 
-	int32 GetSplinePointIndex() const { return SplinePointIndex; }
-	void SetSplinePointIndex(int32 InIndex) { SplinePointIndex = InIndex; }
-	void NextSplinePoint() { ++SplinePointIndex; }
-	bool CheckFluxIsValid() 
+public:
+	void Start(float InStartDistance, double InStartTime, float InSpeed)
 	{
-		bool bIsFluxInvalid = (!GetFlux().IsValid());
-		bool bIsSplinePointExceeded = SplinePointIndex >= GetFlux()->GetSplineForAmalgamsComponent()->GetNumberOfSplinePoints();
-		return (!bIsFluxInvalid && !bIsSplinePointExceeded);
+		StartDistance = InStartDistance;
+		StartTime = InStartTime;
+		Speed = InSpeed;
 	}
+
+	float GetDistance(double SimulationTime) const { return StartDistance + Speed * (SimulationTime - StartTime); }
+	float GetSpeed() const { return Speed; }
+};
+
+/*
+* Client side copy of the dead reckoning of an amalgam, replicated through FAmalgamReplicatedAgent.
+* Times are in server world time, see UAmalgamClientMoveProcessor.
+*/
+USTRUCT()
+struct FAmalgamClientPathFragment : public FMassFragment
+{
+	GENERATED_USTRUCT_BODY()
+
+private:
+	TWeakObjectPtr<AFlux> Flux;
+	// Bake of the flux the server used, see FAmalgamFluxPathLUT
+	uint32 UpdateID = -1;
+	uint32 UpdateVersion = -1;
+	float StartDistance = 0.f;
+	double StartTime = 0.0;
+	float Speed = 0.f;
+	uint64 VisualHandle = 0;
+	bool bActive = false;
+
+public:
+	void Start(AFlux* InFlux, uint32 InUpdateID, uint32 InUpdateVersion, float InStartDistance, double InStartTime, float InSpeed, uint64 InVisualHandle)
+	{
+		Flux = InFlux;
+		UpdateID = InUpdateID;
+		UpdateVersion = InUpdateVersion;
+		StartDistance = InStartDistance;
+		StartTime = InStartTime;
+		Speed = InSpeed;
+		VisualHandle = InVisualHandle;
+		bActive = InFlux != nullptr;
+	}
+	void Stop() { bActive = false; }
+
+	bool IsActive() const { return bActive; }
+	AFlux* GetFlux() const { return Flux.Get(); }
+	bool MatchesPath(const FAmalgamFluxPathLUT& PathLUT) const { return PathLUT.UpdateID == UpdateID && PathLUT.UpdateVersion == UpdateVersion; }
+	float GetDistance(double ServerTime) const { return StartDistance + Speed * (ServerTime - StartTime); }
+	uint64 GetVisualHandle() const { return VisualHandle; }
+};
+
+/*
+* Squad the amalgam belongs to, see FAmalgamSquadRegistry. Amalgams without a squad run their own aggro query.
+*/
+USTRUCT()
+struct FAmalgamSquadFragment : public FMassFragment
+{
+	GENERATED_USTRUCT_BODY()
+
+private:
+	int32 SquadId = INDEX_NONE;
+
+public:
+	int32 GetSquadId() const { return SquadId; }
+	void SetSquadId(int32 InSquadId) { SquadId = InSquadId; }
 };
 
 /*
@@ -476,31 +523,146 @@ public:
 	FVector Direction;
 };
 
-USTRUCT()
-struct FAmalgamTransmutationFragment : public FMassFragment
+/*
+* One transmutation effect sampled as Base * Scale + Offset.
+* Exact as long as the effect is affine in the base value (percentages and flat bonuses), a curve would need one sample per base value.
+*/
+struct FAmalgamTransmutationEffect
 {
-	GENERATED_USTRUCT_BODY()
+	float Scale = 1.f;
+	float Offset = 0.f;
+
+	// Game thread only, Effect is evaluated twice
+	template<typename FEffect>
+	void Sample(FEffect&& Effect)
+	{
+		Offset = Effect(0.f);
+		Scale = Effect(1.f) - Offset;
+	}
 
+	float Apply(float Base) const { return Base * Scale + Offset; }
+};
+
+/*
+* Transmutation effects of one owner, refreshed only when its component's UpdateID changes
+*/
+struct FAmalgamTransmutationMultipliers
+{
 private:
 	TWeakObjectPtr<UTransmutationComponent> TransmutationComponent;
 	int32 UpdateID = -1;
 
+	FAmalgamTransmutationEffect Speed;
+	FAmalgamTransmutationEffect UnitDamage;
+	FAmalgamTransmutationEffect BuildingDamage;
+	FAmalgamTransmutationEffect MonsterDamage;
+	FAmalgamTransmutationEffect Health;
+	FAmalgamTransmutationEffect Sight;
+
+public:
+	void SetComponent(UTransmutationComponent* Component) { TransmutationComponent = Component; }
+	bool HasComponent() const { return TransmutationComponent.IsValid(); }
+
+	// Game thread only, returns true if the effects changed
+	bool Refresh()
+	{
+		if (!TransmutationComponent.IsValid()) return false;
+		if (UpdateID == TransmutationComponent->GetUpdateID()) return false;
+
+		// Same getter for every effect, as the per unit calls this cache replaces did
+		UTransmutationComponent* Component = TransmutationComponent.Get();
+		const auto UnitSpeedEffect = [Component](float Base) { return Component->GetEffectUnitSpeed(Base); };
+		Speed.Sample(UnitSpeedEffect);
+		UnitDamage.Sample(UnitSpeedEffect);
+		BuildingDamage.Sample(UnitSpeedEffect);
+		MonsterDamage.Sample(UnitSpeedEffect);
+		Health.Sample(UnitSpeedEffect);
+		Sight.Sample(UnitSpeedEffect);
+
+		UpdateID = TransmutationComponent->GetUpdateID();
+		return true;
+	}
+
+	int32 GetUpdateID() const { return UpdateID; }
+
+	float GetSpeedModifier(float BaseSpeed) const { return Speed.Apply(BaseSpeed); }
+
+	float GetUnitDamageModifier(float BaseDamage) const { return UnitDamage.Apply(BaseDamage); }
+	float GetBuildingDamageModifier(float BaseDamage) const { return BuildingDamage.Apply(BaseDamage); }
+	float GetMonsterDamageModifier(float BaseDamage) const { return MonsterDamage.Apply(BaseDamage); }
+
+	float GetHealthModifier(float BaseHealth) const { return Health.Apply(BaseHealth); }
+
+	float GetSightModifier(float BaseSight) const { return Sight.Apply(BaseSight); }
+};
+
+/*
+* Transmutation multipliers of every owner, indexed by EPlayerOwning.
+* Owners register their component on the first spawn, UAmalgamTransmutationProcessor refreshes them.
+*/
+USTRUCT()
+struct FAmalgamTransmutationSharedFragment : public FMassSharedFragment
+{
+	GENERATED_USTRUCT_BODY()
+
+private:
+	TArray<FAmalgamTransmutationMultipliers> OwnerMultipliers;
+
+	// Returned for owners without a transmutation component (nature, clients)
+	FAmalgamTransmutationMultipliers NeutralMultipliers;
+
 public:
-	void Init(const UWorld& World) 
-	{ TransmutationComponent = UGameplayStatics::GetPlayerController(&World, 0)->GetComponentByClass<UTransmutationComponent>(); }
+	// Game thread only
+	void RegisterOwner(const FOwner& Owner, UTransmutationComponent* Component)
+	{
+		const int32 Index = static_cast<int32>(Owner.Player);
+		if (!Component || Index < 0) return;
+
+		if (!OwnerMultipliers.IsValidIndex(Index))
+			OwnerMultipliers.SetNum(Index + 1);
+
+		if (OwnerMultipliers[Index].HasComponent()) return;
+
+		OwnerMultipliers[Index].SetComponent(Component);
+		OwnerMultipliers[Index].Refresh();
+	}
 
-	float GetSpeedModifier(float BaseSpeed) { return TransmutationComponent->GetEffectUnitSpeed(BaseSpeed); }
+	bool IsOwnerRegistered(const FOwner& Owner) const
+	{
+		const int32 Index = static_cast<int32>(Owner.Player);
+		return OwnerMultipliers.IsValidIndex(Index) && OwnerMultipliers[Index].HasComponent();
+	}
 
-	float GetUnitDamageModifier(float BaseDamage) { return TransmutationComponent->GetEffectUnitSpeed(BaseDamage); }
-	float GetBuildingDamageModifier(float BaseDamage) { return TransmutationComponent->GetEffectUnitSpeed(BaseDamage); }
-	float GetMonsterDamageModifier(float BaseDamage) { return TransmutationComponent->GetEffectUnitSpeed(BaseDamage); }
+	// Game thread only, returns true if any owner's multipliers changed
+	bool Refresh()
+	{
+		bool bChanged = false;
+		for (FAmalgamTransmutationMultipliers& Multipliers : OwnerMultipliers)
+			bChanged |= Multipliers.Refresh();
+		return bChanged;
+	}
 
-	float GetHealthModifier(float BaseHealth) { return TransmutationComponent->GetEffectUnitSpeed(BaseHealth); }
+	const FAmalgamTransmutationMultipliers& GetMultipliers(const FOwner& Owner) const
+	{
+		const int32 Index = static_cast<int32>(Owner.Player);
+		return OwnerMultipliers.IsValidIndex(Index) ? OwnerMultipliers[Index] : NeutralMultipliers;
+	}
+};
 
-	float GetSightModifier(float BaseSight) { return TransmutationComponent->GetEffectUnitSpeed(BaseSight); }
+/*
+* Last transmutation update of the owner applied to this entity's health
+*/
+USTRUCT()
+struct FAmalgamTransmutationFragment : public FMassFragment
+{
+	GENERATED_USTRUCT_BODY()
 
-	bool WasUpdated() { return UpdateID != TransmutationComponent->GetUpdateID(); }
-	void Update() { UpdateID = TransmutationComponent->GetUpdateID(); }
+private:
+	int32 UpdateID = -1;
+
+public:
+	bool WasUpdated(const FAmalgamTransmutationMultipliers& Multipliers) const { return UpdateID != Multipliers.GetUpdateID(); }
+	void Update(const FAmalgamTransmutationMultipliers& Multipliers) { UpdateID = Multipliers.GetUpdateID(); }
 };
 
 USTRUCT()
@@ -47,6 +47,13 @@ struct FAmalgamMoveTag : public FMassTag
 	GENERATED_BODY()
 };
 
+// Marching unit far from anything it could aggro, moved analytically along its flux by UAmalgamDeadReckoningProcessor
+USTRUCT()
+struct FAmalgamDeadReckoningTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
 USTRUCT()
 struct FAmalgamInactiveTag : public FMassTag
 {
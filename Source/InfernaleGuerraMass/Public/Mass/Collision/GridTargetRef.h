@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EGridTargetKind : uint8
+{
+	None,
+	Entity,
+	Static
+};
+
+/*
+* Compact reference to something registered in the spatial hash grid.
+* Entities are referenced by their grid slot, buildings & LD elements by their static target slot.
+* Slots are reused once released, a reference only stays valid while its generation matches the slot's one.
+*/
+struct FGridTargetRef
+{
+	int32 Index = INDEX_NONE;
+	uint32 Generation = 0;
+	EGridTargetKind Kind = EGridTargetKind::None;
+
+	FGridTargetRef() = default;
+	FGridTargetRef(EGridTargetKind InKind, int32 InIndex, uint32 InGeneration) : Index(InIndex), Generation(InGeneration), Kind(InKind) {}
+
+	bool IsSet() const { return Kind != EGridTargetKind::None; }
+	void Reset() { *this = FGridTargetRef(); }
+};
@@ -6,6 +6,7 @@
 #include "GameFramework/Actor.h"
 #include "MassCommonFragments.h"
 #include "Mass/Army/AmalgamFragments.h"
+#include "Mass/Collision/GridTargetRef.h"
 #include "LD/Buildings/BuildingParent.h"
 #include <LD/LDElement/LDElement.h>
 #include <LD/LDElement/SoulBeacon.h>
@@ -28,6 +29,9 @@ struct GridCellEntityData
 
 	int AggroCount = 0;
 
+	// Index of the entity in the grid slot table
+	int32 SlotIndex = INDEX_NONE;
+
 	GridCellEntityData(FOwner EntityOwner, FVector EntityLocation, float Health, float Radius, EEntityType Type) : Owner(EntityOwner), Location(EntityLocation), EntityType(Type), MaxEntityHealth(Health), EntityHealth(Health), TargetableRadius(Radius)
 	{}
 
@@ -101,6 +105,49 @@ struct HashGridCell
 
 	int GetTotalNumByTeam(FOwner Owner);
 	int GetTotalNumByTeamDifference(FOwner Owner);
+
+	// Amalgams of another team, buildings and LD elements are checked against their snapshot by the grid
+	bool HasEnemyEntitiesFor(ETeam Team) const;
+};
+
+/*
+* Game thread copy of what the aggro detection needs from a building or LD element,
+* so worker threads never dereference the actors themselves
+*/
+struct FGridTargetSnapshot
+{
+	FVector Location = FVector::ZeroVector;
+	float TargetableRange = 0.f;
+	// Only meaningful when bHasTeam, neutral camps have no owner
+	ETeam Team = ETeam::NatureTeam;
+	bool bHasTeam = false;
+
+	bool IsHostileTo(ETeam InTeam) const { return !bHasTeam || Team != InTeam; }
+};
+
+/*
+* Stable location of a grid entity. Cells move their data around, slots don't,
+* so validating a FGridTargetRef and reading its position is a single indexed load.
+*/
+struct FGridEntitySlot
+{
+	FMassEntityHandle Entity;
+	FIntVector2 Coords;
+	// Element of the entity in the Entities map of its cell. Map elements keep their index until removed
+	FSetElementId CellElement;
+	FVector Location = FVector::ZeroVector;
+	uint32 Generation = 0;
+};
+
+/*
+* A building or LD element registered in the grid, whatever the number of cells it covers
+*/
+struct FGridStaticTargetSlot
+{
+	TWeakObjectPtr<AActor> Actor;
+	FGridTargetSnapshot Snapshot;
+	uint32 Generation = 0;
+	bool bUsed = false;
 };
 
 struct FDetectionResult
@@ -109,11 +156,48 @@ struct FDetectionResult
 	TWeakObjectPtr<ABuildingParent> Building = nullptr;
 	TWeakObjectPtr<ALDElement> LD = nullptr;
 
+	FGridTargetRef EntityRef;
+	FGridTargetRef BuildingRef;
+	FGridTargetRef LDRef;
+
 	float EntityDistance = TNumericLimits<float>::Max();
 	float BuildingDistance = TNumericLimits<float>::Max();
 	float LDDistance = TNumericLimits<float>::Max();
 };
 
+/*
+* Anything a group of amalgams could aggro, gathered once for the whole group and refined per member
+*/
+struct FGridTargetCandidate
+{
+	FGridTargetRef Ref;
+	FMassEntityHandle Entity;
+	TWeakObjectPtr<ABuildingParent> Building = nullptr;
+	TWeakObjectPtr<ALDElement> LD = nullptr;
+	FVector Location = FVector::ZeroVector;
+	float TargetableRange = 0.f;
+	// Bounds of the gathered cells the target is registered in, a single cell for amalgams
+	FIntVector2 MinCoords;
+	FIntVector2 MaxCoords;
+};
+
+/*
+* Amalgams of one team in a block of cells, enough to draw them as a single blob from far away
+*/
+struct FGridCoarseSummary
+{
+	ETeam Team;
+	int32 Count = 0;
+	FVector2D LocationSum = FVector2D::ZeroVector;
+	// Sum of the squared distances to the world origin, gives the spread once the centroid is known
+	double SquaredLengthSum = 0.;
+
+	FVector2D GetCentroid() const { return LocationSum / FMath::Max(Count, 1); }
+	float GetSpread() const { return FMath::Sqrt(FMath::Max(SquaredLengthSum / FMath::Max(Count, 1) - GetCentroid().SizeSquared(), 0.)); }
+};
+
+using FGridCoarseCell = TArray<FGridCoarseSummary, TInlineAllocator<2>>;
+
 UCLASS()
 class INFERNALETESTING_API ASpatialHashGrid : public AActor
 {	
@@ -129,6 +213,8 @@ public:
 	static bool Generate();
 
 	static inline FIntVector2 GetGridSize() { return Instance->GridSize; }
+	static inline FIntVector2 GetCellSize() { return Instance->CellSize; }
+	static inline FVector GetGridLocation() { return Instance->GridLocation; }
 
 	static inline int32 GetNumEntitiesInCell(FIntVector2 Coordinates) { return Instance->GridCells[Coordinates.X + (Instance->GridSize.X * Coordinates.Y)].GetEntitiesNum(); }
 
@@ -143,6 +229,9 @@ public:
 	// Removes Entity from grid and ensures all references are cleaned up
 	static bool RemoveEntityFromGrid(FMassEntityHandle Entity);
 
+	// Removes all the Entities in one sweep, each touched cell and the presence array are only refreshed once. Returns the number of entities removed
+	static int32 RemoveEntitiesFromGrid(TConstArrayView<FMassEntityHandle> Entities);
+
 	// Moves the Entity's data from its current cell to another
 	static bool MoveEntityToCell(FMassEntityHandle Entity, FVector WorldCoordinates);
 
@@ -218,18 +307,52 @@ public:
 
 	static int32 GetMaxEntityAggroCount() { return Instance->MaxEntityAggroCount; }
 
+	/* ----- Target References ------ */
+
+	// Builds a reference from a handle, prefer the references returned by the detection methods
+	static FGridTargetRef GetEntityRef(FMassEntityHandle Entity);
+
+	// True while the referenced entity, building or LD element is still in the grid
+	static bool IsTargetValid(const FGridTargetRef& Target);
+
+	// Returns false if the target is no longer valid
+	static bool GetTargetLocation(const FGridTargetRef& Target, FVector& OutLocation);
+
+	// Snapshot of a valid building or LD element target, nullptr otherwise
+	static const FGridTargetSnapshot* GetStaticTargetSnapshot(const FGridTargetRef& Target);
+
+	// Entity data of a valid entity target, nullptr otherwise
+	static GridCellEntityData* GetMutableEntityData(const FGridTargetRef& Target);
+
 	static TArray<FVector2D> GetAllEntityOfTypeOfTeam(EEntityType Type, ETeam Team);
 	
 	/* ----- Detection Methods ------ */
 
 	static FDetectionResult FindClosestElementsInRange(FVector WorldCoordinates, float Range, float Angle = 360.f, FVector EntityForwardVector = FVector::ZeroVector, FMassEntityHandle Entity = FMassEntityHandle(0, 0));
 
+	/* Game thread, refreshes the building & LD element snapshots read by FindClosestElementsInRangeThreadSafe and releases the destroyed ones */
+	static void RefreshTargetSnapshots();
+	/* Same as FindClosestElementsInRange but only reads the grid and the target snapshots, safe to call from several threads as long as nothing writes to the grid */
+	static FDetectionResult FindClosestElementsInRangeThreadSafe(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, ETeam CallerTeam);
+	/* Game thread, rebuilds the per team summaries of every block of BlockSize x BlockSize cells */
+	static void RefreshCoarseSummaries(int32 BlockSize);
+	/* Summaries of a block as of the last refresh, null outside of the grid */
+	static const FGridCoarseCell* GetCoarseCell(FIntPoint BlockCoords);
+	/*
+	* Thread safe like above. Every target CallerTeam could aggro within Range, without the cone test.
+	* Scans one cell more than the per entity queries, so the window of any amalgam within Range - its detection range is covered
+	*/
+	static void GatherTargetCandidatesThreadSafe(FVector WorldCoordinates, float Range, ETeam CallerTeam, TArray<FGridTargetCandidate>& OutCandidates);
+	/* Same selection and cell window as FindClosestElementsInRangeThreadSafe, restricted to Candidates. Never touches the grid cells */
+	static FDetectionResult FindClosestElementsInCandidates(TConstArrayView<FGridTargetCandidate> Candidates, FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector);
+
 	static TMap<FMassEntityHandle, GridCellEntityData> FindEntitiesInRange(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, FMassEntityHandle Entity, ETeam Team = ETeam::NatureTeam);
 	static TArray<TWeakObjectPtr<ABuildingParent>> FindBuildingsInRange(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, FMassEntityHandle Entity);
 	static TArray<TWeakObjectPtr<ALDElement>> FindLDElementsInRange(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, FMassEntityHandle Entity);
 	static TArray<HashGridCell*> FindCellsInRange(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, FMassEntityHandle Entity);
 	
 	static TMap<FMassEntityHandle, GridCellEntityData> FindEntitiesAroundCell(FVector WorldCoordinates, int32 Range);
+	static bool HasPotentialTargetsAround(FVector WorldCoordinates, float Range, ETeam Team);
 
 	static FMassEntityHandle FindClosestEntity(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, FMassEntityHandle Entity, ETeam Team);
 	static TWeakObjectPtr<ABuildingParent> FindClosestBuilding(FVector WorldCoordinates, float Range, float Angle, FVector EntityForwardVector, FMassEntityHandle Entity, ETeam Team);
@@ -272,6 +395,15 @@ private:
 	static bool GenerateGrid();
 	static bool GenerateGridFromCenter();
 
+	static int32 AcquireEntitySlot(FMassEntityHandle Entity, FIntVector2 Coords, FVector Location);
+	static void ReleaseEntitySlot(int32 SlotIndex);
+
+	static int32 AcquireStaticTargetSlot(AActor* Actor);
+	static void ReleaseStaticTargetSlot(int32 SlotIndex);
+	static void RefreshStaticTargetSnapshot(FGridStaticTargetSlot& Slot);
+	// False for removed targets and for targets owned by Team
+	static bool IsStaticTargetHostileTo(const TWeakObjectPtr<AActor>& Actor, ETeam Team);
+
 public:	
 	static ASpatialHashGrid* Instance;
 
@@ -309,13 +441,25 @@ protected:
 
 private:
 
-	TMap<FMassEntityHandle, FIntVector2> HandleToCoordsMap;
+	TMap<FMassEntityHandle, int32> HandleToSlotMap;
 	TArray<HashGridCell> GridCells;
 	TArray<TWeakObjectPtr<ASoulBeacon>> AllSoulBeacons;
+
+	TArray<FGridEntitySlot> EntitySlots;
+	TArray<int32> FreeEntitySlots;
+
+	TArray<FGridStaticTargetSlot> StaticTargetSlots;
+	TArray<int32> FreeStaticTargetSlots;
+	TMap<TWeakObjectPtr<AActor>, int32> StaticTargetToSlotMap;
 	FVector GridLocation;
 
 	TArray<FMassEntityHandle> PresentEntities;
 
+	// See RefreshCoarseSummaries
+	int32 CoarseBlockSize = 0;
+	FIntVector2 CoarseGridSize = FIntVector2(0, 0);
+	TArray<FGridCoarseCell> CoarseCells;
+
 	UPROPERTY(EditAnywhere, Category="Grid Debug")
 	bool bDebugAmalgamDetectionCone = false;
 
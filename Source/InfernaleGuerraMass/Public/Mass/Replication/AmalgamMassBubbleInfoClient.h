@@ -11,6 +11,8 @@
 #include "AmalgamMassBubbleInfoClient.generated.h"
 
 struct FAmalgamMassFastArrayItem;
+class FAmalgamFluxPathCache;
+class UAmalgamViewReportComponent;
 
 /** Inserts the data that the server replicated into the fragments */
 class FAmalgamMassClientBubbleHandler : public TClientBubbleHandlerBase<FAmalgamMassFastArrayItem>
@@ -26,12 +28,23 @@ public:
 
 #endif // UE_REPLICATION_COMPILE_SERVER_CODE
 
+#if UE_REPLICATION_COMPILE_CLIENT_CODE
+	/** Looked up once per replicated batch, both are null without client path simulation */
+	struct FClientPathContext
+	{
+		FAmalgamFluxPathCache* FluxPathCache = nullptr;
+		UAmalgamViewReportComponent* ViewReport = nullptr;
+	};
+#endif //UE_REPLICATION_COMPILE_CLIENT_CODE
+
 protected:
 #if UE_REPLICATION_COMPILE_CLIENT_CODE
+	FClientPathContext GetClientPathContext() const;
+
 	virtual void PostReplicatedAdd(const TArrayView<int32> AddedIndices, int32 FinalSize) override;
 	virtual void PostReplicatedChange(const TArrayView<int32> ChangedIndices, int32 FinalSize) override;
 
-	virtual void PostReplicatedChangeEntity(const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item) const;
+	virtual void PostReplicatedChangeEntity(const FMassEntityView& EntityView, const FAmalgamReplicatedAgent& Item, const FClientPathContext& PathContext) const;
 
 	virtual void AddQueryRequirements(FMassEntityQuery& InQuery) const;
 #endif //UE_REPLICATION_COMPILE_CLIENT_CODE
@@ -8,6 +8,10 @@
 
 #include "AmalgamMassFastArray.generated.h"
 
+/*
+ * Serialized by hand, see NetSerialize. The location is sent on the ground plane with FAmalgamStreamQuantizer,
+ * 16 bits per axis relative to the spatial hash grid bounds, tagged so the client never decodes it with other bounds
+ */
 USTRUCT()
 struct FAmalgamReplicatedAgent : public FReplicatedAgentBase
 {
@@ -16,16 +20,55 @@ struct FAmalgamReplicatedAgent : public FReplicatedAgentBase
 	const FVector& GetEntityLocation() const { return EntityLocation; }
 	const EAmalgamState& GetEntityState() const { return EntityState; }
 	const EAmalgamAggro& GetEntityAggro() const { return EntityAggro; }
+	FVector GetEntityDirection() const;
 	
 	void SetEntityLocation(const FVector& InEntityLocation) { EntityLocation = InEntityLocation; }
 	void SetEntityState(const EAmalgamState& InEntityState) { EntityState = InEntityState; }
 	void SetEntityAggro(const EAmalgamAggro& InEntityAggro) { EntityAggro = InEntityAggro; }
+	void SetEntityDirection(const FVector& InDirection);
+
+	/* Client path simulation, the client moves the amalgam along Flux from these alone, see UAmalgamClientMoveProcessor */
+	void SetPath(AFlux* InFlux, uint32 InUpdateID, uint32 InUpdateVersion, float InStartDistance, float InStartTime, float InSpeed, uint64 InVisualHandle);
+	void ClearPath() { bOnPath = false; PathFlux.Reset(); }
+	bool IsOnPath() const { return bOnPath; }
+	AFlux* GetPathFlux() const { return PathFlux.Get(); }
+	uint32 GetPathUpdateID() const { return PathUpdateID; }
+	uint32 GetPathUpdateVersion() const { return PathUpdateVersion; }
+	float GetPathStartDistance() const { return PathStartDistance; }
+	float GetPathStartTime() const { return PathStartTime; }
+	float GetPathSpeed() const { return PathSpeed; }
+	// Server entity handle, the key of the amalgam in AAmalgamVisualisationManager
+	uint64 GetVisualHandle() const { return VisualHandle; }
+	// Arc-length the client predicts at Time, in server world time
+	float PredictPathDistance(float Time) const { return PathStartDistance + PathSpeed * (Time - PathStartTime); }
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
 	
 private:
 	UPROPERTY(Transient)
 	FVector_NetQuantize EntityLocation;
 	EAmalgamState EntityState;
 	EAmalgamAggro EntityAggro;
+	// Yaw in 1/256 of a turn
+	uint8 EntityHeading = 0;
+
+	bool bOnPath = false;
+	TWeakObjectPtr<AFlux> PathFlux;
+	uint32 PathUpdateID = 0;
+	uint32 PathUpdateVersion = 0;
+	float PathStartDistance = 0.f;
+	float PathStartTime = 0.f;
+	float PathSpeed = 0.f;
+	uint64 VisualHandle = 0;
+};
+
+template<>
+struct TStructOpsTypeTraits<FAmalgamReplicatedAgent> : public TStructOpsTypeTraitsBase2<FAmalgamReplicatedAgent>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
 };
 
 /** Fast array item for efficient agent replication. Remember to make this dirty if any FReplicatedCrowdAgent member variables are modified */
@@ -44,4 +87,10 @@ struct FAmalgamMassFastArrayItem : public FMassFastArrayItemBase
 
 	UPROPERTY()
 	FAmalgamReplicatedAgent Agent;
+
+	// Server only, last time the location was marked dirty
+	double LastLocationUpdateTime = 0.;
+
+	// Server only, the client confirmed its bake of the path flux and moves the amalgam itself, see UAmalgamMassReplicator
+	bool bClientSimulatesPath = false;
 };
\ No newline at end of file
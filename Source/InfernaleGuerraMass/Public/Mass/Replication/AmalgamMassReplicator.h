@@ -6,8 +6,11 @@
 #include "MassReplicationProcessor.h"
 #include "AmalgamMassReplicator.generated.h"
 
+class UAmalgamReplicationLODAsset;
+
 /**
- * 
+ * Replicates the amalgam location, state and aggro to the client bubbles.
+ * Location updates are thinned out per replication LOD, see UAmalgamReplicationLODAsset
  */
 UCLASS()
 class INFERNALETESTING_API UAmalgamMassReplicator : public UMassReplicatorBase
@@ -19,4 +22,23 @@ public:
 	virtual void AddRequirements(FMassEntityQuery& EntityQuery) override;
 
 	virtual void ProcessClientReplication(FMassExecutionContext& Context, FMassReplicationContext& ReplicationContext) override;
+
+private:
+	/* Token bucket of one client and LOD, refilled at UpdateBudgetPerSecond */
+	struct FLODBudget
+	{
+		float Tokens = 0.f;
+		double LastRefillTime = -1.;
+	};
+
+	const UAmalgamReplicationLODAsset* GetLODAsset();
+	/* Takes one update from the budget, false when the client already used its share at this LOD */
+	bool ConsumeBudget(const FMassClientHandle ClientHandle, const EMassLOD::Type LOD, const int32 BudgetPerSecond, const double Time);
+
+	UPROPERTY()
+	UAmalgamReplicationLODAsset* LODAsset = nullptr;
+	bool bLODAssetLoaded = false;
+
+	// Indexed by client handle index, then LOD
+	TArray<TStaticArray<FLODBudget, EMassLOD::Max>> ClientBudgets;
 };
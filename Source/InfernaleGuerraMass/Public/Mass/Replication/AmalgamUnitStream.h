@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Structs/ReplicationStructs.h"
+
+/*
+ * Quantized state of a unit as the client knows it. Handle is 0 for a free stream id
+ */
+struct FAmalgamStreamUnit
+{
+	uint64 Handle = 0;
+	uint16 X = 0;
+	uint16 Y = 0;
+	uint8 Yaw = 0;
+
+	bool IsSet() const { return Handle != 0; }
+	bool SameState(const FAmalgamStreamUnit& Other) const { return Handle == Other.Handle && X == Other.X && Y == Other.Y && Yaw == Other.Yaw; }
+};
+
+/* Every unit known by a client, indexed by stream id */
+using FAmalgamStreamSnapshot = TArray<FAmalgamStreamUnit>;
+
+/*
+ * Maps world positions on the grid bounds with 16 bits per axis and directions on 8 bits
+ */
+struct INFERNALETESTING_API FAmalgamStreamQuantizer
+{
+	FVector2D Origin = FVector2D::ZeroVector;
+	FVector2D Extent = FVector2D(1.f, 1.f);
+
+	/* Bounds of the spatial hash grid, false until the grid is initialized */
+	bool InitFromGrid();
+	/* Folded hash of the bounds, sent along quantized values so the receiver can check it decodes with the same ones */
+	uint8 GetBoundsTag() const;
+
+	void Quantize(const FDataForVisualisation& Data, FAmalgamStreamUnit& OutUnit) const;
+	void Dequantize(const FAmalgamStreamUnit& Unit, FDataForVisualisation& OutData) const;
+
+	void QuantizeLocation(double X, double Y, uint16& OutX, uint16& OutY) const;
+	FVector2D DequantizeLocation(uint16 X, uint16 Y) const;
+
+	static uint8 QuantizeYaw(double DirectionX, double DirectionY);
+	static FVector2D DequantizeYaw(uint8 Yaw);
+};
+
+/*
+ * Stream tuning, see UAmalgamSimulationSubsystem
+ */
+struct FAmalgamUnitStreamSettings
+{
+	// Frames between two full snapshots, skipped while every unit doesn't fit in MaxPacketBytes
+	int32 KeyframeInterval = 30;
+	// Upper bound of a frame, the units that don't fit are sent by the next frames
+	int32 MaxPacketBytes = 1024;
+};
+
+/*
+ * Last frames sent or received, a delta can only be built or decoded against a frame still in there
+ */
+struct FAmalgamStreamHistory
+{
+	static constexpr int32 Size = 32;
+
+	uint32 Frames[Size] = {};
+	FAmalgamStreamSnapshot Snapshots[Size];
+
+	const FAmalgamStreamSnapshot* Find(uint32 Frame) const;
+	void Store(uint32 Frame, const FAmalgamStreamSnapshot& Snapshot);
+};
+
+/*
+ * Server side of the stream for one client.
+ * Keeps the state the client should end up with, and encodes it against the last frame the client acked.
+ * Entities are keyed by compact stream ids, their 64 bit handle is only sent when they (re)appear.
+ * A frame never exceeds MaxPacketBytes, the units left out keep their acked state and are sent once that frame is acked.
+ */
+struct INFERNALETESTING_API FAmalgamUnitStreamEncoder
+{
+public:
+	/* Shown units are upserted, hidden and removed ones are dropped from the client state */
+	void Apply(const FAmalgamStreamQuantizer& Quantizer, TConstArrayView<FDataForVisualisation> Shown, TConstArrayView<FMassEntityHandle> Hidden, TConstArrayView<FMassEntityHandle> Removed);
+
+	/* Returns false when the client already has the current state */
+	bool Encode(const FAmalgamStreamQuantizer& Quantizer, const FAmalgamUnitStreamSettings& Settings, TArray<uint8>& OutData, int32& OutNumBits);
+
+	void Ack(uint32 Frame);
+
+private:
+	int32 AcquireId(uint64 Handle);
+	void ReleaseId(uint64 Handle);
+
+	FAmalgamStreamSnapshot Current;
+	TMap<uint64, int32> HandleToId;
+	TArray<int32> FreeIds;
+
+	FAmalgamStreamHistory History;
+	// Id the changes of a frame encoded against the frame at the same index would start from, see History
+	int32 ChangeCursors[FAmalgamStreamHistory::Size] = {};
+	uint32 NextFrame = 1;
+	uint32 AckedFrame = 0;
+	uint32 LastKeyframe = 0;
+};
+
+/*
+ * Client side of the stream, rebuilds the snapshots and turns them into show/hide lists for the visualisation manager
+ */
+struct INFERNALETESTING_API FAmalgamUnitStreamDecoder
+{
+public:
+	/* Returns false if the frame is stale or its base was never received, such frames must not be acked */
+	bool Decode(const TArray<uint8>& Data, int32 NumBits, uint32& OutFrame, TArray<FDataForVisualisation>& OutShown, TArray<FMassEntityHandle>& OutHidden);
+
+private:
+	FAmalgamStreamQuantizer Quantizer;
+	FAmalgamStreamHistory History;
+	FAmalgamStreamSnapshot LastApplied;
+	uint32 LastAppliedFrame = 0;
+	bool bHasKeyframe = false;
+};
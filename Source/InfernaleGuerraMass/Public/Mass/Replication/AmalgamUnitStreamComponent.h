@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Mass/Replication/AmalgamUnitStream.h"
+#include "AmalgamUnitStreamComponent.generated.h"
+
+class AAmalgamVisualisationManager;
+
+/*
+ * Sends the visual updates of one player as a bit packed, delta compressed stream of unreliable packets.
+ * Lives on the player controller, the server encodes against the last frame the owning client acked.
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamUnitStreamComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAmalgamUnitStreamComponent();
+
+	/* Server only, adds the component to the player controller the first time */
+	static UAmalgamUnitStreamComponent* FindOrAdd(APlayerController* PlayerController);
+
+	/* Server only, called once per simulation step with this player's updates */
+	void SendUpdates(const FAmalgamStreamQuantizer& Quantizer, const FAmalgamUnitStreamSettings& Settings, TConstArrayView<FDataForVisualisation> Shown, TConstArrayView<FMassEntityHandle> Hidden, TConstArrayView<FMassEntityHandle> Removed);
+
+protected:
+	UFUNCTION(Client, Unreliable) void ClientReceiveUnits(const TArray<uint8>& Data, int32 NumBits);
+	UFUNCTION(Server, Unreliable) void ServerAckUnits(int32 Frame);
+
+private:
+	AAmalgamVisualisationManager* GetVisualisationManager();
+
+	FAmalgamUnitStreamEncoder Encoder;
+	FAmalgamUnitStreamDecoder Decoder;
+
+	TWeakObjectPtr<AAmalgamVisualisationManager> VisualisationManager;
+
+	// Kept between packets to reuse the allocations
+	TArray<uint8> PacketData;
+	TArray<FDataForVisualisation> Shown;
+	TArray<FMassEntityHandle> Hidden;
+};
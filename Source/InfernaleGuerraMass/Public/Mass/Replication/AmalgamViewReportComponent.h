@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Enums/Enums.h"
+#include "AmalgamViewReportComponent.generated.h"
+
+class AAmalgamVisualisationManager;
+class AFlux;
+struct FAmalgamFluxPathLUT;
+
+/*
+ * What a client camera sees of the ground plane the amalgams walk on
+ */
+USTRUCT()
+struct FAmalgamViewReport
+{
+	GENERATED_BODY()
+
+	// Screen corners projected on the ground, in screen order so the quad is convex
+	UPROPERTY() FVector2D Corners[4];
+	UPROPERTY() FVector CameraLocation = FVector::ZeroVector;
+	// Viewport width / (2 * tan(FOV / 2)), a unit of size S at distance D covers S * FocalLength / D pixels
+	UPROPERTY() float FocalLength = 0.f;
+};
+
+/*
+ * Stands for all the units of a team in a distant block of cells, see ASpatialHashGrid::GetCoarseCell
+ */
+USTRUCT()
+struct FAmalgamImpostor
+{
+	GENERATED_BODY()
+
+	UPROPERTY() FVector2D Centroid = FVector2D::ZeroVector;
+	// Standard deviation of the unit positions around the centroid
+	UPROPERTY() float Spread = 0.f;
+	UPROPERTY() int32 Count = 0;
+	UPROPERTY() ETeam Team = ETeam::NatureTeam;
+};
+
+/*
+ * Lives on the player controller. The owning client reports its view a few times per second,
+ * the server uses the last report to cull the visual updates of that player.
+ * With client path simulation it also tells the server which flux bakes the client shares with it
+ */
+UCLASS()
+class INFERNALETESTING_API UAmalgamViewReportComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAmalgamViewReportComponent();
+
+	/* Server only, adds the component to the player controller the first time */
+	static UAmalgamViewReportComponent* FindOrAdd(APlayerController* PlayerController);
+
+	/* Server only, null if the client never reported or its last report is older than MaxAge */
+	const FAmalgamViewReport* GetReport(float MaxAge) const;
+
+	/*
+	 * Server only, replaces the impostors drawn by the client. Blocks are the blocks of cells they stand for,
+	 * kept until the next send so the visibility pass switches blocks at the same time as the client.
+	 * Lists are sent unreliably since the next one replaces them, clearing them is reliable
+	 */
+	void SendImpostors(const TArray<FAmalgamImpostor>& Impostors, const TSet<FIntPoint>& Blocks);
+	const TSet<FIntPoint>& GetImpostorBlocks() const { return ImpostorBlocks; }
+
+	/* Owning client only, once per bake. The server keeps sending the amalgams on Flux until their path matches a confirmed bake */
+	void ConfirmFluxPath(AFlux* Flux, const FAmalgamFluxPathLUT& PathLUT);
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	UFUNCTION(Server, Unreliable) void ServerReportView(const FAmalgamViewReport& InReport);
+	UFUNCTION(Server, Reliable) void ServerConfirmFluxPath(AFlux* Flux, uint32 UpdateID, uint32 UpdateVersion);
+	UFUNCTION(Client, Unreliable) void ClientReceiveImpostors(const TArray<FAmalgamImpostor>& Impostors);
+	UFUNCTION(Client, Reliable) void ClientClearImpostors();
+
+private:
+	bool BuildReport(FAmalgamViewReport& OutReport) const;
+	AAmalgamVisualisationManager* GetVisualisationManager();
+
+	FAmalgamViewReport Report;
+	float ReportTime = -1.f;
+
+	bool bHasSentImpostors = false;
+	TSet<FIntPoint> ImpostorBlocks;
+	TWeakObjectPtr<AAmalgamVisualisationManager> VisualisationManager;
+
+	// Owning client, last bake confirmed for each flux
+	TMap<FObjectKey, TPair<uint32, uint32>> ConfirmedFluxPaths;
+};